@@ -0,0 +1,268 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "check_names.h"
+#include "collectable.h"
+#include "counter.h"
+#include "counter_builder.h"
+#include "gauge.h"
+#include "gauge_builder.h"
+#include "label_hash.h"
+#include "metric.h"
+
+namespace prometheus {
+
+template <typename T>
+class ColumnarFamily;
+
+namespace detail {
+
+template <typename T>
+struct SharedTraits;
+
+inline void AtomicAdd(std::atomic<double>* value, double delta) {
+  auto current = value->load(std::memory_order_relaxed);
+  while (!value->compare_exchange_weak(current, current + delta))
+    ;
+}
+
+// Values of a ColumnarFamily, stored in cache-line aligned blocks of
+// contiguous atomics. Blocks are never moved or freed while the column
+// lives, so pointers handed out by At() stay valid as it grows.
+class ValueColumn {
+ public:
+  static const std::size_t kBlockSize = 1024;
+
+  ValueColumn() = default;
+  ValueColumn(const ValueColumn&) = delete;
+  ValueColumn& operator=(const ValueColumn&) = delete;
+
+  // Returns the index of a zeroed slot.
+  std::size_t Allocate();
+  // Zeroes the slot and makes it available to Allocate() again.
+  void Release(std::size_t index);
+
+  std::atomic<double>* At(std::size_t index) const {
+    return blocks_[index / kBlockSize].values + index % kBlockSize;
+  }
+  std::size_t size() const { return size_; }
+
+  // Copies the first size() values into `out` in one pass per block. The
+  // values are read with relaxed atomic loads, which compilers do not
+  // vectorize; the loops gain from contiguous memory, not from SIMD.
+  void Snapshot(std::vector<double>* out) const;
+  // Sum of all values; released slots hold zero and do not contribute.
+  double Sum() const;
+
+ private:
+  struct Block {
+    std::unique_ptr<unsigned char[]> memory;
+    std::atomic<double>* values;
+  };
+
+  std::vector<Block> blocks_;
+  std::vector<std::size_t> free_;
+  std::size_t size_ = 0;
+};
+}  // namespace detail
+
+// Handle to one series of a ColumnarFamily<Counter>. It is a single pointer
+// into the value column, so copying and incrementing it costs the same as
+// going through a Counter&. Like a Counter&, a handle must not be used once
+// its series was removed: Remove() hands the slot to the next series added,
+// and a stale handle would update that series instead.
+class CounterRef {
+ public:
+  explicit CounterRef(std::atomic<double>* value) : value_(value) {}
+
+  void Increment() { detail::AtomicAdd(value_, 1.0); }
+  void Increment(double value) {
+    if (value < 0.0) {
+      return;
+    }
+    detail::AtomicAdd(value_, value);
+  }
+  double Value() const { return value_->load(); }
+
+ private:
+  friend class ColumnarFamily<Counter>;
+  friend struct detail::SharedTraits<Counter>;
+  std::atomic<double>* value_;
+};
+
+// Handle to one series of a ColumnarFamily<Gauge>. The same lifetime rule
+// as for CounterRef applies.
+class GaugeRef {
+ public:
+  explicit GaugeRef(std::atomic<double>* value) : value_(value) {}
+
+  void Increment() { Increment(1.0); }
+  void Increment(double value) {
+    if (value < 0.0) {
+      return;
+    }
+    detail::AtomicAdd(value_, value);
+  }
+  void Decrement() { Decrement(1.0); }
+  void Decrement(double value) {
+    if (value < 0.0) {
+      return;
+    }
+    detail::AtomicAdd(value_, -1.0 * value);
+  }
+  void Set(double value) { value_->store(value); }
+  void SetToCurrentTime() { Set(static_cast<double>(std::time(nullptr))); }
+  double Value() const { return value_->load(); }
+
+ private:
+  friend class ColumnarFamily<Gauge>;
+  friend struct detail::SharedTraits<Gauge>;
+  std::atomic<double>* value_;
+};
+
+namespace detail {
+template <typename T>
+struct ColumnarTraits;
+
+template <>
+struct ColumnarTraits<Counter> {
+  using Handle = CounterRef;
+};
+
+template <>
+struct ColumnarTraits<Gauge> {
+  using Handle = GaugeRef;
+};
+}  // namespace detail
+
+// Family of counters or gauges whose values live in one contiguous column
+// instead of one polymorphic object per series. Collect() and Sum() read the
+// column in tight loops without virtual calls.
+template <typename T>
+class ColumnarFamily : public Collectable {
+ public:
+  using Handle = typename detail::ColumnarTraits<T>::Handle;
+
+  ColumnarFamily(const std::string& name, const std::string& help,
+                 const std::map<std::string, std::string>& constant_labels);
+  Handle Add(const std::map<std::string, std::string>& labels);
+  // Invalidates `handle` and all copies of it.
+  void Remove(Handle handle);
+
+  double Sum() const;
+
+  // Collectable
+  builders_t Collect() override;
+
+ private:
+  detail::ValueColumn values_;
+  std::unordered_map<std::size_t, std::size_t> index_;
+  std::unordered_map<const std::atomic<double>*, std::size_t> reverse_index_;
+  // indexed like values_; a null entry marks a free slot
+  std::vector<std::unique_ptr<label_pair_t>> labels_;
+  std::vector<std::size_t> hashes_;
+
+  const std::string name_;
+  const std::string help_;
+  const std::map<std::string, std::string> constant_labels_;
+  mutable std::mutex mutex_;
+};
+
+template <typename T>
+ColumnarFamily<T>::ColumnarFamily(
+    const std::string& name, const std::string& help,
+    const std::map<std::string, std::string>& constant_labels)
+    : name_(name), help_(help), constant_labels_(constant_labels) {
+  assert(CheckMetricName(name_));
+}
+
+template <typename T>
+typename ColumnarFamily<T>::Handle ColumnarFamily<T>::Add(
+    const std::map<std::string, std::string>& labels) {
+#ifndef NDEBUG
+  for (auto& label_pair : labels) {
+    auto& label_name = label_pair.first;
+    assert(CheckLabelName(label_name));
+  }
+#endif
+
+  auto hash = detail::hash_labels(labels);
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto index_iter = index_.find(hash);
+  if (index_iter != index_.end()) {
+    return Handle{values_.At(index_iter->second)};
+  }
+
+  auto index = values_.Allocate();
+  if (index >= labels_.size()) {
+    labels_.resize(index + 1);
+    hashes_.resize(index + 1);
+  }
+  // constant labels are resolved once here instead of on every scrape
+  auto all_labels = std::unique_ptr<label_pair_t>{new label_pair_t{}};
+  all_labels->insert(all_labels->end(), constant_labels_.begin(),
+                     constant_labels_.end());
+  all_labels->insert(all_labels->end(), labels.begin(), labels.end());
+  labels_[index] = std::move(all_labels);
+  hashes_[index] = hash;
+  index_.insert({hash, index});
+  reverse_index_.insert({values_.At(index), index});
+  return Handle{values_.At(index)};
+}
+
+template <typename T>
+void ColumnarFamily<T>::Remove(Handle handle) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto reverse_iter = reverse_index_.find(handle.value_);
+  if (reverse_iter == reverse_index_.end()) {
+    return;
+  }
+
+  auto index = reverse_iter->second;
+  index_.erase(hashes_[index]);
+  reverse_index_.erase(reverse_iter);
+  labels_[index].reset();
+  values_.Release(index);
+}
+
+template <typename T>
+double ColumnarFamily<T>::Sum() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return values_.Sum();
+}
+
+template <typename T>
+builders_t ColumnarFamily<T>::Collect() {
+  auto values = std::vector<double>{};
+  auto metrics_vec =
+      std::vector<flatbuffers::Offset<io::prometheus::client::Metric>>{};
+  auto bld = make_bld_t();
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  values_.Snapshot(&values);
+  metrics_vec.reserve(index_.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (labels_[i]) {
+      metrics_vec.emplace_back(
+          T::CollectValue(values[i], labels_[i].get(), bld.get()));
+    }
+  }
+  auto metrics = bld->CreateVector(metrics_vec);
+
+  auto family = io::prometheus::client::CreateMetricFamily(
+      *bld, bld->CreateString(name_), bld->CreateString(help_), T::metric_type,
+      metrics);
+  bld->Finish(family);
+  return {bld};
+}
+}  // namespace prometheus
@@ -1,26 +1,32 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 
 #include "metrics_generated.h"
 
-#include "prometheus/gauge.h"
 #include "prometheus/metric.h"
 
 namespace prometheus {
-class Counter : Metric {
+class Counter : public Metric {
  public:
   static const io::prometheus::client::MetricType metric_type =
       io::prometheus::client::MetricType_COUNTER;
 
   void Increment();
   void Increment(double);
+  // Adds all non-negative `values` with a single atomic update.
+  void IncrementBatch(const double* values, std::size_t count);
   double Value() const;
 
   metric_collect_t Collect(label_pair_t* global_labels,
                            flatbuffers::FlatBufferBuilder* builder) override;
 
+  // Serializes a counter sample for a value that is not held by a Counter.
+  static metric_collect_t CollectValue(double value, label_pair_t* labels,
+                                       flatbuffers::FlatBufferBuilder* builder);
+
  private:
-  Gauge gauge_;
+  std::atomic<double> value_{0.0};
 };
 }
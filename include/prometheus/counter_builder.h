@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <map>
 #include <string>
 
@@ -7,8 +9,15 @@ namespace prometheus {
 
 template <typename T>
 class Family;
+template <typename T>
+class ColumnarFamily;
 class Counter;
 class Registry;
+template <typename T>
+class SharedFamily;
+class SharedMemorySegment;
+template <typename T, typename Schema>
+class TypedFamily;
 
 namespace detail {
 class CounterBuilder;
@@ -22,12 +31,36 @@ class CounterBuilder {
   CounterBuilder& Labels(const std::map<std::string, std::string>& labels);
   CounterBuilder& Name(const std::string&);
   CounterBuilder& Help(const std::string&);
+  // Free series that were not updated for longer than `idle_timeout`.
+  // Eviction invalidates references returned by Family::Add() like
+  // Family::Remove() does, see Family::EvictIdle().
+  CounterBuilder& IdleTimeout(std::chrono::steady_clock::duration idle_timeout);
+  // Redirect label sets beyond `max_series` distinct ones to a single
+  // overflow series.
+  CounterBuilder& MaxSeries(std::size_t max_series);
+  // Give every series its own cache lines to avoid false sharing between
+  // series updated from different threads.
+  CounterBuilder& CacheLineAligned(bool aligned = true);
   Family<Counter>& Register(Registry&);
+  // Register a family that keeps all values in one contiguous column. Only
+  // Labels, Name and Help apply to columnar families.
+  ColumnarFamily<Counter>& RegisterColumnar(Registry&);
+  // Register a family whose series live in `segment`. Only Labels, Name and
+  // Help apply to shared families.
+  SharedFamily<Counter>& RegisterShared(SharedMemorySegment& segment);
+  // Register a family whose label names are fixed by `Schema`, a
+  // prometheus::Labels<...> list. Only Labels, Name and Help apply to
+  // typed families. Defined in typed_family.h.
+  template <typename Schema>
+  TypedFamily<Counter, Schema>& RegisterTyped(Registry&);
 
  private:
   std::map<std::string, std::string> labels_;
   std::string name_;
   std::string help_;
+  std::chrono::steady_clock::duration idle_timeout_{};
+  std::size_t max_series_ = 0;
+  bool cache_line_aligned_ = false;
 };
 }
 }
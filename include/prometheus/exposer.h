@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "histogram.h"
 #include "registry.h"
@@ -13,6 +14,7 @@ class CivetServer;
 namespace prometheus {
 
 namespace detail {
+class CollectableSet;
 class MetricsHandler;
 }  // namespace detail
 
@@ -21,13 +23,20 @@ class Exposer {
   explicit Exposer(const std::string& bind_address,
                    const std::string& uri = std::string("/metrics"));
   ~Exposer();
+  // Both may be called from any thread, also while scrapes are served.
+  // Collectables that expire are dropped automatically.
   void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+  void UnregisterCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  // Ports the server listens on, e.g. to find the one picked for a bind
+  // address with port 0.
+  std::vector<int> GetListeningPorts() const;
 
   static Exposer& GetInstance();
 
  private:
   std::unique_ptr<CivetServer> server_;
-  std::vector<std::weak_ptr<Collectable>> collectables_;
+  std::unique_ptr<detail::CollectableSet> collectables_;
   std::shared_ptr<Registry> exposer_registry_;
   std::unique_ptr<detail::MetricsHandler> metrics_handler_;
   std::string uri_;
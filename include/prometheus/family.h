@@ -1,19 +1,27 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <mutex>
-#include <numeric>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "check_names.h"
 #include "collectable.h"
+#include "counter.h"
 #include "counter_builder.h"
+#include "gauge.h"
 #include "gauge_builder.h"
 #include "histogram_builder.h"
+#include "idle_sweeper.h"
+#include "label_hash.h"
 #include "metric.h"
+#include "slab.h"
 
 namespace prometheus {
 
@@ -24,32 +32,115 @@ class Family : public Collectable {
   friend class detail::GaugeBuilder;
   friend class detail::HistogramBuilder;
 
+  // Label set of the series that absorbs all label sets added after a
+  // family reached its series limit.
+  static const std::map<std::string, std::string>& OverflowLabels();
+
+  // Reports the value of one series from a batch callback.
+  using SeriesEmitter = std::function<void(
+      const std::map<std::string, std::string>& labels, double value)>;
+
   Family(const std::string& name, const std::string& help,
          const std::map<std::string, std::string>& constant_labels);
+  ~Family();
+  // Returns the series with `labels`, creating it on first use. The
+  // reference stays valid until the series is passed to Remove() or, in a
+  // family with an idle timeout, until EvictIdle() frees it. Throws
+  // std::invalid_argument if a callback was added for `labels`.
   template <typename... Args>
   T& Add(const std::map<std::string, std::string>& labels, Args&&... args);
   void Remove(T* metric);
 
+  // Adds a series whose value is computed by `callback` on every collection
+  // instead of being updated on every change. Callbacks run with the family
+  // locked and must not call back into it. Only counter and gauge families
+  // support callbacks. Throws std::invalid_argument if a label name is
+  // invalid or if a series or callback with `labels` already exists.
+  void AddCallback(const std::map<std::string, std::string>& labels,
+                   std::function<double()> callback);
+  void RemoveCallback(const std::map<std::string, std::string>& labels);
+
+  // Adds a callback that reports any number of series through the emitter it
+  // is given, once per collection. Returns an id for RemoveBatchCallback().
+  std::size_t AddBatchCallback(
+      std::function<void(const SeriesEmitter&)> callback);
+  void RemoveBatchCallback(std::size_t id);
+
+  // Frees all series that were not updated for longer than the idle timeout,
+  // like Remove() does. Called periodically by the background sweeper once a
+  // timeout is set; returns the number of evicted series. References to an
+  // evicted series dangle: a caller must not keep using a reference to a
+  // series that may have been idle for the timeout, but look it up again
+  // with Add(), which creates it anew.
+  std::size_t EvictIdle(std::chrono::steady_clock::time_point now);
+
+  // Number of series slots allocated, including the slots of removed and
+  // evicted series that wait to be reused.
+  std::size_t capacity() const;
+
   // Collectable
   builders_t Collect() override;
 
  private:
-  std::unordered_map<std::size_t, std::unique_ptr<T>> metrics_;
-  std::unordered_map<std::size_t, std::map<std::string, std::string>> labels_;
-  std::unordered_map<T*, std::size_t> labels_reverse_lookup_;
+  void SetIdleTimeout(std::chrono::steady_clock::duration idle_timeout,
+                      const std::string& registry);
+  void SetCacheLineAligned(bool aligned);
+  // `remove_self_metrics` is called by the destructor to remove
+  // `series_gauge` and `overflow_counter` from their families.
+  void SetMaxSeries(std::size_t max_series, Gauge* series_gauge,
+                    Counter* overflow_counter,
+                    std::function<void()> remove_self_metrics);
+  void UpdateSeriesGauge();
+  label_pair_t AllLabels(
+      const std::map<std::string, std::string>& labels) const;
+
+  using collect_callback_t = std::function<void(
+      flatbuffers::FlatBufferBuilder*, std::vector<metric_collect_t>*)>;
+
+  // A series shares its slab slot with its labels, so Collect() walks the
+  // slab without a lookup per series.
+  struct Series {
+    template <typename... Args>
+    Series(std::size_t series_hash,
+           const std::map<std::string, std::string>& series_labels,
+           Args&&... args)
+        : metric(std::forward<Args>(args)...),
+          hash(series_hash),
+          labels(series_labels) {}
+
+    T metric;
+    std::size_t hash;
+    std::map<std::string, std::string> labels;
+    // set by the first sweep that sees the series
+    std::chrono::steady_clock::time_point last_update{};
+  };
+
+  detail::Slab<Series> storage_;
+  std::unordered_map<std::size_t, Series*> metrics_;
+  std::unordered_map<T*, Series*> reverse_index_;
+  std::chrono::steady_clock::duration idle_timeout_{};
+  std::size_t max_series_ = 0;
+  std::size_t overflow_hash_ = 0;
+  Gauge* series_gauge_ = nullptr;
+  Counter* overflow_counter_ = nullptr;
+  std::function<void()> remove_self_metrics_;
+  std::unordered_map<std::size_t, collect_callback_t> callbacks_;
+  std::map<std::size_t, collect_callback_t> batch_callbacks_;
+  std::size_t next_batch_callback_id_ = 0;
 
   const std::string name_;
   const std::string help_;
   const std::map<std::string, std::string> constant_labels_;
-  std::mutex mutex_;
-
-  metric_collect_t CollectMetric(std::size_t hash, T* metric,
-                                 flatbuffers::FlatBufferBuilder* bld);
-
-  static std::size_t hash_labels(
-      const std::map<std::string, std::string>& labels);
+  mutable std::mutex mutex_;
 };
 
+template <typename T>
+const std::map<std::string, std::string>& Family<T>::OverflowLabels() {
+  static const auto labels =
+      std::map<std::string, std::string>{{"overflow", "true"}};
+  return labels;
+}
+
 template <typename T>
 Family<T>::Family(const std::string& name, const std::string& help,
                   const std::map<std::string, std::string>& constant_labels)
@@ -57,6 +148,16 @@ Family<T>::Family(const std::string& name, const std::string& help,
   assert(CheckMetricName(name_));
 }
 
+template <typename T>
+Family<T>::~Family() {
+  if (idle_timeout_ > std::chrono::steady_clock::duration::zero()) {
+    detail::IdleSweeper::Instance().Unregister(this);
+  }
+  if (remove_self_metrics_) {
+    remove_self_metrics_();
+  }
+}
+
 template <typename T>
 template <typename... Args>
 T& Family<T>::Add(const std::map<std::string, std::string>& labels,
@@ -68,50 +169,201 @@ T& Family<T>::Add(const std::map<std::string, std::string>& labels,
   }
 #endif
 
-  auto hash = hash_labels(labels);
+  auto hash = detail::hash_labels(labels);
   std::lock_guard<std::mutex> lock{mutex_};
   auto metrics_iter = metrics_.find(hash);
 
   if (metrics_iter != metrics_.end()) {
-#ifndef NDEBUG
-    auto labels_iter = labels_.find(hash);
-    assert(labels_iter != labels_.end());
-    const auto& old_labels = labels_iter->second;
-    assert(labels == old_labels);
-#endif
-    return *metrics_iter->second;
-  } else {
-    auto metric = new T(std::forward<Args>(args)...);
-    metrics_.insert(std::make_pair(hash, std::unique_ptr<T>{metric}));
-    labels_.insert({hash, labels});
-    labels_reverse_lookup_.insert({metric, hash});
-    return *metric;
+    assert(labels == metrics_iter->second->labels);
+    return metrics_iter->second->metric;
+  }
+  if (callbacks_.count(hash) != 0) {
+    throw std::invalid_argument("family " + name_ +
+                                " has a callback with the same labels");
+  }
+
+  // the limit is only consulted for label sets not seen before, so lookups
+  // of existing series pay nothing for it
+  auto new_labels = &labels;
+  if (max_series_ != 0) {
+    auto overflow_iter = metrics_.find(overflow_hash_);
+    auto series = metrics_.size();
+    if (overflow_iter != metrics_.end()) {
+      --series;
+    }
+    if (series >= max_series_) {
+      overflow_counter_->Increment();
+      if (overflow_iter != metrics_.end()) {
+        return overflow_iter->second->metric;
+      }
+      hash = overflow_hash_;
+      new_labels = &OverflowLabels();
+    }
+  }
+
+  auto series =
+      storage_.Emplace(hash, hash, *new_labels, std::forward<Args>(args)...);
+  metrics_.insert({hash, series});
+  reverse_index_.insert({&series->metric, series});
+  UpdateSeriesGauge();
+  return series->metric;
+}
+
+template <typename T>
+void Family<T>::Remove(T* metric) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto reverse_iter = reverse_index_.find(metric);
+  if (reverse_iter == reverse_index_.end()) {
+    return;
   }
+
+  auto series = reverse_iter->second;
+  metrics_.erase(series->hash);
+  reverse_index_.erase(reverse_iter);
+  storage_.Erase(series);
+  UpdateSeriesGauge();
 }
 
 template <typename T>
-std::size_t Family<T>::hash_labels(
+void Family<T>::AddCallback(const std::map<std::string, std::string>& labels,
+                            std::function<double()> callback) {
+  for (auto& label_pair : labels) {
+    if (!CheckLabelName(label_pair.first)) {
+      throw std::invalid_argument("invalid label name: " + label_pair.first);
+    }
+  }
+
+  auto hash = detail::hash_labels(labels);
+  auto all_labels = AllLabels(labels);
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (metrics_.count(hash) != 0 || callbacks_.count(hash) != 0) {
+    throw std::invalid_argument("family " + name_ +
+                                " already has a series with the same labels");
+  }
+  callbacks_[hash] = [all_labels, callback](
+      flatbuffers::FlatBufferBuilder* bld,
+      std::vector<metric_collect_t>* metrics) mutable {
+    metrics->push_back(T::CollectValue(callback(), &all_labels, bld));
+  };
+}
+
+template <typename T>
+void Family<T>::RemoveCallback(
     const std::map<std::string, std::string>& labels) {
-  auto combined = std::accumulate(
-      labels.begin(), labels.end(), std::string{},
-      [](const std::string& acc,
-         const std::pair<std::string, std::string>& label_pair) {
-        return acc + label_pair.first + label_pair.second;
-      });
-  return std::hash<std::string>{}(combined);
+  std::lock_guard<std::mutex> lock{mutex_};
+  callbacks_.erase(detail::hash_labels(labels));
 }
 
 template <typename T>
-void Family<T>::Remove(T* metric) {
+std::size_t Family<T>::AddBatchCallback(
+    std::function<void(const SeriesEmitter&)> callback) {
   std::lock_guard<std::mutex> lock{mutex_};
-  if (labels_reverse_lookup_.count(metric) == 0) {
-    return;
+  auto id = next_batch_callback_id_++;
+  batch_callbacks_[id] = [this, callback](
+      flatbuffers::FlatBufferBuilder* bld,
+      std::vector<metric_collect_t>* metrics) {
+    callback([this, bld, metrics](
+        const std::map<std::string, std::string>& labels, double value) {
+      auto all_labels = AllLabels(labels);
+      metrics->push_back(T::CollectValue(value, &all_labels, bld));
+    });
+  };
+  return id;
+}
+
+template <typename T>
+void Family<T>::RemoveBatchCallback(std::size_t id) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  batch_callbacks_.erase(id);
+}
+
+template <typename T>
+label_pair_t Family<T>::AllLabels(
+    const std::map<std::string, std::string>& labels) const {
+  auto all_labels = label_pair_t{constant_labels_.begin(),
+                                 constant_labels_.end()};
+  all_labels.insert(all_labels.end(), labels.begin(), labels.end());
+  return all_labels;
+}
+
+template <typename T>
+void Family<T>::SetIdleTimeout(
+    std::chrono::steady_clock::duration idle_timeout,
+    const std::string& registry) {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    idle_timeout_ = idle_timeout;
+  }
+  auto& sweeper = detail::IdleSweeper::Instance();
+  if (idle_timeout > std::chrono::steady_clock::duration::zero()) {
+    sweeper.Register(this, registry, name_, idle_timeout,
+                     [this](std::chrono::steady_clock::time_point now) {
+                       return EvictIdle(now);
+                     });
+  } else {
+    sweeper.Unregister(this);
+  }
+}
+
+template <typename T>
+std::size_t Family<T>::EvictIdle(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (idle_timeout_ <= std::chrono::steady_clock::duration::zero()) {
+    return 0;
+  }
+
+  std::size_t evicted = 0;
+  for (auto iter = metrics_.begin(); iter != metrics_.end();) {
+    auto series = iter->second;
+    // series seen for the first time start their idle period now
+    if (series->metric.ConsumeUpdated() ||
+        series->last_update == std::chrono::steady_clock::time_point{}) {
+      series->last_update = now;
+    } else if (now - series->last_update >= idle_timeout_) {
+      reverse_index_.erase(&series->metric);
+      storage_.Erase(series);
+      iter = metrics_.erase(iter);
+      ++evicted;
+      continue;
+    }
+    ++iter;
+  }
+  if (evicted > 0) {
+    UpdateSeriesGauge();
   }
+  return evicted;
+}
+
+template <typename T>
+std::size_t Family<T>::capacity() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return storage_.capacity();
+}
+
+template <typename T>
+void Family<T>::SetCacheLineAligned(bool aligned) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  storage_.SetCacheLineAligned(aligned);
+}
+
+template <typename T>
+void Family<T>::SetMaxSeries(std::size_t max_series, Gauge* series_gauge,
+                             Counter* overflow_counter,
+                             std::function<void()> remove_self_metrics) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  max_series_ = max_series;
+  overflow_hash_ = detail::hash_labels(OverflowLabels());
+  series_gauge_ = series_gauge;
+  overflow_counter_ = overflow_counter;
+  remove_self_metrics_ = std::move(remove_self_metrics);
+  UpdateSeriesGauge();
+}
 
-  auto hash = labels_reverse_lookup_.at(metric);
-  metrics_.erase(hash);
-  labels_.erase(hash);
-  labels_reverse_lookup_.erase(metric);
+template <typename T>
+void Family<T>::UpdateSeriesGauge() {
+  if (series_gauge_) {
+    series_gauge_->Set(metrics_.size());
+  }
 }
 
 template <typename T>
@@ -120,10 +372,31 @@ builders_t Family<T>::Collect() {
 
   auto metrics_vec =
       std::vector<flatbuffers::Offset<io::prometheus::client::Metric>>{};
+  metrics_vec.reserve(storage_.size() + callbacks_.size());
   auto bld = make_bld_t();
-  for (const auto& m : metrics_) {
-    metrics_vec.emplace_back(
-        std::move(CollectMetric(m.first, m.second.get(), bld.get())));
+  auto all_labels = label_pair_t{constant_labels_.begin(),
+                                 constant_labels_.end()};
+  auto constant_count = all_labels.size();
+  storage_.ForEach([&](std::size_t, Series* series) {
+    // overwrite the labels of the previous series in place to reuse their
+    // buffers
+    auto size = constant_count;
+    for (const auto& label : series->labels) {
+      if (size < all_labels.size()) {
+        all_labels[size] = label;
+      } else {
+        all_labels.push_back(label);
+      }
+      ++size;
+    }
+    all_labels.resize(size);
+    metrics_vec.emplace_back(series->metric.Collect(&all_labels, bld.get()));
+  });
+  for (auto& callback : callbacks_) {
+    callback.second(bld.get(), &metrics_vec);
+  }
+  for (auto& callback : batch_callbacks_) {
+    callback.second(bld.get(), &metrics_vec);
   }
   auto metrics = bld->CreateVector(metrics_vec);
 
@@ -133,20 +406,4 @@ builders_t Family<T>::Collect() {
   bld->Finish(family);
   return {bld};
 }
-
-template <typename T>
-metric_collect_t Family<T>::CollectMetric(std::size_t hash, T* metric,
-                                          flatbuffers::FlatBufferBuilder* bld) {
-  std::vector<std::pair<std::string, std::string>> all_label;
-  for (const auto& p : constant_labels_) {
-    all_label.emplace_back(p);
-  }
-  const auto& metric_labels = labels_.at(hash);
-  for (const auto& p : metric_labels) {
-    all_label.emplace_back(p);
-  }
-
-  auto collected = metric->Collect(&all_label, bld);
-  return collected;
-}
 }
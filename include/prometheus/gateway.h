@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "collectable.h"
+
+namespace prometheus {
+
+struct GatewayOptions {
+  // Pushes that do not fit into the queue while the sender is busy are
+  // rejected.
+  std::size_t max_queue = 16;
+  // Failed pushes are retried with exponential backoff, starting at
+  // `initial_backoff` and doubling up to `max_backoff`.
+  int max_retries = 5;
+  std::chrono::milliseconds initial_backoff{100};
+  std::chrono::milliseconds max_backoff{10000};
+  // Time limit of a single HTTP request.
+  std::chrono::milliseconds timeout{5000};
+  // Time the destructor spends sending what is still queued. Requests and
+  // backoffs are cut to it, pushes left afterwards are given up on. Zero
+  // drops the queue without sending it.
+  std::chrono::milliseconds shutdown_timeout{10000};
+};
+
+// Client for a Pushgateway, for jobs that finish before they can be scraped.
+// Push() and PushAdd() only collect a snapshot of the registered
+// collectables and queue it; a background thread serializes it to the text
+// format and sends it. A queued snapshot is replaced by a newer one of the
+// same kind, so bursts of pushes become a single request. The destructor
+// sends what is still queued within GatewayOptions::shutdown_timeout.
+class Gateway {
+ public:
+  // `url` is the address of the Pushgateway, e.g. http://localhost:9091.
+  // Metrics are pushed to the group of `job` and `grouping_labels`.
+  Gateway(const std::string& url, const std::string& job,
+          const std::map<std::string, std::string>& grouping_labels = {},
+          const GatewayOptions& options = GatewayOptions{});
+  ~Gateway();
+  Gateway(const Gateway&) = delete;
+  Gateway& operator=(const Gateway&) = delete;
+
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  // Replaces all metrics of the group (HTTP PUT). Returns false if the queue
+  // is full.
+  bool Push();
+  // Replaces only the metrics with the same names (HTTP POST).
+  bool PushAdd();
+
+  // Blocks until all queued pushes were sent or given up on.
+  void Flush();
+
+  // Number of pushes that were given up on after all retries.
+  std::size_t FailedPushes() const;
+
+ private:
+  struct Pending {
+    std::string method;
+    builders_t metrics;
+  };
+
+  bool Enqueue(const std::string& method);
+  void Run();
+  bool Send(const Pending& pending);
+  // Time the next request may take; zero once the shutdown deadline passed.
+  // Runs with mutex_ held.
+  std::chrono::milliseconds RequestTimeout() const;
+
+  const std::string url_;
+  const GatewayOptions options_;
+
+  std::vector<std::weak_ptr<Collectable>> collectables_;
+  std::deque<Pending> queue_;
+  bool sending_ = false;
+  bool stopping_ = false;
+  std::chrono::steady_clock::time_point deadline_;
+  std::size_t failed_pushes_ = 0;
+  mutable std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::condition_variable drained_;
+  std::thread sender_;
+};
+}
@@ -27,6 +27,10 @@ class Gauge : public Metric {
   metric_collect_t Collect(label_pair_t* global_labels,
                            flatbuffers::FlatBufferBuilder* builder) override;
 
+  // Serializes a gauge sample for a value that is not held by a Gauge.
+  static metric_collect_t CollectValue(double value, label_pair_t* labels,
+                                       flatbuffers::FlatBufferBuilder* builder);
+
  private:
   void Change(double);
   std::atomic<double> value_;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <map>
 #include <string>
 
@@ -7,8 +9,15 @@ namespace prometheus {
 
 template <typename T>
 class Family;
+template <typename T>
+class ColumnarFamily;
 class Gauge;
 class Registry;
+template <typename T>
+class SharedFamily;
+class SharedMemorySegment;
+template <typename T, typename Schema>
+class TypedFamily;
 
 namespace detail {
 class GaugeBuilder;
@@ -22,12 +31,36 @@ class GaugeBuilder {
   GaugeBuilder& Labels(const std::map<std::string, std::string>& labels);
   GaugeBuilder& Name(const std::string&);
   GaugeBuilder& Help(const std::string&);
+  // Free series that were not updated for longer than `idle_timeout`.
+  // Eviction invalidates references returned by Family::Add() like
+  // Family::Remove() does, see Family::EvictIdle().
+  GaugeBuilder& IdleTimeout(std::chrono::steady_clock::duration idle_timeout);
+  // Redirect label sets beyond `max_series` distinct ones to a single
+  // overflow series.
+  GaugeBuilder& MaxSeries(std::size_t max_series);
+  // Give every series its own cache lines to avoid false sharing between
+  // series updated from different threads.
+  GaugeBuilder& CacheLineAligned(bool aligned = true);
   Family<Gauge>& Register(Registry&);
+  // Register a family that keeps all values in one contiguous column. Only
+  // Labels, Name and Help apply to columnar families.
+  ColumnarFamily<Gauge>& RegisterColumnar(Registry&);
+  // Register a family whose series live in `segment`. Only Labels, Name and
+  // Help apply to shared families.
+  SharedFamily<Gauge>& RegisterShared(SharedMemorySegment& segment);
+  // Register a family whose label names are fixed by `Schema`, a
+  // prometheus::Labels<...> list. Only Labels, Name and Help apply to
+  // typed families. Defined in typed_family.h.
+  template <typename Schema>
+  TypedFamily<Gauge, Schema>& RegisterTyped(Registry&);
 
  private:
   std::map<std::string, std::string> labels_;
   std::string name_;
   std::string help_;
+  std::chrono::steady_clock::duration idle_timeout_{};
+  std::size_t max_series_ = 0;
+  bool cache_line_aligned_ = false;
 };
 }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "prometheus/counter.h"
@@ -7,6 +9,8 @@
 #include "metrics_generated.h"
 
 namespace prometheus {
+class LocalHistogram;
+
 class Histogram : public Metric {
  public:
   using BucketBoundaries = std::vector<double>;
@@ -17,11 +21,29 @@ class Histogram : public Metric {
   Histogram(const BucketBoundaries& buckets);
 
   void Observe(double value);
+  // Record a single observation that stands for `weight` identical ones, as
+  // produced by sampling instrumentation.
+  void Observe(double value, std::uint64_t weight);
+  // Records `count` observations at once. The batch is bucketed locally and
+  // every touched bucket and the sum are updated once, instead of twice per
+  // observation.
+  void ObserveBatch(const double* values, std::size_t count);
 
   metric_collect_t Collect(label_pair_t* global_labels,
                            flatbuffers::FlatBufferBuilder* builder) override;
 
+  // Serializes a histogram sample from per-bucket (not cumulative) counts
+  // that are not held by a Histogram; the last count is the +Inf bucket.
+  static metric_collect_t CollectValue(
+      const BucketBoundaries& bucket_boundaries,
+      const std::vector<double>& bucket_counts, double sum,
+      label_pair_t* labels, flatbuffers::FlatBufferBuilder* builder);
+
  private:
+  friend class LocalHistogram;
+
+  std::size_t BucketIndex(double value) const;
+
   const BucketBoundaries bucket_boundaries_;
   std::vector<Counter> bucket_counts_;
   Counter sum_;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <map>
 #include <string>
 #include <vector>
@@ -10,6 +12,13 @@ template <typename T>
 class Family;
 class Histogram;
 class Registry;
+template <typename T>
+class SharedFamily;
+class SharedMemorySegment;
+template <typename Layout>
+class StaticHistogram;
+template <typename T, typename Schema>
+class TypedFamily;
 
 namespace detail {
 class HistogramBuilder;
@@ -23,12 +32,39 @@ class HistogramBuilder {
   HistogramBuilder& Labels(const std::map<std::string, std::string>& labels);
   HistogramBuilder& Name(const std::string&);
   HistogramBuilder& Help(const std::string&);
+  // Free series that were not updated for longer than `idle_timeout`.
+  // Eviction invalidates references returned by Family::Add() like
+  // Family::Remove() does, see Family::EvictIdle().
+  HistogramBuilder& IdleTimeout(
+      std::chrono::steady_clock::duration idle_timeout);
+  // Redirect label sets beyond `max_series` distinct ones to a single
+  // overflow series.
+  HistogramBuilder& MaxSeries(std::size_t max_series);
+  // Give every series its own cache lines to avoid false sharing between
+  // series updated from different threads.
+  HistogramBuilder& CacheLineAligned(bool aligned = true);
   Family<Histogram>& Register(Registry&);
+  // Register a family whose series live in `segment`. Only Labels, Name and
+  // Help apply to shared families.
+  SharedFamily<Histogram>& RegisterShared(SharedMemorySegment& segment);
+  // Register a family of histograms whose bucket layout is the compile-time
+  // `Layout`, e.g. prometheus::Buckets<1, 5, 10>. MaxSeries does not apply
+  // to static histogram families. Defined in static_histogram.h.
+  template <typename Layout>
+  Family<StaticHistogram<Layout>>& RegisterStatic(Registry&);
+  // Register a family whose label names are fixed by `Schema`, a
+  // prometheus::Labels<...> list. Only Labels, Name and Help apply to
+  // typed families. Defined in typed_family.h.
+  template <typename Schema>
+  TypedFamily<Histogram, Schema>& RegisterTyped(Registry&);
 
  private:
   std::map<std::string, std::string> labels_;
   std::string name_;
   std::string help_;
+  std::chrono::steady_clock::duration idle_timeout_{};
+  std::size_t max_series_ = 0;
+  bool cache_line_aligned_ = false;
 };
 }
 }
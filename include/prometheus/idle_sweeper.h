@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace prometheus {
+namespace detail {
+
+// Background thread that periodically asks families with an idle timeout to
+// evict series that have not been updated recently. A single thread serves
+// the whole process; it is started when the first family registers.
+class IdleSweeper {
+ public:
+  using Sweep =
+      std::function<std::size_t(std::chrono::steady_clock::time_point)>;
+
+  static IdleSweeper& Instance();
+
+  // `registry` and `name` identify the family in the evicted series metric.
+  void Register(const void* family, const std::string& registry,
+                const std::string& name,
+                std::chrono::steady_clock::duration idle_timeout, Sweep sweep);
+  void Unregister(const void* family);
+
+ private:
+  struct Entry {
+    std::string registry;
+    std::string name;
+    std::chrono::steady_clock::duration idle_timeout;
+    Sweep sweep;
+  };
+
+  IdleSweeper() = default;
+  void Run();
+  std::chrono::steady_clock::duration Interval() const;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::unordered_map<const void*, Entry> families_;
+  bool running_ = false;
+};
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace prometheus {
+namespace detail {
+
+inline std::uint64_t HashLabelBytes(std::uint64_t hash, const char* data,
+                                    std::size_t size) {
+  // FNV-1a over the bytes, followed by the length so that ("ab", "c") and
+  // ("a", "bc") differ
+  for (std::size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+  }
+  return (hash ^ size) * 0x100000001b3ULL;
+}
+
+// Hashes names and values in place, so that looking up an existing series
+// allocates nothing.
+inline std::size_t hash_labels(
+    const std::map<std::string, std::string>& labels) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const auto& label_pair : labels) {
+    hash = HashLabelBytes(hash, label_pair.first.data(),
+                          label_pair.first.size());
+    hash = HashLabelBytes(hash, label_pair.second.data(),
+                          label_pair.second.size());
+  }
+  return static_cast<std::size_t>(hash);
+}
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "collectable.h"
+
+namespace prometheus {
+
+struct LineProtocolExporterOptions {
+  // Time between two collections. A zero interval disables the background
+  // collection, metrics are then only sent on SendNow().
+  std::chrono::milliseconds interval{10000};
+  // Lines are packed into datagrams of at most this many bytes. The default
+  // fits an Ethernet frame together with IPv6 and UDP headers.
+  std::size_t max_datagram_size = 1432;
+};
+
+// Sends the registered collectables in the InfluxDB line protocol to a
+// Telegraf socket_listener, without the overhead of HTTP. `address` uses
+// Telegraf's notation, e.g. udp://localhost:8094 or
+// unixgram:///run/telegraf.sock. The socket is non-blocking: a datagram the
+// kernel does not accept right away is dropped instead of stalling the
+// sender.
+class LineProtocolExporter {
+ public:
+  // Throws std::invalid_argument if `address` cannot be parsed or resolved.
+  explicit LineProtocolExporter(
+      const std::string& address,
+      const LineProtocolExporterOptions& options =
+          LineProtocolExporterOptions{});
+  ~LineProtocolExporter();
+  LineProtocolExporter(const LineProtocolExporter&) = delete;
+  LineProtocolExporter& operator=(const LineProtocolExporter&) = delete;
+
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  // Collects all registered collectables and sends them right away.
+  void SendNow();
+
+  std::size_t SentDatagrams() const { return sent_datagrams_.load(); }
+  // Datagrams the socket did not accept, and lines that do not fit into a
+  // datagram on their own.
+  std::size_t DroppedDatagrams() const { return dropped_datagrams_.load(); }
+
+ private:
+  void Run();
+  void SendDatagram(const char* data, std::size_t size);
+
+  const LineProtocolExporterOptions options_;
+  int fd_ = -1;
+  std::vector<unsigned char> address_;
+
+  std::vector<std::weak_ptr<Collectable>> collectables_;
+  std::atomic<std::size_t> sent_datagrams_{0};
+  std::atomic<std::size_t> dropped_datagrams_{0};
+  bool stopping_ = false;
+  std::mutex mutex_;
+  std::mutex send_mutex_;
+  std::condition_variable wakeup_;
+  std::thread sender_;
+};
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "counter.h"
+#include "histogram.h"
+#include "metric.h"
+
+namespace prometheus {
+
+struct LocalRecorderOptions {
+  // Longest time an update may stay unpublished before the background
+  // flusher publishes it. Zero disables periodic flushing.
+  std::chrono::steady_clock::duration max_staleness = std::chrono::seconds(1);
+  // The recording thread publishes by itself after this many updates. Zero
+  // disables the threshold.
+  std::size_t max_pending_updates = 4096;
+};
+
+namespace detail {
+
+class LocalRecorder {
+ public:
+  LocalRecorder(Metric& target, const LocalRecorderOptions& options);
+  virtual ~LocalRecorder() = default;
+
+  // Publishes everything recorded so far to the target metric. Safe to call
+  // from any thread.
+  void Flush();
+
+  const Metric& target() const { return target_; }
+  const LocalRecorderOptions& options() const { return options_; }
+  std::chrono::steady_clock::time_point last_flush() const;
+
+ protected:
+  // Registers with the background flusher; called by the constructors of
+  // derived classes once their state is initialized.
+  void Start();
+  // Unregisters and publishes what is left; called by the destructors of
+  // derived classes while their state is still alive.
+  void Stop();
+
+  // Called by the recording thread after every update.
+  void Recorded() {
+    if (options_.max_pending_updates != 0 &&
+        ++pending_updates_ >= options_.max_pending_updates) {
+      pending_updates_ = 0;
+      Flush();
+    }
+  }
+
+ private:
+  // Adds the difference between the recorded and the published totals to
+  // the target; runs with flush_mutex_ held.
+  virtual void Publish() = 0;
+
+  Metric& target_;
+  const LocalRecorderOptions options_;
+  // touched by the recording thread only; flushes from other threads do not
+  // reset it, which at worst publishes early once
+  std::size_t pending_updates_ = 0;
+  std::mutex flush_mutex_;
+  std::atomic<std::chrono::steady_clock::rep> last_flush_;
+};
+
+// Background thread that publishes local recorders whose oldest unpublished
+// update approaches their staleness bound, and the registry through which
+// Collect() of a metric publishes the recorders writing to it. A single
+// thread serves the whole process; it is started when the first recorder
+// with a staleness bound registers.
+class LocalFlusher {
+ public:
+  static LocalFlusher& Instance();
+
+  void Register(LocalRecorder* recorder);
+  void Unregister(LocalRecorder* recorder);
+  // Publishes all recorders of `metric`.
+  void FlushMetric(const Metric* metric);
+
+ private:
+  LocalFlusher() = default;
+  void Run();
+  std::chrono::steady_clock::duration Interval() const;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::unordered_multimap<const Metric*, LocalRecorder*> recorders_;
+  bool running_ = false;
+};
+}  // namespace detail
+
+// Write-combining front end of a Counter for one thread. Increments only
+// touch memory owned by the recording thread and are published to the
+// counter in one atomic add when max_pending_updates is reached, when the
+// background flusher finds them older than half of max_staleness, when the
+// counter is collected, and when the recorder is destroyed. Declare it
+// thread_local to publish at thread exit:
+//
+//   thread_local LocalCounter requests{family.Add({{"path", "/"}})};
+//   requests.Increment();
+//
+// A recorder must only be updated by one thread and must not outlive its
+// counter. Counter::Value() does not include unpublished updates.
+class LocalCounter : public detail::LocalRecorder {
+ public:
+  explicit LocalCounter(Counter& counter,
+                        const LocalRecorderOptions& options = {});
+  ~LocalCounter();
+
+  void Increment() { Increment(1.0); }
+  void Increment(double value) {
+    if (value < 0.0) {
+      return;
+    }
+    total_.store(total_.load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+    Recorded();
+  }
+
+ private:
+  void Publish() override;
+
+  Counter& counter_;
+  // written by the recording thread only, read when publishing
+  std::atomic<double> total_;
+  double published_ = 0.0;
+};
+
+// Write-combining front end of a Histogram for one thread; see LocalCounter.
+class LocalHistogram : public detail::LocalRecorder {
+ public:
+  explicit LocalHistogram(Histogram& histogram,
+                          const LocalRecorderOptions& options = {});
+  ~LocalHistogram();
+
+  void Observe(double value) {
+    auto& count = counts_[BucketIndex(value)];
+    count.store(count.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+    // Histogram::Observe() drops negative values from the sum
+    if (!(value < 0.0)) {
+      sum_.store(sum_.load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+    }
+    Recorded();
+  }
+
+ private:
+  std::size_t BucketIndex(double value) const;
+  void Publish() override;
+
+  Histogram& histogram_;
+  const Histogram::BucketBoundaries bucket_boundaries_;
+  // written by the recording thread only, read when publishing
+  std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+  std::atomic<double> sum_;
+  std::vector<std::uint64_t> published_counts_;
+  double published_sum_ = 0.0;
+};
+}  // namespace prometheus
@@ -1,10 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <utility>
 #include <vector>
 #include "metrics_generated.h"
 
 namespace prometheus {
+class Metric;
+
+namespace detail {
+class LocalFlusher;
+void FlushLocalRecorders(const Metric* metric);
+}
+
 using label_pair_t = std::vector<std::pair<std::string, std::string>>;
 using metric_collect_t = flatbuffers::Offset<io::prometheus::client::Metric>;
 
@@ -13,5 +22,28 @@ class Metric {
   virtual ~Metric() = default;
   virtual metric_collect_t Collect(label_pair_t* global_labels,
                                    flatbuffers::FlatBufferBuilder* builder) = 0;
+
+  // Returns whether the metric was updated since the previous call. Updates
+  // only store a flag, so idle series can be found without a clock read on
+  // the update path.
+  bool ConsumeUpdated() {
+    return updated_.load(std::memory_order_relaxed) &&
+           updated_.exchange(false, std::memory_order_relaxed);
+  }
+
+ protected:
+  void MarkUpdated() { updated_.store(true, std::memory_order_relaxed); }
+  // Publishes the updates still held by LocalCounter and LocalHistogram
+  // recorders of this metric; a single load when there are none.
+  void FlushLocalRecorders() const {
+    if (local_recorders_.load(std::memory_order_relaxed) != 0) {
+      detail::FlushLocalRecorders(this);
+    }
+  }
+
+ private:
+  friend class detail::LocalFlusher;
+  std::atomic<bool> updated_{false};
+  mutable std::atomic<std::uint32_t> local_recorders_{0};
 };
 }
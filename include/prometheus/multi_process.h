@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "collectable.h"
+#include "shared_memory.h"
+
+namespace prometheus {
+
+namespace detail {
+struct RecordView;
+}
+
+// How the gauges of several workers are combined into one series.
+enum class GaugeMode {
+  kSum,
+  kMin,
+  kMax,
+  // value of the most recently started worker
+  kLatest,
+  // one series per worker, told apart by a pid label; gauges with a pid
+  // label of their own get a worker_pid label instead
+  kPerProcess,
+};
+
+struct MultiProcessOptions {
+  GaugeMode default_gauge_mode = GaugeMode::kSum;
+  // Overrides of the gauge mode by family name.
+  std::map<std::string, GaugeMode> gauge_modes;
+};
+
+// Creates the segment of the calling worker in `directory`, shared with the
+// MultiProcessCollector of the parent. Call it in the worker after fork();
+// every call creates a new file, so a restarted worker never takes over the
+// values of its predecessor.
+std::unique_ptr<SharedMemorySegment> CreateWorkerSegment(
+    const std::string& directory, std::size_t size = 16 << 20);
+
+// Aggregates the segments that pre-forked workers keep in one directory, so
+// a single Exposer in the parent serves the metrics of all of them. At every
+// Collect() counters and histograms are summed over all workers, gauges are
+// combined according to their GaugeMode.
+//
+// Workers that exited still count: their counters and histograms are folded
+// into totals kept by the collector and their file is removed, so sums never
+// go backwards when a worker dies or is restarted. Gauges of exited workers
+// are dropped. A worker counts as exited once its parent reaped it.
+class MultiProcessCollector : public Collectable {
+ public:
+  explicit MultiProcessCollector(
+      const std::string& directory,
+      const MultiProcessOptions& options = MultiProcessOptions{});
+  ~MultiProcessCollector();
+  MultiProcessCollector(const MultiProcessCollector&) = delete;
+  MultiProcessCollector& operator=(const MultiProcessCollector&) = delete;
+
+  // Collectable
+  builders_t Collect() override;
+
+  // Number of records Collect() left out because their type or buckets
+  // disagree with another record of the same series, e.g. while workers of
+  // two releases run side by side. Counted again at every Collect().
+  std::size_t DroppedRecords() const;
+
+ private:
+  GaugeMode ModeOf(const std::string& name) const;
+
+  const std::string directory_;
+  const MultiProcessOptions options_;
+
+  // counters and histograms of exited workers, by series key
+  std::map<std::string, std::unique_ptr<detail::RecordView>> archived_;
+  std::vector<std::string> archived_order_;
+  std::size_t dropped_records_ = 0;
+  mutable std::mutex mutex_;
+};
+}
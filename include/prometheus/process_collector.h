@@ -0,0 +1,60 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <mutex>
+
+#include "collectable.h"
+
+namespace prometheus {
+
+// Exposes the standard process_* metrics of the calling process, read from
+// /proc. Files are opened once and re-read with pread into fixed buffers, so
+// a scrape performs no path lookups and no allocations besides the output.
+// They are opened by pid rather than through /proc/self, which an open file
+// keeps pointing to its opener; a collector used in a forked child notices
+// the new pid and reopens them. Metrics whose source is unavailable (e.g.
+// outside Linux) are left out.
+class ProcessCollector : public Collectable {
+ public:
+  // Scrapes arriving within `min_interval` of the previous read are served
+  // the values of that read.
+  explicit ProcessCollector(std::chrono::steady_clock::duration min_interval =
+                                std::chrono::steady_clock::duration::zero());
+  ~ProcessCollector();
+  ProcessCollector(const ProcessCollector&) = delete;
+  ProcessCollector& operator=(const ProcessCollector&) = delete;
+
+  // Collectable
+  builders_t Collect() override;
+
+ private:
+  struct Values {
+    double cpu_seconds = -1;
+    double resident_memory_bytes = -1;
+    double virtual_memory_bytes = -1;
+    double open_fds = -1;
+    double max_fds = -1;
+  };
+
+  // Opens the files of the calling process and reads its start time.
+  void Open();
+  void Close();
+  void Read();
+
+  const std::chrono::steady_clock::duration min_interval_;
+  pid_t pid_;
+  int stat_fd_;
+  int statm_fd_;
+  int fd_dir_fd_;
+  double start_time_seconds_ = -1;
+  double page_size_;
+  double ticks_per_second_;
+
+  std::mutex mutex_;
+  Values values_;
+  bool read_once_ = false;
+  std::chrono::steady_clock::time_point last_read_;
+};
+}
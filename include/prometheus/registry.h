@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
 
 #include "prometheus/collectable.h"
 #include "prometheus/counter_builder.h"
@@ -23,8 +28,11 @@ class Registry : public Collectable {
   friend class detail::GaugeBuilder;
   friend class detail::HistogramBuilder;
 
-  Registry() = default;
+  Registry();
   static std::shared_ptr<Registry> Create(Exposer&);
+  // Process-unique id that tells same-named families of different
+  // registries apart in the library's self-metrics.
+  const std::string& Id() const { return id_; }
   // collectable
   virtual builders_t Collect() override;
 
@@ -36,8 +44,83 @@ class Registry : public Collectable {
   Family<Histogram>& AddHistogram(
       const std::string& name, const std::string& help,
       const std::map<std::string, std::string>& labels);
+  // Returns the family registered under `name`, creating it on first use.
+  // Throws std::invalid_argument if the existing family has a different type
+  // or different constant labels.
+  template <typename F>
+  F& Add(const std::string& name, const std::string& help,
+         const std::map<std::string, std::string>& labels);
 
+  // Append-only list of families read by Collect() without taking mutex_.
+  // Entries below `size` are never written again; when the array is full a
+  // copy with twice the capacity is published instead, and scrapes still
+  // reading the old one keep reading their consistent prefix.
+  struct Snapshot {
+    explicit Snapshot(std::size_t capacity)
+        : items(new Collectable*[capacity]), capacity(capacity), size(0) {}
+    std::unique_ptr<Collectable*[]> items;
+    const std::size_t capacity;
+    std::atomic<std::size_t> size;
+  };
+
+  // Open addressing table from family name to family. Slots are filled once
+  // and never cleared, so lookups need no lock; when it gets half full a
+  // table of twice the size is published and lookups that still see the old
+  // one fall back to the locked path on a miss.
+  //
+  // Readers load a plain atomic pointer to the current snapshot and index,
+  // which is lock-free, unlike std::atomic_load() of a std::shared_ptr.
+  // Replaced tables are kept until the registry is destroyed, so a reader
+  // never sees one freed; as each table doubles the previous one, they take
+  // less memory than the current table.
+  struct IndexEntry {
+    std::string name;
+    const std::type_info* type;
+    std::map<std::string, std::string> constant_labels;
+    Collectable* collectable;
+  };
+  struct NameIndex {
+    explicit NameIndex(std::size_t capacity);
+    std::unique_ptr<std::atomic<const IndexEntry*>[]> slots;
+    const std::size_t capacity;
+  };
+
+  void Publish(Collectable* collectable);
+  const IndexEntry* Find(const std::string& name) const;
+  const IndexEntry* AddToIndex(
+      const std::string& name, const std::type_info& type,
+      const std::map<std::string, std::string>& constant_labels,
+      Collectable* collectable);
+  static void CheckCompatible(
+      const IndexEntry& entry, const std::type_info& type,
+      const std::map<std::string, std::string>& constant_labels);
+
+  // Owns every family; only touched with mutex_ held.
   std::vector<std::unique_ptr<Collectable>> collectables_;
+  std::vector<std::unique_ptr<Snapshot>> snapshots_;
+  std::atomic<Snapshot*> snapshot_;
+  std::vector<std::unique_ptr<IndexEntry>> index_entries_;
+  std::vector<std::unique_ptr<NameIndex>> indexes_;
+  std::atomic<NameIndex*> index_;
+  const std::string id_;
   std::mutex mutex_;
 };
+
+template <typename F>
+F& Registry::Add(const std::string& name, const std::string& help,
+                 const std::map<std::string, std::string>& labels) {
+  auto entry = Find(name);
+  if (!entry) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    entry = Find(name);
+    if (!entry) {
+      auto family = new F(name, help, labels);
+      collectables_.push_back(std::unique_ptr<Collectable>{family});
+      Publish(family);
+      entry = AddToIndex(name, typeid(F), labels, family);
+    }
+  }
+  CheckCompatible(*entry, typeid(F), labels);
+  return *static_cast<F*>(entry->collectable);
+}
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "collectable.h"
+
+namespace prometheus {
+
+struct RemoteWriteOptions {
+  // Time between two collections. A zero interval disables the background
+  // collection, samples are then only sent on CollectNow().
+  std::chrono::milliseconds interval{15000};
+  // Series are spread over this many senders by their labels, so one slow
+  // request does not hold back all others.
+  std::size_t shards = 2;
+  std::size_t max_samples_per_send = 500;
+  // Batches that do not fit into the queue of their shard are dropped.
+  std::size_t max_pending_batches = 64;
+  // Failed requests are retried with exponential backoff, starting at
+  // `initial_backoff` and doubling up to `max_backoff`.
+  int max_retries = 5;
+  std::chrono::milliseconds initial_backoff{100};
+  std::chrono::milliseconds max_backoff{10000};
+  // Time limit of a single HTTP request.
+  std::chrono::milliseconds timeout{5000};
+  // Time the destructor spends sending what is still queued. Requests and
+  // backoffs are cut to it, batches left afterwards are dropped. Zero drops
+  // the queues without sending them.
+  std::chrono::milliseconds shutdown_timeout{10000};
+};
+
+// Pushes the registered collectables to a Prometheus remote-write endpoint,
+// e.g. http://localhost:9090/api/v1/write. Every collection is flattened
+// into time series, split into batches of at most `max_samples_per_send`
+// samples and sent as snappy-compressed WriteRequest protobuf messages. The
+// destructor collects one last time and sends what is still queued within
+// RemoteWriteOptions::shutdown_timeout.
+class RemoteWriteExporter {
+ public:
+  explicit RemoteWriteExporter(
+      const std::string& url,
+      const RemoteWriteOptions& options = RemoteWriteOptions{});
+  ~RemoteWriteExporter();
+  RemoteWriteExporter(const RemoteWriteExporter&) = delete;
+  RemoteWriteExporter& operator=(const RemoteWriteExporter&) = delete;
+
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  // Collects all registered collectables and queues their samples.
+  void CollectNow();
+
+  // Blocks until all queued batches were sent or given up on.
+  void Flush();
+
+  // Number of batches that were given up on after all retries.
+  std::size_t FailedBatches() const;
+  // Number of batches that were dropped because their queue was full.
+  std::size_t DroppedBatches() const;
+
+ private:
+  class Shard;
+
+  void Run();
+
+  const RemoteWriteOptions options_;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::vector<std::weak_ptr<Collectable>> collectables_;
+  bool stopping_ = false;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::thread collector_;
+};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+#include "histogram.h"
+
+namespace prometheus {
+
+namespace detail {
+// Per-thread pseudo random source for sampling decisions: a thread-local
+// counter run through the splitmix64 finalizer. Threads never share state and
+// no clock is read for calls that end up not being sampled.
+inline std::uint64_t NextSamplingRandom() {
+  static thread_local std::uint64_t counter = 0;
+  auto z = (counter += 0x9e3779b97f4a7c15ULL) ^
+           static_cast<std::uint64_t>(
+               reinterpret_cast<std::uintptr_t>(&counter));
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+inline std::uint64_t SamplingThreshold(std::uint64_t rate) {
+  return rate <= 1 ? std::numeric_limits<std::uint64_t>::max()
+                   : std::numeric_limits<std::uint64_t>::max() / rate;
+}
+}  // namespace detail
+
+// Times one in `rate` calls on average; every sampled observation carries a
+// weight of `rate` so that _count and _sum stay unbiased.
+class FixedRateSampler {
+ public:
+  explicit FixedRateSampler(std::uint64_t rate)
+      : rate_(rate == 0 ? 1 : rate),
+        threshold_(detail::SamplingThreshold(rate_)) {}
+
+  // Returns 0 if the current call should not be timed, otherwise the number
+  // of calls the observation stands for.
+  std::uint64_t Sample() const {
+    return detail::NextSamplingRandom() <= threshold_ ? rate_ : 0;
+  }
+  void Sampled(std::chrono::steady_clock::time_point) {}
+
+ private:
+  const std::uint64_t rate_;
+  const std::uint64_t threshold_;
+};
+
+// Adjusts its sampling rate once per second so that roughly
+// `observations_per_second` calls are timed, independent of the call rate.
+class AdaptiveSampler {
+ public:
+  explicit AdaptiveSampler(double observations_per_second);
+
+  std::uint64_t Sample() const {
+    auto threshold = threshold_.load(std::memory_order_relaxed);
+    if (detail::NextSamplingRandom() > threshold) {
+      return 0;
+    }
+    return std::numeric_limits<std::uint64_t>::max() / threshold;
+  }
+  void Sampled(std::chrono::steady_clock::time_point now);
+
+  std::uint64_t Rate() const;
+
+ private:
+  const double observations_per_second_;
+  std::atomic<std::uint64_t> threshold_;
+  std::atomic<std::uint64_t> sampled_in_window_;
+  std::atomic<std::chrono::steady_clock::rep> window_start_;
+};
+
+template <typename Sampler>
+class SamplingMarker {
+ public:
+  SamplingMarker(Histogram& histogram, Sampler& sampler)
+      : histogram_(histogram), sampler_(sampler), weight_(sampler.Sample()) {
+    if (weight_ != 0) {
+      time_point_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~SamplingMarker() {
+    if (weight_ == 0) {
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto diff = std::chrono::duration_cast<std::chrono::microseconds>(
+                    now - time_point_).count();
+    histogram_.Observe(diff, weight_);
+    sampler_.Sampled(now);
+  }
+
+ private:
+  Histogram& histogram_;
+  Sampler& sampler_;
+  const std::uint64_t weight_;
+  std::chrono::steady_clock::time_point time_point_;
+};
+}  // namespace prometheus
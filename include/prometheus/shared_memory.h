@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "check_names.h"
+#include "collectable.h"
+#include "columnar_family.h"
+#include "counter.h"
+#include "gauge.h"
+#include "histogram.h"
+#include "label_hash.h"
+#include "metric.h"
+
+namespace prometheus {
+
+class SharedMemorySegment;
+template <typename T>
+class SharedFamily;
+
+// Handle to one series of a SharedFamily<Histogram>. Bucket counts and the
+// sum live in the segment, the bounds are read from there as well.
+class HistogramRef {
+ public:
+  HistogramRef(const double* bounds, std::size_t bound_count,
+               std::atomic<double>* values)
+      : bounds_(bounds), bound_count_(bound_count), values_(values) {}
+
+  void Observe(double value) {
+    auto bucket = static_cast<std::size_t>(
+        std::find_if(bounds_, bounds_ + bound_count_,
+                     [value](double bound) { return bound > value; }) -
+        bounds_);
+    detail::AtomicAdd(values_ + bucket, 1.0);
+    // negative values are dropped from the sum like in Histogram::Observe()
+    if (!(value < 0.0)) {
+      detail::AtomicAdd(values_ + bound_count_ + 1, value);
+    }
+  }
+
+ private:
+  friend struct detail::SharedTraits<Histogram>;
+  const double* bounds_;
+  std::size_t bound_count_;
+  std::atomic<double>* values_;
+};
+
+namespace detail {
+
+// Where a series was placed in a segment.
+struct SharedSeries {
+  std::atomic<double>* values;
+  const double* bounds;
+  std::size_t offset;
+};
+
+class SharedFamilyBase {
+ public:
+  virtual ~SharedFamilyBase() = default;
+};
+
+template <typename T>
+struct SharedTraits;
+
+template <>
+struct SharedTraits<Counter> {
+  using Handle = CounterRef;
+  static Handle MakeHandle(const SharedSeries& series, std::size_t) {
+    return Handle{series.values};
+  }
+  static std::atomic<double>* Values(const Handle& handle) {
+    return handle.value_;
+  }
+};
+
+template <>
+struct SharedTraits<Gauge> {
+  using Handle = GaugeRef;
+  static Handle MakeHandle(const SharedSeries& series, std::size_t) {
+    return Handle{series.values};
+  }
+  static std::atomic<double>* Values(const Handle& handle) {
+    return handle.value_;
+  }
+};
+
+template <>
+struct SharedTraits<Histogram> {
+  using Handle = HistogramRef;
+  static Handle MakeHandle(const SharedSeries& series,
+                           std::size_t bound_count) {
+    return Handle{series.bounds, bound_count, series.values};
+  }
+  static std::atomic<double>* Values(const Handle& handle) {
+    return handle.values_;
+  }
+};
+}  // namespace detail
+
+// Family whose series live in a SharedMemorySegment. Handles update the
+// mapped values in place, so a reader in another process sees every update
+// without involving this process at scrape time.
+template <typename T>
+class SharedFamily : public detail::SharedFamilyBase {
+ public:
+  using Handle = typename detail::SharedTraits<T>::Handle;
+
+  SharedFamily(SharedMemorySegment& segment, const std::string& name,
+               const std::string& help,
+               const std::map<std::string, std::string>& constant_labels);
+
+  // Adds a counter or gauge series. Throws std::length_error if the segment
+  // is full.
+  Handle Add(const std::map<std::string, std::string>& labels);
+  // Adds a histogram series.
+  Handle Add(const std::map<std::string, std::string>& labels,
+             const Histogram::BucketBoundaries& buckets);
+  // Hides the series from readers. Its space in the segment is not reused.
+  void Remove(Handle handle);
+
+ private:
+  Handle AddSeries(const std::map<std::string, std::string>& labels,
+                   const std::vector<double>& bounds);
+
+  SharedMemorySegment& segment_;
+  const std::string name_;
+  const std::string help_;
+  const std::map<std::string, std::string> constant_labels_;
+
+  std::unordered_map<std::size_t, Handle> index_;
+  std::unordered_map<const std::atomic<double>*,
+                     std::pair<std::size_t, std::size_t>>
+      reverse_index_;
+  std::mutex mutex_;
+};
+
+enum class SegmentMode {
+  // Start empty, replacing an existing file.
+  kCreate,
+  // Keep the series of an existing segment at `path`, e.g. to carry
+  // counters across restarts. Falls back to kCreate if there is none.
+  kRestore,
+};
+
+// Memory-mapped file holding the series of shared families, e.g. for a
+// sidecar agent that reads them with SharedMemoryReader or the
+// read_shared_metrics tool instead of scraping this process over HTTP.
+// The segment has a fixed size; series are appended until it is full.
+// Collect() reads the segment back, so it can also be registered with an
+// Exposer.
+//
+// With SegmentMode::kRestore the file doubles as a checkpoint: values are
+// updated in place in the page cache, so they survive a crash of the
+// process. A restored series is exposed right away and reattached when its
+// family adds the same labels again. Counters and histograms keep their
+// values, gauges restart at zero. Restored series that are never added again,
+// e.g. label sets a new release no longer uses, stay exposed until
+// RetireRestored().
+class SharedMemorySegment : public Collectable {
+ public:
+  // Throws std::runtime_error if the file cannot be created or mapped. A
+  // restored segment grows to `size` but never shrinks.
+  explicit SharedMemorySegment(const std::string& path,
+                               std::size_t size = 16 << 20,
+                               SegmentMode mode = SegmentMode::kCreate);
+  // Unmaps the segment. The file is left in place with its last values.
+  ~SharedMemorySegment();
+  SharedMemorySegment(const SharedMemorySegment&) = delete;
+  SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+  // Writes the values back to disk and waits for it, so they also survive
+  // a crash of the machine.
+  void Checkpoint();
+
+  // Removes the restored series that were not added again since the segment
+  // was restored and returns their number. Call it once the process added
+  // the series it still uses, e.g. at the end of its startup.
+  std::size_t RetireRestored();
+
+  // Returns the family registered under `name`, creating it on first use.
+  // Throws std::invalid_argument if the existing family has a different type
+  // or different constant labels.
+  template <typename T>
+  SharedFamily<T>& Family(
+      const std::string& name, const std::string& help,
+      const std::map<std::string, std::string>& constant_labels);
+
+  // Collectable
+  builders_t Collect() override;
+
+ private:
+  template <typename T>
+  friend class SharedFamily;
+
+  detail::SharedSeries AddSeries(io::prometheus::client::MetricType type,
+                                 const std::string& name,
+                                 const std::string& help,
+                                 const label_pair_t& labels,
+                                 std::size_t value_count,
+                                 const std::vector<double>& bounds);
+  void RemoveSeries(std::size_t offset);
+  void Create(const std::string& path);
+  bool Restore(const std::string& path);
+
+  struct FamilyEntry {
+    const std::type_info* type;
+    std::map<std::string, std::string> constant_labels;
+    std::unique_ptr<detail::SharedFamilyBase> family;
+  };
+
+  unsigned char* base_ = nullptr;
+  std::size_t size_;
+  std::map<std::string, FamilyEntry> families_;
+  // offsets of the restored series not yet reattached, by
+  // detail::SeriesHash()
+  std::unordered_multimap<std::size_t, std::size_t> restored_;
+  std::mutex mutex_;
+};
+
+// Reads a segment written by another process. Every Collect() reads the
+// current values straight from the mapping; if the file was replaced, e.g.
+// because the process restarted, the new one is mapped.
+class SharedMemoryReader : public Collectable {
+ public:
+  explicit SharedMemoryReader(const std::string& path);
+  ~SharedMemoryReader();
+  SharedMemoryReader(const SharedMemoryReader&) = delete;
+  SharedMemoryReader& operator=(const SharedMemoryReader&) = delete;
+
+  // Collectable; empty while the file is missing or not a valid segment.
+  builders_t Collect() override;
+
+ private:
+  void Remap();
+  void Unmap();
+
+  const std::string path_;
+  const unsigned char* base_ = nullptr;
+  std::size_t size_ = 0;
+  std::uint64_t device_ = 0;
+  std::uint64_t inode_ = 0;
+  std::mutex mutex_;
+};
+
+template <typename T>
+SharedFamily<T>::SharedFamily(
+    SharedMemorySegment& segment, const std::string& name,
+    const std::string& help,
+    const std::map<std::string, std::string>& constant_labels)
+    : segment_(segment),
+      name_(name),
+      help_(help),
+      constant_labels_(constant_labels) {
+  assert(CheckMetricName(name_));
+}
+
+template <typename T>
+typename SharedFamily<T>::Handle SharedFamily<T>::Add(
+    const std::map<std::string, std::string>& labels) {
+  static_assert(!std::is_same<T, Histogram>::value,
+                "histogram series need bucket boundaries");
+  return AddSeries(labels, {});
+}
+
+template <typename T>
+typename SharedFamily<T>::Handle SharedFamily<T>::Add(
+    const std::map<std::string, std::string>& labels,
+    const Histogram::BucketBoundaries& buckets) {
+  static_assert(std::is_same<T, Histogram>::value,
+                "only histogram series have bucket boundaries");
+  assert(std::is_sorted(buckets.begin(), buckets.end()));
+  return AddSeries(labels, buckets);
+}
+
+template <typename T>
+typename SharedFamily<T>::Handle SharedFamily<T>::AddSeries(
+    const std::map<std::string, std::string>& labels,
+    const std::vector<double>& bounds) {
+#ifndef NDEBUG
+  for (auto& label_pair : labels) {
+    auto& label_name = label_pair.first;
+    assert(CheckLabelName(label_name));
+  }
+#endif
+
+  auto hash = detail::hash_labels(labels);
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto index_iter = index_.find(hash);
+  if (index_iter != index_.end()) {
+    return index_iter->second;
+  }
+
+  auto all_labels = label_pair_t{constant_labels_.begin(),
+                                 constant_labels_.end()};
+  all_labels.insert(all_labels.end(), labels.begin(), labels.end());
+  // histograms keep a count per bucket including +Inf and the sum
+  auto value_count =
+      std::is_same<T, Histogram>::value ? bounds.size() + 2 : std::size_t{1};
+  auto series = segment_.AddSeries(T::metric_type, name_, help_, all_labels,
+                                   value_count, bounds);
+  auto handle = detail::SharedTraits<T>::MakeHandle(series, bounds.size());
+  index_.insert({hash, handle});
+  reverse_index_.insert({series.values, {hash, series.offset}});
+  return handle;
+}
+
+template <typename T>
+void SharedFamily<T>::Remove(Handle handle) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto reverse_iter =
+      reverse_index_.find(detail::SharedTraits<T>::Values(handle));
+  if (reverse_iter == reverse_index_.end()) {
+    return;
+  }
+  index_.erase(reverse_iter->second.first);
+  segment_.RemoveSeries(reverse_iter->second.second);
+  reverse_index_.erase(reverse_iter);
+}
+
+template <typename T>
+SharedFamily<T>& SharedMemorySegment::Family(
+    const std::string& name, const std::string& help,
+    const std::map<std::string, std::string>& constant_labels) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto iter = families_.find(name);
+  if (iter == families_.end()) {
+    auto family = new SharedFamily<T>(*this, name, help, constant_labels);
+    families_.insert(
+        {name, FamilyEntry{&typeid(T), constant_labels,
+                           std::unique_ptr<detail::SharedFamilyBase>{family}}});
+    return *family;
+  }
+  if (*iter->second.type != typeid(T)) {
+    throw std::invalid_argument("family " + name +
+                                " is already registered with another type");
+  }
+  if (iter->second.constant_labels != constant_labels) {
+    throw std::invalid_argument(
+        "family " + name +
+        " is already registered with other constant labels");
+  }
+  return *static_cast<SharedFamily<T>*>(iter->second.family.get());
+}
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace prometheus {
+namespace detail {
+
+// Chunked storage for the metric objects of a Family. Objects never move
+// once constructed, slots of erased objects are reused, and iteration walks
+// the chunks in order instead of chasing one heap node per series. A chunk
+// whose objects have all been erased is freed unless it is the newest one,
+// so memory shrinks again after a spike in the number of series.
+template <typename T>
+class Slab {
+ public:
+  static const std::size_t kCacheLineSize = 64;
+
+  Slab() = default;
+  Slab(const Slab&) = delete;
+  Slab& operator=(const Slab&) = delete;
+  ~Slab();
+
+  // Pad every slot to a whole number of cache lines so that frequently
+  // updated neighbours never share one. Applies to chunks allocated after
+  // the call.
+  void SetCacheLineAligned(bool aligned) { cache_line_aligned_ = aligned; }
+
+  // Constructs a T from `args` and tags it with `key`, which is handed back
+  // by ForEach.
+  template <typename... Args>
+  T* Emplace(std::size_t key, Args&&... args);
+  void Erase(T* object);
+
+  // Calls f(key, object) for every live object in storage order.
+  template <typename F>
+  void ForEach(F f) const;
+
+  std::size_t size() const { return size_; }
+  // Number of slots in allocated chunks.
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  struct Slot {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    std::size_t key;
+    bool live;
+  };
+
+  struct Chunk {
+    std::unique_ptr<unsigned char[]> memory;
+    unsigned char* begin;
+    std::size_t stride;
+    std::size_t slots;
+    // slots handed out at least once; the rest have never been constructed
+    std::size_t used;
+    std::size_t live;
+    std::vector<Slot*> free;
+
+    Slot* At(std::size_t i) const {
+      return reinterpret_cast<Slot*>(begin + i * stride);
+    }
+  };
+
+  static const std::size_t kFirstChunkSlots = 16;
+  static const std::size_t kMaxChunkSlots = 4096;
+
+  Slot* Allocate();
+  Chunk* ChunkOf(const Slot* slot) const;
+  void Release(Chunk* chunk);
+
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  // chunk by the address of its first slot, to find the chunk of a slot
+  std::map<const unsigned char*, Chunk*, std::less<const unsigned char*>>
+      by_address_;
+  // chunks with erased slots that can be reused
+  std::vector<Chunk*> with_free_;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
+  bool cache_line_aligned_ = false;
+};
+
+template <typename T>
+const std::size_t Slab<T>::kCacheLineSize;
+template <typename T>
+const std::size_t Slab<T>::kFirstChunkSlots;
+template <typename T>
+const std::size_t Slab<T>::kMaxChunkSlots;
+
+template <typename T>
+Slab<T>::~Slab() {
+  ForEach([](std::size_t, T* object) { object->~T(); });
+}
+
+template <typename T>
+template <typename... Args>
+T* Slab<T>::Emplace(std::size_t key, Args&&... args) {
+  auto slot = Allocate();
+  auto object = new (&slot->storage) T(std::forward<Args>(args)...);
+  slot->key = key;
+  slot->live = true;
+  ++size_;
+  return object;
+}
+
+template <typename T>
+void Slab<T>::Erase(T* object) {
+  // storage is the first member, so the object address is the slot address
+  auto slot = reinterpret_cast<Slot*>(object);
+  auto chunk = ChunkOf(slot);
+  object->~T();
+  slot->live = false;
+  --size_;
+  if (--chunk->live == 0 && chunk != chunks_.back().get()) {
+    Release(chunk);
+    return;
+  }
+  chunk->free.push_back(slot);
+  if (chunk->free.size() == 1) {
+    with_free_.push_back(chunk);
+  }
+}
+
+template <typename T>
+typename Slab<T>::Chunk* Slab<T>::ChunkOf(const Slot* slot) const {
+  auto address = reinterpret_cast<const unsigned char*>(slot);
+  return std::prev(by_address_.upper_bound(address))->second;
+}
+
+template <typename T>
+void Slab<T>::Release(Chunk* chunk) {
+  if (!chunk->free.empty()) {
+    with_free_.erase(std::find(with_free_.begin(), with_free_.end(), chunk));
+  }
+  by_address_.erase(chunk->begin);
+  capacity_ -= chunk->slots;
+  chunks_.erase(std::find_if(
+      chunks_.begin(), chunks_.end(),
+      [chunk](const std::unique_ptr<Chunk>& c) { return c.get() == chunk; }));
+}
+
+template <typename T>
+template <typename F>
+void Slab<T>::ForEach(F f) const {
+  for (const auto& chunk : chunks_) {
+    for (std::size_t i = 0; i < chunk->used; ++i) {
+      auto slot = chunk->At(i);
+      if (slot->live) {
+        f(slot->key, reinterpret_cast<T*>(&slot->storage));
+      }
+    }
+  }
+}
+
+template <typename T>
+typename Slab<T>::Slot* Slab<T>::Allocate() {
+  if (!with_free_.empty()) {
+    auto chunk = with_free_.back();
+    auto slot = chunk->free.back();
+    chunk->free.pop_back();
+    if (chunk->free.empty()) {
+      with_free_.pop_back();
+    }
+    ++chunk->live;
+    return slot;
+  }
+  if (chunks_.empty() || chunks_.back()->used == chunks_.back()->slots) {
+    auto slots = chunks_.empty() ? kFirstChunkSlots
+                                 : std::min(2 * chunks_.back()->slots,
+                                            kMaxChunkSlots);
+    auto alignment = cache_line_aligned_ ? kCacheLineSize : alignof(Slot);
+    auto stride = (sizeof(Slot) + alignment - 1) / alignment * alignment;
+
+    auto chunk = std::unique_ptr<Chunk>{new Chunk};
+    chunk->memory.reset(new unsigned char[slots * stride + alignment]);
+    auto address = reinterpret_cast<std::uintptr_t>(chunk->memory.get());
+    chunk->begin = chunk->memory.get() + (alignment - address % alignment) %
+                                             alignment;
+    chunk->stride = stride;
+    chunk->slots = slots;
+    chunk->used = 0;
+    chunk->live = 0;
+    by_address_.insert({chunk->begin, chunk.get()});
+    capacity_ += slots;
+    chunks_.push_back(std::move(chunk));
+  }
+  auto& chunk = *chunks_.back();
+  ++chunk.live;
+  return chunk.At(chunk.used++);
+}
+}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "family.h"
+#include "histogram.h"
+#include "histogram_builder.h"
+#include "metric.h"
+#include "registry.h"
+
+namespace prometheus {
+
+namespace detail {
+template <typename Bound>
+constexpr bool StrictlyIncreasing() {
+  return true;
+}
+
+template <typename Bound, Bound First>
+constexpr bool StrictlyIncreasing() {
+  return true;
+}
+
+template <typename Bound, Bound First, Bound Second, Bound... Rest>
+constexpr bool StrictlyIncreasing() {
+  return First < Second && StrictlyIncreasing<Bound, Second, Rest...>();
+}
+}  // namespace detail
+
+// Bucket layout known at compile time. Template arguments cannot be floating
+// point, so bounds are integers, e.g. microseconds for latencies.
+template <std::int64_t... Bounds>
+struct Buckets {
+  static_assert(detail::StrictlyIncreasing<std::int64_t, Bounds...>(),
+                "bucket bounds must be strictly increasing");
+
+  static const std::size_t size = sizeof...(Bounds);
+  static constexpr double bounds[sizeof...(Bounds) + 1] = {
+      static_cast<double>(Bounds)..., 0};
+};
+
+template <std::int64_t... Bounds>
+const std::size_t Buckets<Bounds...>::size;
+template <std::int64_t... Bounds>
+constexpr double Buckets<Bounds...>::bounds[sizeof...(Bounds) + 1];
+
+// Histogram whose bucket layout is a template parameter. The counts live
+// inline instead of in a heap allocated vector, the bounds are shared by all
+// instances, and the bucket search is a fixed-length loop the compiler can
+// unroll or vectorize. Bucket counts are integers updated with a single
+// fetch_add each.
+template <typename Layout>
+class StaticHistogram : public Metric {
+ public:
+  static const io::prometheus::client::MetricType metric_type =
+      io::prometheus::client::MetricType_HISTOGRAM;
+
+  StaticHistogram();
+
+  void Observe(double value) { Observe(value, 1); }
+  void Observe(double value, std::uint64_t weight);
+  // Records `count` observations with one update per touched bucket and one
+  // of the sum, like Histogram::ObserveBatch.
+  void ObserveBatch(const double* values, std::size_t count);
+
+  // The bounds of Layout, shared by every StaticHistogram<Layout>.
+  static const Histogram::BucketBoundaries& BucketBoundaries();
+
+  metric_collect_t Collect(label_pair_t* global_labels,
+                           flatbuffers::FlatBufferBuilder* builder) override;
+
+ private:
+  static std::size_t BucketIndex(double value);
+
+  std::array<std::atomic<std::uint64_t>, Layout::size + 1> bucket_counts_;
+  std::atomic<double> sum_;
+};
+
+template <typename Layout>
+StaticHistogram<Layout>::StaticHistogram() : sum_(0.0) {
+  for (auto& count : bucket_counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+template <typename Layout>
+std::size_t StaticHistogram<Layout>::BucketIndex(double value) {
+  // counts the bounds that are not above the value, which is the index of
+  // the first bound above it; branch free, so it does not depend on the
+  // distribution of the values. NaN lands in +Inf like in Histogram.
+  std::size_t index = 0;
+  for (std::size_t i = 0; i < Layout::size; ++i) {
+    index += !(Layout::bounds[i] > value);
+  }
+  return index;
+}
+
+template <typename Layout>
+void StaticHistogram<Layout>::Observe(double value, std::uint64_t weight) {
+  bucket_counts_[BucketIndex(value)].fetch_add(weight,
+                                               std::memory_order_relaxed);
+  // negative values are dropped from the sum like in Histogram::Observe()
+  auto delta = value < 0.0 ? 0.0 : value * weight;
+  auto current = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(current, current + delta))
+    ;
+  MarkUpdated();
+}
+
+template <typename Layout>
+void StaticHistogram<Layout>::ObserveBatch(const double* values,
+                                           std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  std::uint64_t counts[Layout::size + 1] = {};
+  auto sum = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    ++counts[BucketIndex(values[i])];
+    sum += values[i] < 0.0 ? 0.0 : values[i];
+  }
+  for (std::size_t i = 0; i < Layout::size + 1; ++i) {
+    if (counts[i] != 0) {
+      bucket_counts_[i].fetch_add(counts[i], std::memory_order_relaxed);
+    }
+  }
+  auto current = sum_.load(std::memory_order_relaxed);
+  while (!sum_.compare_exchange_weak(current, current + sum))
+    ;
+  MarkUpdated();
+}
+
+template <typename Layout>
+const Histogram::BucketBoundaries& StaticHistogram<Layout>::BucketBoundaries() {
+  static const auto bucket_boundaries = Histogram::BucketBoundaries{
+      Layout::bounds, Layout::bounds + Layout::size};
+  return bucket_boundaries;
+}
+
+template <typename Layout>
+metric_collect_t StaticHistogram<Layout>::Collect(
+    label_pair_t* global_labels, flatbuffers::FlatBufferBuilder* builder) {
+  auto bucket_counts = std::vector<double>{};
+  bucket_counts.reserve(bucket_counts_.size());
+  for (const auto& count : bucket_counts_) {
+    bucket_counts.push_back(
+        static_cast<double>(count.load(std::memory_order_relaxed)));
+  }
+  return Histogram::CollectValue(BucketBoundaries(), bucket_counts,
+                                 sum_.load(), global_labels, builder);
+}
+
+namespace detail {
+template <typename Layout>
+Family<StaticHistogram<Layout>>& HistogramBuilder::RegisterStatic(
+    Registry& registry) {
+  auto& family = registry.Add<Family<StaticHistogram<Layout>>>(name_, help_,
+                                                               labels_);
+  if (cache_line_aligned_) {
+    family.SetCacheLineAligned(true);
+  }
+  if (idle_timeout_ > std::chrono::steady_clock::duration::zero()) {
+    family.SetIdleTimeout(idle_timeout_, registry.Id());
+  }
+  return family;
+}
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "check_names.h"
+#include "collectable.h"
+#include "counter.h"
+#include "gauge.h"
+#include "histogram.h"
+#include "label_hash.h"
+#include "metric.h"
+#include "registry.h"
+#include "slab.h"
+
+// Declares a label tag for TypedFamily schemas:
+//
+//   PROMETHEUS_LABEL(Method, "method");
+//   PROMETHEUS_LABEL(Code, "code");
+//   TypedFamily<Counter, Labels<Method, Code>> family{"requests", "", {}};
+//   family.Add({"GET", "200"}).Increment();
+#define PROMETHEUS_LABEL(Tag, label_name)                       \
+  struct Tag {                                                  \
+    static constexpr const char* Name() { return label_name; } \
+  }
+
+namespace prometheus {
+
+namespace detail {
+
+constexpr bool IsLabelNameChar(char c, bool first) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         (!first && c >= '0' && c <= '9');
+}
+
+// Compile-time counterpart of CheckLabelName().
+constexpr bool IsValidLabelName(const char* name, std::size_t i = 0) {
+  return name[i] == '\0'
+             ? i > 0 && !(name[0] == '_' && name[1] == '_')
+             : IsLabelNameChar(name[i], i == 0) &&
+                   IsValidLabelName(name, i + 1);
+}
+
+constexpr bool LabelNamesEqual(const char* a, const char* b) {
+  return *a == *b && (*a == '\0' || LabelNamesEqual(a + 1, b + 1));
+}
+
+template <typename... Tags>
+struct ValidLabelNames : std::true_type {};
+
+template <typename Head, typename... Tail>
+struct ValidLabelNames<Head, Tail...>
+    : std::integral_constant<bool, IsValidLabelName(Head::Name()) &&
+                                       ValidLabelNames<Tail...>::value> {};
+
+template <typename Tag, typename... Others>
+struct LabelNameUnused : std::true_type {};
+
+template <typename Tag, typename Other, typename... Rest>
+struct LabelNameUnused<Tag, Other, Rest...>
+    : std::integral_constant<bool,
+                             !LabelNamesEqual(Tag::Name(), Other::Name()) &&
+                                 LabelNameUnused<Tag, Rest...>::value> {};
+
+template <typename... Tags>
+struct DistinctLabelNames : std::true_type {};
+
+template <typename Head, typename... Tail>
+struct DistinctLabelNames<Head, Tail...>
+    : std::integral_constant<bool, LabelNameUnused<Head, Tail...>::value &&
+                                       DistinctLabelNames<Tail...>::value> {};
+
+// Non-owning view of one label value. Lookups hash and compare through it so
+// that finding an existing series never copies the values.
+class LabelValue {
+ public:
+  LabelValue(const char* value) : data_(value), size_(std::strlen(value)) {}
+  LabelValue(const std::string& value)
+      : data_(value.data()), size_(value.size()) {}
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  std::size_t size_;
+};
+
+inline std::uint64_t HashLabelValue(std::uint64_t hash,
+                                    const LabelValue& value) {
+  return HashLabelBytes(hash, value.data(), value.size());
+}
+}  // namespace detail
+
+// Label schema of a TypedFamily: the names and their order are fixed by the
+// tag types, which are declared with PROMETHEUS_LABEL.
+template <typename... Tags>
+struct Labels {
+  static_assert(detail::ValidLabelNames<Tags...>::value,
+                "label names must match [a-zA-Z_][a-zA-Z0-9_]* and must not "
+                "start with __");
+  static_assert(detail::DistinctLabelNames<Tags...>::value,
+                "label names must be distinct");
+
+  static const std::size_t size = sizeof...(Tags);
+
+  static const char* Name(std::size_t i) {
+    static const char* const names[] = {Tags::Name()..., nullptr};
+    return names[i];
+  }
+};
+
+template <typename... Tags>
+const std::size_t Labels<Tags...>::size;
+
+// Family whose label names are fixed at compile time by `Schema`. Series are
+// looked up by an array of exactly Schema::size values, so a wrong number of
+// values does not compile and finding an existing series does not allocate.
+template <typename T, typename Schema>
+class TypedFamily : public Collectable {
+ public:
+  static const std::size_t kLabelCount = Schema::size;
+  using LabelValues = std::array<detail::LabelValue, kLabelCount>;
+
+  TypedFamily(const std::string& name, const std::string& help,
+              const std::map<std::string, std::string>& constant_labels);
+  template <typename... Args>
+  T& Add(const LabelValues& values, Args&&... args);
+  void Remove(T* metric);
+
+  // Collectable
+  builders_t Collect() override;
+
+ private:
+  struct Series {
+    template <typename... Args>
+    Series(const LabelValues& label_values, Args&&... args)
+        : metric(std::forward<Args>(args)...) {
+      for (std::size_t i = 0; i < kLabelCount; ++i) {
+        values[i].assign(label_values[i].data(), label_values[i].size());
+      }
+    }
+
+    T metric;
+    std::array<std::string, kLabelCount> values;
+  };
+
+  static std::size_t Hash(const LabelValues& values);
+  static bool Equal(const Series& series, const LabelValues& values);
+
+  detail::Slab<Series> storage_;
+  std::unordered_multimap<std::size_t, Series*> index_;
+  std::unordered_map<T*, std::pair<std::size_t, Series*>> reverse_index_;
+
+  const std::string name_;
+  const std::string help_;
+  const std::map<std::string, std::string> constant_labels_;
+  std::mutex mutex_;
+};
+
+template <typename T, typename Schema>
+const std::size_t TypedFamily<T, Schema>::kLabelCount;
+
+template <typename T, typename Schema>
+TypedFamily<T, Schema>::TypedFamily(
+    const std::string& name, const std::string& help,
+    const std::map<std::string, std::string>& constant_labels)
+    : name_(name), help_(help), constant_labels_(constant_labels) {
+  assert(CheckMetricName(name_));
+#ifndef NDEBUG
+  for (std::size_t i = 0; i < kLabelCount; ++i) {
+    assert(constant_labels_.count(Schema::Name(i)) == 0);
+  }
+#endif
+}
+
+template <typename T, typename Schema>
+std::size_t TypedFamily<T, Schema>::Hash(const LabelValues& values) {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::size_t i = 0; i < kLabelCount; ++i) {
+    hash = detail::HashLabelValue(hash, values[i]);
+  }
+  return static_cast<std::size_t>(hash);
+}
+
+template <typename T, typename Schema>
+bool TypedFamily<T, Schema>::Equal(const Series& series,
+                                   const LabelValues& values) {
+  for (std::size_t i = 0; i < kLabelCount; ++i) {
+    const auto& stored = series.values[i];
+    if (stored.size() != values[i].size() ||
+        std::memcmp(stored.data(), values[i].data(), stored.size()) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T, typename Schema>
+template <typename... Args>
+T& TypedFamily<T, Schema>::Add(const LabelValues& values, Args&&... args) {
+  auto hash = Hash(values);
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto range = index_.equal_range(hash);
+  for (auto index_iter = range.first; index_iter != range.second;
+       ++index_iter) {
+    if (Equal(*index_iter->second, values)) {
+      return index_iter->second->metric;
+    }
+  }
+
+  auto series = storage_.Emplace(hash, values, std::forward<Args>(args)...);
+  index_.insert({hash, series});
+  reverse_index_.insert({&series->metric, {hash, series}});
+  return series->metric;
+}
+
+template <typename T, typename Schema>
+void TypedFamily<T, Schema>::Remove(T* metric) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto reverse_iter = reverse_index_.find(metric);
+  if (reverse_iter == reverse_index_.end()) {
+    return;
+  }
+
+  auto hash = reverse_iter->second.first;
+  auto series = reverse_iter->second.second;
+  auto range = index_.equal_range(hash);
+  for (auto index_iter = range.first; index_iter != range.second;
+       ++index_iter) {
+    if (index_iter->second == series) {
+      index_.erase(index_iter);
+      break;
+    }
+  }
+  reverse_index_.erase(reverse_iter);
+  storage_.Erase(series);
+}
+
+template <typename T, typename Schema>
+builders_t TypedFamily<T, Schema>::Collect() {
+  auto metrics_vec =
+      std::vector<flatbuffers::Offset<io::prometheus::client::Metric>>{};
+  auto bld = make_bld_t();
+  auto all_labels = label_pair_t{constant_labels_.begin(),
+                                 constant_labels_.end()};
+  auto constant_count = all_labels.size();
+  for (std::size_t i = 0; i < kLabelCount; ++i) {
+    all_labels.emplace_back(Schema::Name(i), std::string{});
+  }
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  metrics_vec.reserve(storage_.size());
+  storage_.ForEach([&](std::size_t, Series* series) {
+    for (std::size_t i = 0; i < kLabelCount; ++i) {
+      all_labels[constant_count + i].second = series->values[i];
+    }
+    metrics_vec.emplace_back(series->metric.Collect(&all_labels, bld.get()));
+  });
+  auto metrics = bld->CreateVector(metrics_vec);
+
+  auto family = io::prometheus::client::CreateMetricFamily(
+      *bld, bld->CreateString(name_), bld->CreateString(help_), T::metric_type,
+      metrics);
+  bld->Finish(family);
+  return {bld};
+}
+
+namespace detail {
+
+template <typename Schema>
+TypedFamily<Counter, Schema>& CounterBuilder::RegisterTyped(
+    Registry& registry) {
+  return registry.Add<TypedFamily<Counter, Schema>>(name_, help_, labels_);
+}
+
+template <typename Schema>
+TypedFamily<Gauge, Schema>& GaugeBuilder::RegisterTyped(Registry& registry) {
+  return registry.Add<TypedFamily<Gauge, Schema>>(name_, help_, labels_);
+}
+
+template <typename Schema>
+TypedFamily<Histogram, Schema>& HistogramBuilder::RegisterTyped(
+    Registry& registry) {
+  return registry.Add<TypedFamily<Histogram, Schema>>(name_, help_, labels_);
+}
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,112 @@
+#include "collectable_set.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace prometheus {
+namespace detail {
+
+static const std::size_t kMinCapacity = 16;
+
+CollectableSet::CollectableSet()
+    : list_(std::make_shared<List>(kMinCapacity)) {}
+
+void CollectableSet::Add(const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (index_.count(collectable) != 0) {
+    return;
+  }
+  if (list_->size.load(std::memory_order_relaxed) == list_->capacity) {
+    Compact();
+  }
+  auto entry = std::make_shared<Entry>(next_id_++, collectable);
+  auto size = list_->size.load(std::memory_order_relaxed);
+  list_->entries[size] = entry;
+  list_->size.store(size + 1, std::memory_order_release);
+  index_.insert({collectable, entry.get()});
+  version_.fetch_add(1, std::memory_order_release);
+}
+
+void CollectableSet::Remove(const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto index_iter = index_.find(collectable);
+  if (index_iter == index_.end()) {
+    return;
+  }
+  index_iter->second->removed.store(true, std::memory_order_release);
+  index_.erase(index_iter);
+  if (2 * ++removed_ > list_->size.load(std::memory_order_relaxed)) {
+    Compact();
+  }
+  version_.fetch_add(1, std::memory_order_release);
+}
+
+void CollectableSet::Compact() {
+  auto size = list_->size.load(std::memory_order_relaxed);
+  auto kept = std::vector<std::shared_ptr<Entry>>{};
+  kept.reserve(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    auto& entry = list_->entries[i];
+    if (entry->removed.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    if (entry->collectable.expired()) {
+      index_.erase(entry->collectable);
+      continue;
+    }
+    kept.push_back(entry);
+  }
+
+  auto compacted =
+      std::make_shared<List>(std::max(kMinCapacity, 2 * kept.size()));
+  std::move(kept.begin(), kept.end(), compacted->entries.get());
+  compacted->size.store(kept.size(), std::memory_order_relaxed);
+  std::atomic_store(&list_, std::move(compacted));
+  removed_ = 0;
+}
+
+std::size_t CollectableSet::size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return index_.size();
+}
+
+std::vector<std::shared_ptr<Collectable>> CollectableSet::Snapshot(
+    std::vector<std::size_t>* ids, std::size_t* version) {
+  // loaded first, so the list read below includes at least these changes
+  if (version) {
+    *version = version_.load(std::memory_order_acquire);
+  }
+  if (ids) {
+    ids->clear();
+  }
+  auto list = std::atomic_load(&list_);
+  auto size = list->size.load(std::memory_order_acquire);
+  auto live = std::vector<std::shared_ptr<Collectable>>{};
+  live.reserve(size);
+  auto expired = false;
+  for (std::size_t i = 0; i < size; ++i) {
+    auto& entry = list->entries[i];
+    if (entry->removed.load(std::memory_order_acquire)) {
+      continue;
+    }
+    if (auto collectable = entry->collectable.lock()) {
+      live.push_back(std::move(collectable));
+      if (ids) {
+        ids->push_back(entry->id);
+      }
+    } else {
+      expired = true;
+    }
+  }
+
+  if (expired) {
+    // pruning can wait for the next scrape if a change holds the lock
+    std::unique_lock<std::mutex> lock{mutex_, std::try_to_lock};
+    if (lock.owns_lock()) {
+      Compact();
+    }
+  }
+  return live;
+}
+}
+}
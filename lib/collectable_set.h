@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "prometheus/collectable.h"
+
+namespace prometheus {
+namespace detail {
+
+// Set of collectables shared between the threads registering them and the
+// threads serving scrapes. Scrapes read an append-only list without locking
+// and never wait for a change. Add() appends to the list in place and
+// Remove() only marks an entry; the list is copied when it is full or when
+// more than half of its entries are dead, so a change costs amortized
+// constant time however large the set grows. Changes are serialized by a
+// mutex that scrapes never wait for.
+class CollectableSet {
+ public:
+  CollectableSet();
+
+  // Adds `collectable` under an id that is never reused. Adding a
+  // collectable that is already in the set has no effect.
+  void Add(const std::weak_ptr<Collectable>& collectable);
+  void Remove(const std::weak_ptr<Collectable>& collectable);
+
+  // Returns the collectables that are still alive and stores their ids in
+  // `ids`. `version` receives the number of changes the snapshot includes
+  // at least, to tell which of two snapshots is newer. Expired entries found
+  // on the way are pruned from the set unless a change is in progress.
+  std::vector<std::shared_ptr<Collectable>> Snapshot(
+      std::vector<std::size_t>* ids = nullptr,
+      std::size_t* version = nullptr);
+
+  // Number of entries, including expired ones that were not pruned yet.
+  std::size_t size() const;
+
+ private:
+  struct Entry {
+    Entry(std::size_t id, const std::weak_ptr<Collectable>& collectable)
+        : id(id), collectable(collectable), removed(false) {}
+    const std::size_t id;
+    const std::weak_ptr<Collectable> collectable;
+    std::atomic<bool> removed;
+  };
+
+  // Entries below `size` are never written again, so scrapes read them
+  // while Add() appends behind them.
+  struct List {
+    explicit List(std::size_t capacity)
+        : entries(new std::shared_ptr<Entry>[capacity]),
+          capacity(capacity),
+          size(0) {}
+    std::unique_ptr<std::shared_ptr<Entry>[]> entries;
+    const std::size_t capacity;
+    std::atomic<std::size_t> size;
+  };
+
+  // Publishes a copy of the list without removed and expired entries, with
+  // room to grow; runs with mutex_ held.
+  void Compact();
+
+  std::shared_ptr<List> list_;
+  // entries that were not removed, by owner; only touched with mutex_ held
+  std::map<std::weak_ptr<Collectable>, Entry*,
+           std::owner_less<std::weak_ptr<Collectable>>>
+      index_;
+  // removed entries still in list_
+  std::size_t removed_ = 0;
+  std::size_t next_id_ = 0;
+  std::atomic<std::size_t> version_{0};
+  mutable std::mutex mutex_;
+};
+}
+}
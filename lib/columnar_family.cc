@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <new>
+
+#include "prometheus/columnar_family.h"
+
+namespace prometheus {
+namespace detail {
+
+const std::size_t ValueColumn::kBlockSize;
+
+std::size_t ValueColumn::Allocate() {
+  if (!free_.empty()) {
+    auto index = free_.back();
+    free_.pop_back();
+    return index;
+  }
+  if (size_ == blocks_.size() * kBlockSize) {
+    const std::size_t alignment = 64;
+    const auto bytes = kBlockSize * sizeof(std::atomic<double>) + alignment;
+    Block block;
+    block.memory.reset(new unsigned char[bytes]);
+    auto address = reinterpret_cast<std::uintptr_t>(block.memory.get());
+    auto begin =
+        block.memory.get() + (alignment - address % alignment) % alignment;
+    block.values = reinterpret_cast<std::atomic<double>*>(begin);
+    for (std::size_t i = 0; i < kBlockSize; ++i) {
+      new (&block.values[i]) std::atomic<double>(0.0);
+    }
+    blocks_.push_back(std::move(block));
+  }
+  return size_++;
+}
+
+void ValueColumn::Release(std::size_t index) {
+  At(index)->store(0.0);
+  free_.push_back(index);
+}
+
+void ValueColumn::Snapshot(std::vector<double>* out) const {
+  out->resize(size_);
+  auto remaining = size_;
+  auto dest = out->data();
+  for (const auto& block : blocks_) {
+    auto count = remaining < kBlockSize ? remaining : kBlockSize;
+    for (std::size_t i = 0; i < count; ++i) {
+      dest[i] = block.values[i].load(std::memory_order_relaxed);
+    }
+    dest += count;
+    remaining -= count;
+  }
+}
+
+double ValueColumn::Sum() const {
+  auto sum = 0.0;
+  for (const auto& block : blocks_) {
+    for (std::size_t i = 0; i < kBlockSize; ++i) {
+      sum += block.values[i].load(std::memory_order_relaxed);
+    }
+  }
+  return sum;
+}
+}
+}
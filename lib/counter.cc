@@ -3,14 +3,41 @@
 using namespace io::prometheus::client;
 namespace prometheus {
 
-void Counter::Increment() { gauge_.Increment(); }
+void Counter::Increment() { Increment(1.0); }
 
-void Counter::Increment(double val) { gauge_.Increment(val); }
+void Counter::Increment(double val) {
+  if (val < 0.0) {
+    return;
+  }
+  auto current = value_.load();
+  while (!value_.compare_exchange_weak(current, current + val))
+    ;
+  MarkUpdated();
+}
+
+void Counter::IncrementBatch(const double* values, std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+  auto sum = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    // same filter as Increment, so NaN is still added
+    sum += values[i] < 0.0 ? 0.0 : values[i];
+  }
+  Increment(sum);
+}
 
-double Counter::Value() const { return gauge_.Value(); }
+double Counter::Value() const { return value_.load(); }
 
 metric_collect_t Counter::Collect(label_pair_t* global_labels,
                                   flatbuffers::FlatBufferBuilder* builder) {
+  FlushLocalRecorders();
+  return CollectValue(Value(), global_labels, builder);
+}
+
+metric_collect_t Counter::CollectValue(
+    double value, label_pair_t* global_labels,
+    flatbuffers::FlatBufferBuilder* builder) {
   std::vector<flatbuffers::Offset<LabelPair>> labels_vec;
   for (const auto& p : *global_labels) {
     auto name = builder->CreateString(p.first);
@@ -20,7 +47,7 @@ metric_collect_t Counter::Collect(label_pair_t* global_labels,
   }
   auto labels = (*builder).CreateVector(labels_vec);
 
-  auto counter = CreateCounter(*builder, Value());
+  auto counter = CreateCounter(*builder, value);
   auto metric = CreateMetric(*builder, labels, 0, counter);
 
   return metric;
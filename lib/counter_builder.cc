@@ -1,5 +1,9 @@
 #include "prometheus/counter_builder.h"
+#include "prometheus/columnar_family.h"
 #include "prometheus/registry.h"
+#include "prometheus/shared_memory.h"
+
+#include "self_metrics.h"
 
 namespace prometheus {
 
@@ -23,8 +27,48 @@ CounterBuilder& CounterBuilder::Help(const std::string& help) {
   return *this;
 }
 
+CounterBuilder& CounterBuilder::IdleTimeout(
+    std::chrono::steady_clock::duration idle_timeout) {
+  idle_timeout_ = idle_timeout;
+  return *this;
+}
+
+CounterBuilder& CounterBuilder::MaxSeries(std::size_t max_series) {
+  max_series_ = max_series;
+  return *this;
+}
+
+CounterBuilder& CounterBuilder::CacheLineAligned(bool aligned) {
+  cache_line_aligned_ = aligned;
+  return *this;
+}
+
 Family<Counter>& CounterBuilder::Register(Registry& registry) {
-  return registry.AddCounter(name_, help_, labels_);
+  auto& family = registry.AddCounter(name_, help_, labels_);
+  if (cache_line_aligned_) {
+    family.SetCacheLineAligned(true);
+  }
+  if (idle_timeout_ > std::chrono::steady_clock::duration::zero()) {
+    family.SetIdleTimeout(idle_timeout_, registry.Id());
+  }
+  if (max_series_ > 0) {
+    auto id = registry.Id();
+    auto name = name_;
+    family.SetMaxSeries(
+        max_series_, &detail::FamilySeriesGauge(id, name),
+        &detail::FamilyOverflowCounter(id, name),
+        [id, name] { detail::RemoveFamilySeriesLimit(id, name); });
+  }
+  return family;
+}
+
+ColumnarFamily<Counter>& CounterBuilder::RegisterColumnar(Registry& registry) {
+  return registry.Add<ColumnarFamily<Counter>>(name_, help_, labels_);
+}
+
+SharedFamily<Counter>& CounterBuilder::RegisterShared(
+    SharedMemorySegment& segment) {
+  return segment.Family<Counter>(name_, help_, labels_);
 }
 }
 }
@@ -5,7 +5,9 @@
 #include "prometheus/exposer.h"
 
 #include "CivetServer.h"
+#include "collectable_set.h"
 #include "handler.h"
+#include "self_metrics.h"
 
 namespace prometheus {
 Exposer& Exposer::GetInstance() {
@@ -16,11 +18,13 @@ Exposer& Exposer::GetInstance() {
 Exposer::Exposer(const std::string& bind_address, const std::string& uri)
     : server_(new CivetServer{
           {"listening_ports", bind_address.c_str(), "num_threads", "2"}}),
+      collectables_(new detail::CollectableSet{}),
       exposer_registry_(std::make_shared<Registry>()),
       metrics_handler_(
-          new detail::MetricsHandler{collectables_, *exposer_registry_}),
+          new detail::MetricsHandler{*collectables_, *exposer_registry_}),
       uri_(uri) {
   RegisterCollectable(exposer_registry_);
+  RegisterCollectable(detail::SelfMetricsRegistry());
   server_->addHandler(uri, metrics_handler_.get());
 }
 
@@ -28,6 +32,15 @@ Exposer::~Exposer() { server_->removeHandler(uri_); }
 
 void Exposer::RegisterCollectable(
     const std::weak_ptr<Collectable>& collectable) {
-  collectables_.push_back(collectable);
+  collectables_->Add(collectable);
+}
+
+std::vector<int> Exposer::GetListeningPorts() const {
+  return server_->getListeningPorts();
+}
+
+void Exposer::UnregisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  collectables_->Remove(collectable);
 }
 }  // namespace prometheus
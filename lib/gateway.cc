@@ -0,0 +1,161 @@
+#include "prometheus/gateway.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "http_client.h"
+#include "text_serializer.h"
+
+namespace prometheus {
+
+Gateway::Gateway(const std::string& url, const std::string& job,
+                 const std::map<std::string, std::string>& grouping_labels,
+                 const GatewayOptions& options)
+    : url_([&] {
+        auto group = url + "/metrics/job/" + detail::UrlEncode(job);
+        for (const auto& label : grouping_labels) {
+          group += "/" + label.first + "/" + detail::UrlEncode(label.second);
+        }
+        return group;
+      }()),
+      options_(options),
+      sender_(&Gateway::Run, this) {}
+
+Gateway::~Gateway() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+    deadline_ = std::chrono::steady_clock::now() + options_.shutdown_timeout;
+  }
+  // also cuts a running backoff short
+  wakeup_.notify_one();
+  sender_.join();
+}
+
+void Gateway::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  collectables_.push_back(collectable);
+}
+
+bool Gateway::Push() { return Enqueue("PUT"); }
+
+bool Gateway::PushAdd() { return Enqueue("POST"); }
+
+bool Gateway::Enqueue(const std::string& method) {
+  auto collectables = std::vector<std::weak_ptr<Collectable>>{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    collectables = collectables_;
+  }
+  // collect outside the lock, the sender thread never waits for it
+  auto metrics = builders_t{};
+  for (auto& weak : collectables) {
+    if (auto collectable = weak.lock()) {
+      auto collected = collectable->Collect();
+      metrics.insert(metrics.end(), collected.begin(), collected.end());
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!queue_.empty() && queue_.back().method == method) {
+      queue_.back().metrics = std::move(metrics);
+      return true;
+    }
+    if (queue_.size() >= options_.max_queue) {
+      return false;
+    }
+    queue_.push_back(Pending{method, std::move(metrics)});
+  }
+  wakeup_.notify_one();
+  return true;
+}
+
+void Gateway::Flush() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  drained_.wait(lock, [this] { return queue_.empty() && !sending_; });
+}
+
+std::size_t Gateway::FailedPushes() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return failed_pushes_;
+}
+
+void Gateway::Run() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  for (;;) {
+    wakeup_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    auto pending = std::move(queue_.front());
+    queue_.pop_front();
+    sending_ = true;
+
+    lock.unlock();
+    auto sent = Send(pending);
+    lock.lock();
+
+    sending_ = false;
+    if (!sent) {
+      ++failed_pushes_;
+    }
+    if (queue_.empty()) {
+      drained_.notify_all();
+    }
+  }
+}
+
+std::chrono::milliseconds Gateway::RequestTimeout() const {
+  if (!stopping_) {
+    return options_.timeout;
+  }
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline_ - std::chrono::steady_clock::now());
+  return std::max(std::chrono::milliseconds::zero(),
+                  std::min(options_.timeout, left));
+}
+
+bool Gateway::Send(const Pending& pending) {
+  auto metrics = pending.metrics;
+  auto body = TextSerializer{}.Serialize(metrics);
+  const auto headers = detail::http_headers_t{
+      {"Content-Type", "text/plain; version=0.0.4"}};
+
+  auto backoff = options_.initial_backoff;
+  for (auto attempt = 0;; ++attempt) {
+    auto timeout = std::chrono::milliseconds{};
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      timeout = RequestTimeout();
+    }
+    if (timeout == std::chrono::milliseconds::zero()) {
+      return false;
+    }
+    auto status =
+        detail::HttpRequest(pending.method, url_, headers, body, timeout);
+    if (status >= 200 && status < 300) {
+      return true;
+    }
+    // client errors other than throttling will not go away by retrying
+    auto retryable = status < 0 || status == 429 || status >= 500;
+    if (!retryable || attempt >= options_.max_retries) {
+      return false;
+    }
+    {
+      // the destructor wakes the sender up, the backoff then ends at the
+      // shutdown deadline at the latest
+      auto resume = std::chrono::steady_clock::now() + backoff;
+      std::unique_lock<std::mutex> lock{mutex_};
+      auto until = [this, resume] {
+        return stopping_ ? std::min(resume, deadline_) : resume;
+      };
+      while (std::chrono::steady_clock::now() < until()) {
+        wakeup_.wait_until(lock, until());
+      }
+    }
+    backoff = std::min(2 * backoff, options_.max_backoff);
+  }
+}
+}
@@ -24,12 +24,16 @@ void Gauge::Decrement(double value) {
   Change(-1.0 * value);
 }
 
-void Gauge::Set(double value) { value_.store(value); }
+void Gauge::Set(double value) {
+  value_.store(value);
+  MarkUpdated();
+}
 
 void Gauge::Change(double value) {
   auto current = value_.load();
   while (!value_.compare_exchange_weak(current, current + value))
     ;
+  MarkUpdated();
 }
 
 void Gauge::SetToCurrentTime() {
@@ -41,6 +45,11 @@ double Gauge::Value() const { return value_; }
 
 metric_collect_t Gauge::Collect(label_pair_t* global_labels,
                                 flatbuffers::FlatBufferBuilder* builder) {
+  return CollectValue(Value(), global_labels, builder);
+}
+
+metric_collect_t Gauge::CollectValue(double value, label_pair_t* global_labels,
+                                     flatbuffers::FlatBufferBuilder* builder) {
   using namespace io::prometheus::client;
   std::vector<flatbuffers::Offset<LabelPair>> labels_vec;
   for (const auto& p : *global_labels) {
@@ -51,7 +60,7 @@ metric_collect_t Gauge::Collect(label_pair_t* global_labels,
   }
   auto labels = (*builder).CreateVector(labels_vec);
 
-  auto gauge = CreateGauge(*builder, Value());
+  auto gauge = CreateGauge(*builder, value);
   auto metric = CreateMetric(*builder, labels, gauge);
 
   return metric;
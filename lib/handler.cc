@@ -1,3 +1,7 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
 #include "handler.h"
 #include "json_serializer.h"
 #include "protobuf_delimited_serializer.h"
@@ -7,9 +11,20 @@
 namespace prometheus {
 namespace detail {
 
-MetricsHandler::MetricsHandler(
-    const std::vector<std::weak_ptr<Collectable>>& collectables,
-    Registry& registry)
+static const Histogram::BucketBoundaries& StageBuckets() {
+  static const auto buckets = Histogram::BucketBoundaries{
+      10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000};
+  return buckets;
+}
+
+static double MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+MetricsHandler::MetricsHandler(CollectableSet& collectables,
+                               Registry& registry)
     : collectables_(collectables),
       bytes_transferred_family_(
           BuildCounter()
@@ -29,7 +44,33 @@ MetricsHandler::MetricsHandler(
               .Register(registry)),
       request_latencies_(request_latencies_family_.Add(
           {}, Histogram::BucketBoundaries{1, 5, 10, 20, 40, 80, 160, 320, 640,
-                                          1280, 2560})) {}
+                                          1280, 2560})),
+      stage_latencies_family_(
+          BuildHistogram()
+              .Name("exposer_scrape_stage_latencies")
+              .Help("Latencies of the stages of serving a scrape, in "
+                    "microseconds")
+              .Register(registry)),
+      collect_latencies_(
+          stage_latencies_family_.Add({{"stage", "collect"}}, StageBuckets())),
+      serialize_latencies_(stage_latencies_family_.Add(
+          {{"stage", "serialize"}}, StageBuckets())),
+      write_latencies_(
+          stage_latencies_family_.Add({{"stage", "write"}}, StageBuckets())),
+      collectable_durations_family_(
+          BuildGauge()
+              .Name("exposer_collectable_collect_duration")
+              .Help("Time spent collecting each registered collectable in the "
+                    "last scrape, in microseconds, by registration id")
+              .Register(registry)),
+      last_scrape_family_(BuildGauge()
+                              .Name("exposer_last_scrape")
+                              .Help("Size of the last scrape")
+                              .Register(registry)),
+      scraped_series_(last_scrape_family_.Add({{"measure", "series"}})),
+      scraped_bytes_(last_scrape_family_.Add({{"measure", "bytes"}})),
+      peak_buffer_bytes_(
+          last_scrape_family_.Add({{"measure", "peak_buffer_bytes"}})) {}
 
 static std::string GetAcceptedEncoding(struct mg_connection* conn) {
   auto request_info = mg_get_request_info(conn);
@@ -50,7 +91,9 @@ bool MetricsHandler::handleGet(CivetServer* server,
 
   auto accepted_encoding = GetAcceptedEncoding(conn);
 
+  auto collect_start = std::chrono::steady_clock::now();
   auto metrics = CollectMetrics();
+  collect_latencies_.Observe(MicrosecondsSince(collect_start));
 
   auto content_type = std::string{};
 
@@ -76,7 +119,23 @@ bool MetricsHandler::handleGet(CivetServer* server,
   serializer.reset(new TextSerializer());
   content_type = "text/plain";
 
+  auto serialize_start = std::chrono::steady_clock::now();
   auto body = serializer->Serialize(metrics);
+  serialize_latencies_.Observe(MicrosecondsSince(serialize_start));
+
+  // the collected buffers and the serialized body are alive at the same time
+  std::size_t series = 0;
+  std::size_t buffer_bytes = body.capacity();
+  for (auto& bld : metrics) {
+    auto family = GetMetricFamily(bld->GetBufferPointer());
+    series += family->metric() ? family->metric()->size() : 0;
+    buffer_bytes += bld->GetSize();
+  }
+  scraped_series_.Set(series);
+  scraped_bytes_.Set(body.size());
+  peak_buffer_bytes_.Set(buffer_bytes);
+
+  auto write_start = std::chrono::steady_clock::now();
   mg_printf(conn,
             "HTTP/1.1 200 OK\r\n"
             "Content-Type: %s\r\n",
@@ -84,6 +143,7 @@ bool MetricsHandler::handleGet(CivetServer* server,
   mg_printf(conn, "Content-Length: %lu\r\n\r\n",
             static_cast<unsigned long>(body.size()));
   mg_write(conn, body.data(), body.size());
+  write_latencies_.Observe(MicrosecondsSince(write_start));
 
   auto stop_time_of_request = std::chrono::steady_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
@@ -95,18 +155,64 @@ bool MetricsHandler::handleGet(CivetServer* server,
   return true;
 }
 
-builders_t MetricsHandler::CollectMetrics() const {
+void MetricsHandler::SyncCollectableDurations(
+    const std::vector<std::size_t>& ids, std::size_t version) {
+  std::lock_guard<std::mutex> lock{collectable_durations_mutex_};
+  if (version < collectable_durations_version_) {
+    return;
+  }
+  // collectables only leave the set without a change when they expire
+  if (version == collectable_durations_version_ &&
+      ids.size() == collectable_durations_.size()) {
+    return;
+  }
+  collectable_durations_version_ = version;
+
+  auto synced = std::unordered_map<std::size_t, Gauge*>{};
+  synced.reserve(ids.size());
+  for (auto id : ids) {
+    auto durations_iter = collectable_durations_.find(id);
+    if (durations_iter != collectable_durations_.end()) {
+      synced.insert(*durations_iter);
+      collectable_durations_.erase(durations_iter);
+    } else {
+      synced.insert({id, &collectable_durations_family_.Add(
+                             {{"collectable", std::to_string(id)}})});
+    }
+  }
+  for (auto& removed : collectable_durations_) {
+    collectable_durations_family_.Remove(removed.second);
+  }
+  collectable_durations_ = std::move(synced);
+}
+
+builders_t MetricsHandler::CollectMetrics() {
   auto collected_metrics = builders_t{};
 
-  for (auto&& wcollectable : collectables_) {
-    auto collectable = wcollectable.lock();
-    if (!collectable) {
-      continue;
-    }
+  auto ids = std::vector<std::size_t>{};
+  std::size_t version = 0;
+  auto collectables = collectables_.Snapshot(&ids, &version);
+  // the series exist before the registry that holds them is collected
+  SyncCollectableDurations(ids, version);
 
+  auto durations = std::vector<double>{};
+  durations.reserve(collectables.size());
+  for (auto& collectable : collectables) {
+    auto start = std::chrono::steady_clock::now();
     for (auto metric : collectable->Collect()) {
       collected_metrics.push_back(metric);
     }
+    durations.push_back(MicrosecondsSince(start));
+  }
+
+  // series are looked up again under the lock, since a concurrent scrape
+  // may have removed some of them in between
+  std::lock_guard<std::mutex> lock{collectable_durations_mutex_};
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    auto durations_iter = collectable_durations_.find(ids[i]);
+    if (durations_iter != collectable_durations_.end()) {
+      durations_iter->second->Set(durations[i]);
+    }
   }
 
   return collected_metrics;
@@ -1,30 +1,52 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "CivetServer.h"
+#include "collectable_set.h"
 #include "prometheus/registry.h"
 
 namespace prometheus {
 namespace detail {
 class MetricsHandler : public CivetHandler {
  public:
-  MetricsHandler(const std::vector<std::weak_ptr<Collectable>>& collectables,
-                 Registry& registry);
+  MetricsHandler(CollectableSet& collectables, Registry& registry);
 
   bool handleGet(CivetServer* server, struct mg_connection* conn) override;
 
  private:
-  builders_t CollectMetrics() const;
+  builders_t CollectMetrics();
+  // Creates the collect duration series of the collectables in `ids` that
+  // have none and removes the series of collectables no longer in the set,
+  // unless a scrape with a newer snapshot got there first.
+  void SyncCollectableDurations(const std::vector<std::size_t>& ids,
+                                std::size_t version);
 
-  const std::vector<std::weak_ptr<Collectable>>& collectables_;
+  CollectableSet& collectables_;
   Family<Counter>& bytes_transferred_family_;
   Counter& bytes_transferred_;
   Family<Counter>& num_scrapes_family_;
   Counter& num_scrapes_;
   Family<Histogram>& request_latencies_family_;
   Histogram& request_latencies_;
+  Family<Histogram>& stage_latencies_family_;
+  Histogram& collect_latencies_;
+  Histogram& serialize_latencies_;
+  Histogram& write_latencies_;
+  Family<Gauge>& collectable_durations_family_;
+  // Collect duration series by the id CollectableSet gives a collectable.
+  // Only scrapes touch them, so registration never waits for this mutex.
+  std::mutex collectable_durations_mutex_;
+  std::unordered_map<std::size_t, Gauge*> collectable_durations_;
+  std::size_t collectable_durations_version_ = 0;
+  Family<Gauge>& last_scrape_family_;
+  Gauge& scraped_series_;
+  Gauge& scraped_bytes_;
+  Gauge& peak_buffer_bytes_;
 };
 }
 }
@@ -2,6 +2,7 @@
 #include <cassert>
 #include <iterator>
 #include <numeric>
+#include <vector>
 
 #include "prometheus/histogram.h"
 
@@ -13,19 +14,95 @@ Histogram::Histogram(const BucketBoundaries& buckets)
                         std::end(bucket_boundaries_)));
 }
 
-void Histogram::Observe(double value) {
+std::size_t Histogram::BucketIndex(double value) const {
   // TODO: determine bucket list size at which binary search would be faster
   // NOTE: linear search is faster than binary search when array is small
-  auto bucket_index = static_cast<std::size_t>(std::distance(
+  return static_cast<std::size_t>(std::distance(
       bucket_boundaries_.begin(),
       std::find_if(bucket_boundaries_.begin(), bucket_boundaries_.end(),
                    [value](double boundary) { return boundary > value; })));
+}
+
+void Histogram::Observe(double value) {
+  auto bucket_index = BucketIndex(value);
   sum_.Increment(value);
   bucket_counts_[bucket_index].Increment();
+  MarkUpdated();
+}
+
+void Histogram::Observe(double value, std::uint64_t weight) {
+  auto bucket_index = BucketIndex(value);
+  sum_.Increment(value * weight);
+  bucket_counts_[bucket_index].Increment(weight);
+  MarkUpdated();
+}
+
+void Histogram::ObserveBatch(const double* values, std::size_t count) {
+  if (count <= 1) {
+    if (count == 1) {
+      Observe(values[0]);
+    }
+    return;
+  }
+
+  // counts per bucket, on the stack for the usual handful of buckets
+  const std::size_t kStackBuckets = 64;
+  std::uint64_t stack_counts[kStackBuckets];
+  auto heap_counts = std::vector<std::uint64_t>{};
+  auto counts = stack_counts;
+  if (bucket_counts_.size() > kStackBuckets) {
+    heap_counts.resize(bucket_counts_.size());
+    counts = heap_counts.data();
+  } else {
+    std::fill(counts, counts + bucket_counts_.size(), 0);
+  }
+
+  auto bounds = bucket_boundaries_.data();
+  auto bound_count = bucket_boundaries_.size();
+  auto sum = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    auto value = values[i];
+    std::size_t bucket_index = 0;
+    if (bound_count <= kStackBuckets) {
+      // counting the bounds not above the value has no data dependent
+      // branches and vectorizes, unlike searching for the first one above it
+      for (std::size_t j = 0; j < bound_count; ++j) {
+        bucket_index += !(bounds[j] > value);
+      }
+    } else {
+      bucket_index = static_cast<std::size_t>(
+          std::upper_bound(bounds, bounds + bound_count, value) - bounds);
+    }
+    ++counts[bucket_index];
+    // Observe() drops negative values from the sum, see Counter::Increment
+    sum += value < 0.0 ? 0.0 : value;
+  }
+
+  for (std::size_t i = 0; i < bucket_counts_.size(); ++i) {
+    if (counts[i] != 0) {
+      bucket_counts_[i].Increment(static_cast<double>(counts[i]));
+    }
+  }
+  sum_.Increment(sum);
+  MarkUpdated();
 }
 
 metric_collect_t Histogram::Collect(label_pair_t* global_labels,
                                     flatbuffers::FlatBufferBuilder* builder) {
+  FlushLocalRecorders();
+  auto bucket_counts = std::vector<double>{};
+  bucket_counts.reserve(bucket_counts_.size());
+  for (const auto& counter : bucket_counts_) {
+    bucket_counts.push_back(counter.Value());
+  }
+  return CollectValue(bucket_boundaries_, bucket_counts, sum_.Value(),
+                      global_labels, builder);
+}
+
+metric_collect_t Histogram::CollectValue(
+    const BucketBoundaries& bucket_boundaries,
+    const std::vector<double>& bucket_counts, double sum,
+    label_pair_t* global_labels, flatbuffers::FlatBufferBuilder* builder) {
   using namespace io::prometheus::client;
   std::vector<flatbuffers::Offset<LabelPair>> labels_vec;
   for (const auto& p : *global_labels) {
@@ -36,20 +113,18 @@ metric_collect_t Histogram::Collect(label_pair_t* global_labels,
   }
   auto labels = (*builder).CreateVector(labels_vec);
 
-  auto sample_count = std::accumulate(
-      bucket_counts_.begin(), bucket_counts_.end(), double{0},
-      [](double sum, const Counter& counter) { return sum + counter.Value(); });
-  auto sum = sum_.Value();
+  auto sample_count =
+      std::accumulate(bucket_counts.begin(), bucket_counts.end(), double{0});
 
   std::vector<flatbuffers::Offset<Bucket>> bucket_vec;
   auto cumulative_count = 0ULL;
 
-  for (std::size_t i = 0; i < bucket_counts_.size(); i++) {
-    cumulative_count += bucket_counts_[i].Value();
+  for (std::size_t i = 0; i < bucket_counts.size(); i++) {
+    cumulative_count += bucket_counts[i];
 
-    auto val = (i == bucket_boundaries_.size())
+    auto val = (i == bucket_boundaries.size())
                    ? std::numeric_limits<double>::infinity()
-                   : bucket_boundaries_[i];
+                   : bucket_boundaries[i];
     bucket_vec.emplace_back(CreateBucket(*builder, cumulative_count, val));
   }
   auto buckets = (*builder).CreateVector(bucket_vec);
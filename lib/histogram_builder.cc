@@ -1,5 +1,8 @@
 #include "prometheus/histogram_builder.h"
 #include "prometheus/registry.h"
+#include "prometheus/shared_memory.h"
+
+#include "self_metrics.h"
 
 namespace prometheus {
 
@@ -23,8 +26,44 @@ HistogramBuilder& HistogramBuilder::Help(const std::string& help) {
   return *this;
 }
 
+HistogramBuilder& HistogramBuilder::IdleTimeout(
+    std::chrono::steady_clock::duration idle_timeout) {
+  idle_timeout_ = idle_timeout;
+  return *this;
+}
+
+HistogramBuilder& HistogramBuilder::MaxSeries(std::size_t max_series) {
+  max_series_ = max_series;
+  return *this;
+}
+
+HistogramBuilder& HistogramBuilder::CacheLineAligned(bool aligned) {
+  cache_line_aligned_ = aligned;
+  return *this;
+}
+
 Family<Histogram>& HistogramBuilder::Register(Registry& registry) {
-  return registry.AddHistogram(name_, help_, labels_);
+  auto& family = registry.AddHistogram(name_, help_, labels_);
+  if (cache_line_aligned_) {
+    family.SetCacheLineAligned(true);
+  }
+  if (idle_timeout_ > std::chrono::steady_clock::duration::zero()) {
+    family.SetIdleTimeout(idle_timeout_, registry.Id());
+  }
+  if (max_series_ > 0) {
+    auto id = registry.Id();
+    auto name = name_;
+    family.SetMaxSeries(
+        max_series_, &detail::FamilySeriesGauge(id, name),
+        &detail::FamilyOverflowCounter(id, name),
+        [id, name] { detail::RemoveFamilySeriesLimit(id, name); });
+  }
+  return family;
+}
+
+SharedFamily<Histogram>& HistogramBuilder::RegisterShared(
+    SharedMemorySegment& segment) {
+  return segment.Family<Histogram>(name_, help_, labels_);
 }
 }
 }
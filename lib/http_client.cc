@@ -0,0 +1,189 @@
+#include "http_client.h"
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+struct Url {
+  std::string host;
+  std::string port;
+  std::string path;
+};
+
+bool ParseUrl(const std::string& url, Url* parsed) {
+  const std::string scheme = "http://";
+  if (url.compare(0, scheme.size(), scheme) != 0) {
+    return false;
+  }
+  auto authority_end = url.find('/', scheme.size());
+  auto authority = url.substr(scheme.size(), authority_end - scheme.size());
+  parsed->path =
+      authority_end == std::string::npos ? "/" : url.substr(authority_end);
+  auto colon = authority.rfind(':');
+  if (colon == std::string::npos) {
+    parsed->host = authority;
+    parsed->port = "80";
+  } else {
+    parsed->host = authority.substr(0, colon);
+    parsed->port = authority.substr(colon + 1);
+  }
+  return !parsed->host.empty();
+}
+
+// Waits until `fd` is ready for `events` or the deadline passed.
+bool Wait(int fd, short events,
+          std::chrono::steady_clock::time_point deadline) {
+  for (;;) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) {
+      return false;
+    }
+    pollfd poll_fd{fd, events, 0};
+    auto ready = poll(&poll_fd, 1, static_cast<int>(remaining.count()));
+    if (ready > 0) {
+      return true;
+    }
+    if (ready == 0 || errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+int Connect(const Url& url, std::chrono::steady_clock::time_point deadline) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &addresses) !=
+      0) {
+    return -1;
+  }
+
+  auto fd = -1;
+  for (auto address = addresses; address; address = address->ai_next) {
+    fd = socket(address->ai_family,
+                address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    auto error = 0;
+    socklen_t length = sizeof(error);
+    if (errno == EINPROGRESS && Wait(fd, POLLOUT, deadline) &&
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 &&
+        error == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+  return fd;
+}
+
+bool SendAll(int fd, const std::string& data,
+             std::chrono::steady_clock::time_point deadline) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    auto bytes = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (bytes > 0) {
+      sent += bytes;
+    } else if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!Wait(fd, POLLOUT, deadline)) {
+        return false;
+      }
+    } else if (bytes < 0 && errno != EINTR) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads until the status line is complete and returns its status code.
+int ReadStatus(int fd, std::chrono::steady_clock::time_point deadline) {
+  std::string response;
+  char buffer[512];
+  while (response.find("\r\n") == std::string::npos) {
+    auto bytes = recv(fd, buffer, sizeof(buffer), 0);
+    if (bytes > 0) {
+      response.append(buffer, bytes);
+    } else if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!Wait(fd, POLLIN, deadline)) {
+        return -1;
+      }
+    } else if (bytes == 0 || errno != EINTR) {
+      return -1;
+    }
+  }
+  // HTTP/1.1 200 OK
+  auto space = response.find(' ');
+  if (space == std::string::npos) {
+    return -1;
+  }
+  return std::atoi(response.c_str() + space + 1);
+}
+}  // namespace
+
+int HttpRequest(const std::string& method, const std::string& url,
+                const http_headers_t& headers, const std::string& body,
+                std::chrono::milliseconds timeout) {
+  Url parsed;
+  if (!ParseUrl(url, &parsed)) {
+    return -1;
+  }
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  auto fd = Connect(parsed, deadline);
+  if (fd < 0) {
+    return -1;
+  }
+
+  auto request = method + " " + parsed.path + " HTTP/1.1\r\n" + "Host: " +
+                 parsed.host + ":" + parsed.port + "\r\n" +
+                 "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                 "Connection: close\r\n";
+  for (const auto& header : headers) {
+    request += header.first + ": " + header.second + "\r\n";
+  }
+  request += "\r\n";
+
+  auto status = -1;
+  if (SendAll(fd, request, deadline) && SendAll(fd, body, deadline)) {
+    status = ReadStatus(fd, deadline);
+  }
+  close(fd);
+  return status;
+}
+
+std::string UrlEncode(const std::string& value) {
+  std::string encoded;
+  encoded.reserve(value.size());
+  for (unsigned char c : value) {
+    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+      encoded.push_back(c);
+    } else {
+      char escaped[4];
+      std::snprintf(escaped, sizeof(escaped), "%%%02X", c);
+      encoded.append(escaped);
+    }
+  }
+  return encoded;
+}
+}
+}
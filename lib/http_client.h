@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace prometheus {
+namespace detail {
+
+using http_headers_t = std::vector<std::pair<std::string, std::string>>;
+
+// Sends one HTTP/1.1 request to `url` (http://host[:port]/path) over a new
+// connection and waits for the response. Returns the response status code,
+// or -1 if the server could not be reached or did not answer within
+// `timeout`.
+int HttpRequest(const std::string& method, const std::string& url,
+                const http_headers_t& headers, const std::string& body,
+                std::chrono::milliseconds timeout);
+
+// Percent-encodes everything but unreserved characters, e.g. for label
+// values used as path segments.
+std::string UrlEncode(const std::string& value);
+}
+}
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <thread>
+
+#include "prometheus/counter.h"
+#include "prometheus/idle_sweeper.h"
+
+#include "self_metrics.h"
+
+namespace prometheus {
+namespace detail {
+
+IdleSweeper& IdleSweeper::Instance() {
+  // intentionally leaked: the detached sweeper thread may still run while
+  // static destructors execute
+  static auto sweeper = new IdleSweeper;
+  return *sweeper;
+}
+
+void IdleSweeper::Register(const void* family, const std::string& registry,
+                           const std::string& name,
+                           std::chrono::steady_clock::duration idle_timeout,
+                           Sweep sweep) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  families_[family] = Entry{registry, name, idle_timeout, std::move(sweep)};
+  if (!running_) {
+    running_ = true;
+    std::thread{&IdleSweeper::Run, this}.detach();
+  }
+  wakeup_.notify_one();
+}
+
+void IdleSweeper::Unregister(const void* family) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto iter = families_.find(family);
+  if (iter == families_.end()) {
+    return;
+  }
+  // sweeps increment the counter under mutex_, so none can recreate it
+  RemoveEvictedSeriesCounter(iter->second.registry, iter->second.name);
+  families_.erase(iter);
+}
+
+std::chrono::steady_clock::duration IdleSweeper::Interval() const {
+  // sweep often enough that a series outlives its timeout by at most a
+  // quarter of the shortest timeout
+  auto shortest = std::chrono::steady_clock::duration::max();
+  for (const auto& f : families_) {
+    shortest = std::min(shortest, f.second.idle_timeout);
+  }
+  return std::max<std::chrono::steady_clock::duration>(
+      shortest / 4, std::chrono::milliseconds(10));
+}
+
+void IdleSweeper::Run() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  for (;;) {
+    if (families_.empty()) {
+      wakeup_.wait(lock);
+      continue;
+    }
+    wakeup_.wait_for(lock, Interval());
+
+    // families unregister under mutex_, so none can go away mid-sweep
+    auto now = std::chrono::steady_clock::now();
+    for (auto& f : families_) {
+      auto evicted = f.second.sweep(now);
+      if (evicted > 0) {
+        EvictedSeriesCounter(f.second.registry, f.second.name)
+            .Increment(evicted);
+      }
+    }
+  }
+}
+}
+}
@@ -0,0 +1,171 @@
+#include "prometheus/line_protocol_exporter.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "line_protocol_serializer.h"
+
+namespace prometheus {
+
+namespace {
+
+bool StartsWith(const std::string& value, const std::string& prefix) {
+  return value.compare(0, prefix.size(), prefix) == 0;
+}
+
+std::vector<unsigned char> ToBytes(const void* address, std::size_t size) {
+  auto bytes = static_cast<const unsigned char*>(address);
+  return std::vector<unsigned char>(bytes, bytes + size);
+}
+
+// Opens a datagram socket for `address` and stores the raw destination in
+// `destination`.
+int OpenSocket(const std::string& address,
+               std::vector<unsigned char>* destination) {
+  const std::string udp = "udp://";
+  const std::string unixgram = "unixgram://";
+
+  if (StartsWith(address, unixgram)) {
+    auto path = address.substr(unixgram.size());
+    sockaddr_un un{};
+    if (path.empty() || path.size() >= sizeof(un.sun_path)) {
+      throw std::invalid_argument("invalid unix socket path: " + path);
+    }
+    un.sun_family = AF_UNIX;
+    std::memcpy(un.sun_path, path.data(), path.size());
+    *destination = ToBytes(&un, sizeof(un));
+    return socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  }
+
+  if (!StartsWith(address, udp)) {
+    throw std::invalid_argument("unsupported address: " + address);
+  }
+  auto authority = address.substr(udp.size());
+  auto colon = authority.rfind(':');
+  if (colon == std::string::npos || colon + 1 == authority.size()) {
+    throw std::invalid_argument("missing port in address: " + address);
+  }
+  auto host = authority.substr(0, colon);
+  auto port = authority.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(),
+                  &hints, &addresses) != 0 ||
+      !addresses) {
+    throw std::invalid_argument("cannot resolve address: " + address);
+  }
+  *destination = ToBytes(addresses->ai_addr, addresses->ai_addrlen);
+  auto fd = socket(addresses->ai_family,
+                   SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  freeaddrinfo(addresses);
+  return fd;
+}
+}  // namespace
+
+LineProtocolExporter::LineProtocolExporter(
+    const std::string& address, const LineProtocolExporterOptions& options)
+    : options_(options) {
+  fd_ = OpenSocket(address, &address_);
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string{"cannot open socket: "} +
+                             std::strerror(errno));
+  }
+  if (options_.interval.count() > 0) {
+    sender_ = std::thread{&LineProtocolExporter::Run, this};
+  }
+}
+
+LineProtocolExporter::~LineProtocolExporter() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  wakeup_.notify_one();
+  if (sender_.joinable()) {
+    sender_.join();
+  }
+  close(fd_);
+}
+
+void LineProtocolExporter::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  collectables_.push_back(collectable);
+}
+
+void LineProtocolExporter::SendNow() {
+  auto collectables = std::vector<std::weak_ptr<Collectable>>{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    collectables = collectables_;
+  }
+  auto metrics = builders_t{};
+  for (auto& weak : collectables) {
+    if (auto collectable = weak.lock()) {
+      auto collected = collectable->Collect();
+      metrics.insert(metrics.end(), collected.begin(), collected.end());
+    }
+  }
+  auto lines = LineProtocolSerializer{}.Serialize(metrics);
+
+  // pack whole lines into datagrams, a line is never split across two
+  std::lock_guard<std::mutex> lock{send_mutex_};
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  while (end < lines.size()) {
+    auto next = lines.find('\n', end) + 1;
+    if (next - end > options_.max_datagram_size) {
+      if (end > begin) {
+        SendDatagram(lines.data() + begin, end - begin);
+      }
+      ++dropped_datagrams_;
+      begin = end = next;
+    } else if (next - begin > options_.max_datagram_size) {
+      SendDatagram(lines.data() + begin, end - begin);
+      begin = end;
+    } else {
+      end = next;
+    }
+  }
+  if (end > begin) {
+    SendDatagram(lines.data() + begin, end - begin);
+  }
+}
+
+void LineProtocolExporter::SendDatagram(const char* data, std::size_t size) {
+  auto sent = sendto(fd_, data, size, MSG_NOSIGNAL,
+                     reinterpret_cast<const sockaddr*>(address_.data()),
+                     static_cast<socklen_t>(address_.size()));
+  if (sent == static_cast<ssize_t>(size)) {
+    ++sent_datagrams_;
+  } else {
+    ++dropped_datagrams_;
+  }
+}
+
+void LineProtocolExporter::Run() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (!stopping_) {
+    if (wakeup_.wait_for(lock, options_.interval,
+                         [this] { return stopping_; })) {
+      return;
+    }
+    lock.unlock();
+    SendNow();
+    lock.lock();
+  }
+}
+}
@@ -0,0 +1,166 @@
+#include "line_protocol_serializer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+namespace prometheus {
+
+using namespace io::prometheus::client;
+
+namespace {
+
+// Shortest representation that parses back to the same value. Infinity and
+// NaN cannot be represented in the line protocol at all.
+std::string ToString(double v) {
+  char buffer[32];
+  for (auto precision = 1; precision <= 17; ++precision) {
+    std::snprintf(buffer, sizeof(buffer), "%.*g", precision, v);
+    if (std::strtod(buffer, nullptr) == v) {
+      break;
+    }
+  }
+  return buffer;
+}
+
+// Measurements escape commas, spaces and backslashes, tag keys, tag values
+// and field keys additionally escape equal signs. Line breaks cannot be
+// escaped in the protocol, they are written as \n and \r instead of ending
+// the line.
+void AppendEscaped(std::string* out, const std::string& value,
+                   bool escape_equals) {
+  for (auto c : value) {
+    if (c == '\n' || c == '\r') {
+      out->append(c == '\n' ? "\\n" : "\\r");
+      continue;
+    }
+    if (c == ',' || c == ' ' || c == '\\' || (escape_equals && c == '=')) {
+      out->push_back('\\');
+    }
+    out->push_back(c);
+  }
+}
+
+class LineWriter {
+ public:
+  LineWriter(std::string* out, const MetricFamily* family,
+             const Metric* metric)
+      : out_(out), metric_(metric), start_(out->size()) {
+    AppendEscaped(out_, family->name()->str(), false);
+
+    auto tags = std::vector<std::pair<std::string, std::string>>{};
+    auto labels = metric->label();
+    for (unsigned int i = 0; labels && i < labels->size(); ++i) {
+      // empty tag values are not allowed by the protocol
+      if (labels->Get(i)->value()->size() != 0) {
+        tags.emplace_back(labels->Get(i)->name()->str(),
+                          labels->Get(i)->value()->str());
+      }
+    }
+    // InfluxDB expects tags sorted by key
+    std::sort(tags.begin(), tags.end());
+    for (const auto& tag : tags) {
+      out_->push_back(',');
+      AppendEscaped(out_, tag.first, true);
+      out_->push_back('=');
+      AppendEscaped(out_, tag.second, true);
+    }
+  }
+
+  void Field(const std::string& key, double value) {
+    if (std::isnan(value) || std::isinf(value)) {
+      return;
+    }
+    out_->push_back(fields_ == 0 ? ' ' : ',');
+    AppendEscaped(out_, key, true);
+    out_->push_back('=');
+    out_->append(ToString(value));
+    ++fields_;
+  }
+
+  // Terminates the line, or takes it back if it ended up without fields.
+  void Finish() {
+    if (fields_ == 0) {
+      out_->resize(start_);
+      return;
+    }
+    if (metric_->timestamp_ms() != 0) {
+      out_->push_back(' ');
+      // nanosecond precision is the protocol's default
+      out_->append(std::to_string(metric_->timestamp_ms()));
+      out_->append("000000");
+    }
+    out_->push_back('\n');
+  }
+
+ private:
+  std::string* out_;
+  const Metric* metric_;
+  const std::size_t start_;
+  int fields_ = 0;
+};
+
+void SerializeMetric(std::string* out, const MetricFamily* family,
+                     const Metric* metric) {
+  LineWriter line{out, family, metric};
+  switch (family->type()) {
+    case MetricType_COUNTER:
+      line.Field("counter", metric->counter()->value());
+      break;
+
+    case MetricType_GAUGE:
+      line.Field("gauge", metric->gauge()->value());
+      break;
+
+    case MetricType_UNTYPED:
+      line.Field("value", metric->untyped()->value());
+      break;
+
+    case MetricType_SUMMARY: {
+      auto summary = metric->summary();
+      line.Field("count", summary->sample_count());
+      line.Field("sum", summary->sample_sum());
+      auto quantiles = summary->quantile();
+      for (unsigned int i = 0; quantiles && i < quantiles->size(); ++i) {
+        line.Field(ToString(quantiles->Get(i)->quantile()),
+                   quantiles->Get(i)->value());
+      }
+      break;
+    }
+
+    case MetricType_HISTOGRAM: {
+      auto histogram = metric->histogram();
+      line.Field("count", histogram->sample_count());
+      line.Field("sum", histogram->sample_sum());
+      auto buckets = histogram->bucket();
+      for (unsigned int i = 0; buckets && i < buckets->size(); ++i) {
+        auto bound = buckets->Get(i)->upper_bound();
+        if (!std::isinf(bound)) {
+          line.Field(ToString(bound), buckets->Get(i)->cumulative_count());
+        }
+      }
+      // the +Inf bucket is the count field
+      break;
+    }
+
+    default:
+      break;
+  }
+  line.Finish();
+}
+}  // namespace
+
+std::string LineProtocolSerializer::Serialize(builders_t& builders) {
+  std::string out;
+  for (auto& bld : builders) {
+    auto family = GetMetricFamily(bld->GetBufferPointer());
+    auto metrics = family->metric();
+    for (unsigned int i = 0; metrics && i < metrics->size(); ++i) {
+      SerializeMetric(&out, family, metrics->Get(i));
+    }
+  }
+  return out;
+}
+}
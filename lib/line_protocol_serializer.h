@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "serializer.h"
+
+namespace prometheus {
+
+// Serializes to the InfluxDB line protocol as understood by Telegraf. Every
+// metric becomes one line named after its family with the labels as tags.
+// Fields follow Telegraf's prometheus input: counter, gauge and value for
+// single values, count, sum and one field per bucket bound or quantile for
+// histograms and summaries.
+class LineProtocolSerializer : public Serializer {
+ public:
+  virtual std::string Serialize(builders_t& builders) override;
+};
+}
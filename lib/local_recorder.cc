@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+#include "prometheus/local_recorder.h"
+
+namespace prometheus {
+namespace detail {
+
+void FlushLocalRecorders(const Metric* metric) {
+  LocalFlusher::Instance().FlushMetric(metric);
+}
+
+LocalRecorder::LocalRecorder(Metric& target,
+                             const LocalRecorderOptions& options)
+    : target_(target),
+      options_(options),
+      last_flush_(
+          std::chrono::steady_clock::now().time_since_epoch().count()) {}
+
+void LocalRecorder::Start() { LocalFlusher::Instance().Register(this); }
+
+void LocalRecorder::Stop() {
+  // once unregistered the flusher no longer calls into this recorder, so
+  // the final flush is the last one
+  LocalFlusher::Instance().Unregister(this);
+  Flush();
+}
+
+void LocalRecorder::Flush() {
+  std::lock_guard<std::mutex> lock{flush_mutex_};
+  Publish();
+  last_flush_.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                    std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::time_point LocalRecorder::last_flush() const {
+  return std::chrono::steady_clock::time_point{
+      std::chrono::steady_clock::duration{
+          last_flush_.load(std::memory_order_relaxed)}};
+}
+
+LocalFlusher& LocalFlusher::Instance() {
+  // intentionally leaked: the detached flusher thread may still run while
+  // static destructors execute
+  static auto flusher = new LocalFlusher;
+  return *flusher;
+}
+
+void LocalFlusher::Register(LocalRecorder* recorder) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  recorders_.insert({&recorder->target(), recorder});
+  recorder->target().local_recorders_.fetch_add(1);
+  auto staleness = recorder->options().max_staleness;
+  if (staleness > std::chrono::steady_clock::duration::zero()) {
+    if (!running_) {
+      running_ = true;
+      std::thread{&LocalFlusher::Run, this}.detach();
+    }
+    wakeup_.notify_one();
+  }
+}
+
+void LocalFlusher::Unregister(LocalRecorder* recorder) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto range = recorders_.equal_range(&recorder->target());
+  for (auto recorders_iter = range.first; recorders_iter != range.second;
+       ++recorders_iter) {
+    if (recorders_iter->second == recorder) {
+      recorders_.erase(recorders_iter);
+      recorder->target().local_recorders_.fetch_sub(1);
+      return;
+    }
+  }
+}
+
+void LocalFlusher::FlushMetric(const Metric* metric) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto range = recorders_.equal_range(metric);
+  for (auto recorders_iter = range.first; recorders_iter != range.second;
+       ++recorders_iter) {
+    recorders_iter->second->Flush();
+  }
+}
+
+std::chrono::steady_clock::duration LocalFlusher::Interval() const {
+  // recorders are flushed once their last flush is half their staleness
+  // bound ago, so waking up every half of the tightest bound keeps every
+  // update within its bound
+  auto shortest = std::chrono::steady_clock::duration::max();
+  for (const auto& r : recorders_) {
+    auto staleness = r.second->options().max_staleness;
+    if (staleness > std::chrono::steady_clock::duration::zero()) {
+      shortest = std::min(shortest, staleness);
+    }
+  }
+  if (shortest == std::chrono::steady_clock::duration::max()) {
+    return std::chrono::seconds(1);
+  }
+  return std::max<std::chrono::steady_clock::duration>(
+      shortest / 2, std::chrono::milliseconds(1));
+}
+
+void LocalFlusher::Run() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  for (;;) {
+    if (recorders_.empty()) {
+      wakeup_.wait(lock);
+      continue;
+    }
+    wakeup_.wait_for(lock, Interval());
+
+    // recorders unregister under mutex_, so none can go away mid-flush
+    auto now = std::chrono::steady_clock::now();
+    for (auto& r : recorders_) {
+      auto recorder = r.second;
+      auto staleness = recorder->options().max_staleness;
+      if (staleness > std::chrono::steady_clock::duration::zero() &&
+          now - recorder->last_flush() >= staleness / 2) {
+        recorder->Flush();
+      }
+    }
+  }
+}
+}  // namespace detail
+
+LocalCounter::LocalCounter(Counter& counter,
+                           const LocalRecorderOptions& options)
+    : LocalRecorder(counter, options), counter_(counter), total_(0.0) {
+  Start();
+}
+
+LocalCounter::~LocalCounter() { Stop(); }
+
+void LocalCounter::Publish() {
+  auto total = total_.load(std::memory_order_relaxed);
+  if (total != published_) {
+    counter_.Increment(total - published_);
+    published_ = total;
+  }
+}
+
+LocalHistogram::LocalHistogram(Histogram& histogram,
+                               const LocalRecorderOptions& options)
+    : LocalRecorder(histogram, options),
+      histogram_(histogram),
+      bucket_boundaries_(histogram.bucket_boundaries_),
+      counts_(new std::atomic<std::uint64_t>[bucket_boundaries_.size() + 1]),
+      sum_(0.0),
+      published_counts_(bucket_boundaries_.size() + 1) {
+  for (std::size_t i = 0; i < published_counts_.size(); ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+  Start();
+}
+
+LocalHistogram::~LocalHistogram() { Stop(); }
+
+std::size_t LocalHistogram::BucketIndex(double value) const {
+  return static_cast<std::size_t>(std::distance(
+      bucket_boundaries_.begin(),
+      std::find_if(bucket_boundaries_.begin(), bucket_boundaries_.end(),
+                   [value](double boundary) { return boundary > value; })));
+}
+
+void LocalHistogram::Publish() {
+  auto published = false;
+  for (std::size_t i = 0; i < published_counts_.size(); ++i) {
+    auto count = counts_[i].load(std::memory_order_relaxed);
+    if (count != published_counts_[i]) {
+      histogram_.bucket_counts_[i].Increment(
+          static_cast<double>(count - published_counts_[i]));
+      published_counts_[i] = count;
+      published = true;
+    }
+  }
+  auto sum = sum_.load(std::memory_order_relaxed);
+  if (sum != published_sum_) {
+    histogram_.sum_.Increment(sum - published_sum_);
+    published_sum_ = sum;
+    published = true;
+  }
+  if (published) {
+    histogram_.MarkUpdated();
+  }
+}
+}  // namespace prometheus
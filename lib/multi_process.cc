@@ -0,0 +1,250 @@
+#include "prometheus/multi_process.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "shared_memory_layout.h"
+
+namespace prometheus {
+
+namespace {
+
+using io::prometheus::client::MetricType_GAUGE;
+
+const std::string kWorkerPrefix = "worker-";
+const std::string kWorkerSuffix = ".shm";
+
+struct WorkerFile {
+  std::string path;
+  std::int64_t pid;
+  std::int64_t started;
+};
+
+// Parses worker-<pid>-<started>.shm as written by CreateWorkerSegment().
+bool ParseWorkerFile(const std::string& directory, const std::string& name,
+                     WorkerFile* file) {
+  if (name.size() <= kWorkerPrefix.size() + kWorkerSuffix.size() ||
+      name.compare(0, kWorkerPrefix.size(), kWorkerPrefix) != 0 ||
+      name.compare(name.size() - kWorkerSuffix.size(), kWorkerSuffix.size(),
+                   kWorkerSuffix) != 0) {
+    return false;
+  }
+  char* end = nullptr;
+  file->pid = std::strtoll(name.c_str() + kWorkerPrefix.size(), &end, 10);
+  if (*end != '-') {
+    return false;
+  }
+  file->started = std::strtoll(end + 1, &end, 10);
+  if (std::string{end} != kWorkerSuffix) {
+    return false;
+  }
+  file->path = directory + "/" + name;
+  return true;
+}
+
+std::vector<WorkerFile> ListWorkerFiles(const std::string& directory) {
+  auto files = std::vector<WorkerFile>{};
+  auto dir = opendir(directory.c_str());
+  if (!dir) {
+    return files;
+  }
+  while (auto entry = readdir(dir)) {
+    WorkerFile file;
+    if (ParseWorkerFile(directory, entry->d_name, &file)) {
+      files.push_back(file);
+    }
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end(),
+            [](const WorkerFile& a, const WorkerFile& b) {
+              return a.started < b.started;
+            });
+  return files;
+}
+
+bool IsAlive(std::int64_t pid) {
+  return pid > 0 &&
+         (kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM);
+}
+
+std::string SeriesKey(const detail::RecordView& record) {
+  return detail::SeriesKey(record.name, record.labels);
+}
+
+// Series that disagree on type or buckets cannot be combined; the first one
+// seen wins.
+bool Compatible(const detail::RecordView& a, const detail::RecordView& b) {
+  return a.type == b.type && a.bounds == b.bounds &&
+         a.values.size() == b.values.size();
+}
+
+// Name of the label that tells the workers of a kPerProcess gauge apart:
+// pid, prefixed with worker_ until it does not clash with a label of the
+// gauge itself.
+std::string PidLabel(const detail::RecordView& record) {
+  auto name = std::string{"pid"};
+  for (;;) {
+    auto taken = std::any_of(
+        record.labels.begin(), record.labels.end(),
+        [&name](const label_pair_t::value_type& label) {
+          return label.first == name;
+        });
+    if (!taken) {
+      return name;
+    }
+    name = "worker_" + name;
+  }
+}
+
+void AddValues(detail::RecordView* into, const detail::RecordView& from) {
+  for (std::size_t i = 0; i < into->values.size(); ++i) {
+    into->values[i] += from.values[i];
+  }
+}
+}  // namespace
+
+std::unique_ptr<SharedMemorySegment> CreateWorkerSegment(
+    const std::string& directory, std::size_t size) {
+  auto started = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+  auto path = directory + "/" + kWorkerPrefix + std::to_string(getpid()) +
+              "-" + std::to_string(started) + kWorkerSuffix;
+  return std::unique_ptr<SharedMemorySegment>{
+      new SharedMemorySegment{path, size}};
+}
+
+MultiProcessCollector::MultiProcessCollector(
+    const std::string& directory, const MultiProcessOptions& options)
+    : directory_(directory), options_(options) {}
+
+MultiProcessCollector::~MultiProcessCollector() = default;
+
+GaugeMode MultiProcessCollector::ModeOf(const std::string& name) const {
+  auto mode = options_.gauge_modes.find(name);
+  return mode == options_.gauge_modes.end() ? options_.default_gauge_mode
+                                             : mode->second;
+}
+
+builders_t MultiProcessCollector::Collect() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto files = ListWorkerFiles(directory_);
+
+  // only the newest file of a pid can belong to a running worker, older ones
+  // are left over from a process whose pid was reused
+  auto newest = std::unordered_map<std::int64_t, std::size_t>{};
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    newest[files[i].pid] = i;
+  }
+
+  auto merged = std::vector<detail::RecordView>{};
+  auto index = std::unordered_map<std::string, std::size_t>{};
+  auto records = std::vector<detail::RecordView>{};
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    records.clear();
+    auto pid = files[i].pid;
+    auto valid = detail::ReadSegmentFile(files[i].path, &pid, &records);
+    auto alive = newest[files[i].pid] == i && IsAlive(pid);
+
+    if (!alive) {
+      for (const auto& record : records) {
+        if (record.type == MetricType_GAUGE) {
+          continue;
+        }
+        auto key = SeriesKey(record);
+        auto archived = archived_.find(key);
+        if (archived == archived_.end()) {
+          archived_order_.push_back(key);
+          archived_.insert(
+              {key, std::unique_ptr<detail::RecordView>{
+                        new detail::RecordView(record)}});
+        } else if (Compatible(*archived->second, record)) {
+          AddValues(archived->second.get(), record);
+        } else {
+          ++dropped_records_;
+        }
+      }
+      // the values now live in archived_, the file must not count twice
+      unlink(files[i].path.c_str());
+      continue;
+    }
+    if (!valid) {
+      continue;
+    }
+
+    for (auto& record : records) {
+      auto mode = ModeOf(record.name);
+      if (record.type == MetricType_GAUGE && mode == GaugeMode::kPerProcess) {
+        record.labels.emplace_back(PidLabel(record), std::to_string(pid));
+      }
+      auto key = SeriesKey(record);
+      auto inserted = index.insert({key, merged.size()});
+      if (inserted.second) {
+        merged.push_back(std::move(record));
+        continue;
+      }
+      auto& into = merged[inserted.first->second];
+      if (!Compatible(into, record)) {
+        ++dropped_records_;
+        continue;
+      }
+      if (record.type != MetricType_GAUGE) {
+        AddValues(&into, record);
+        continue;
+      }
+      switch (mode) {
+        case GaugeMode::kSum:
+          into.values[0] += record.values[0];
+          break;
+        case GaugeMode::kMin:
+          into.values[0] = std::min(into.values[0], record.values[0]);
+          break;
+        case GaugeMode::kMax:
+          into.values[0] = std::max(into.values[0], record.values[0]);
+          break;
+        case GaugeMode::kLatest:
+          // files are ordered by start time
+          into.values[0] = record.values[0];
+          break;
+        case GaugeMode::kPerProcess:
+          break;
+      }
+    }
+  }
+
+  // totals of exited workers come first, then the live workers add to them
+  auto families = std::vector<detail::RecordView>{};
+  families.reserve(archived_order_.size() + merged.size());
+  for (const auto& key : archived_order_) {
+    families.push_back(*archived_[key]);
+    auto live = index.find(key);
+    if (live == index.end()) {
+      continue;
+    }
+    if (Compatible(families.back(), merged[live->second])) {
+      AddValues(&families.back(), merged[live->second]);
+    } else {
+      ++dropped_records_;
+    }
+  }
+  for (auto& record : merged) {
+    if (!archived_.count(SeriesKey(record))) {
+      families.push_back(std::move(record));
+    }
+  }
+  return detail::BuildFamilies(families);
+}
+
+std::size_t MultiProcessCollector::DroppedRecords() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return dropped_records_;
+}
+}
@@ -0,0 +1,237 @@
+#include "prometheus/process_collector.h"
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "prometheus/counter.h"
+#include "prometheus/gauge.h"
+
+namespace prometheus {
+
+namespace {
+
+// Reads the whole file at `fd` into `buffer` and null-terminates it.
+// Returns the number of bytes read, or -1.
+ssize_t ReadFile(int fd, char* buffer, std::size_t size) {
+  if (fd < 0) {
+    return -1;
+  }
+  std::size_t length = 0;
+  while (length < size - 1) {
+    auto bytes = pread(fd, buffer + length, size - 1 - length, length);
+    if (bytes < 0) {
+      return -1;
+    }
+    if (bytes == 0) {
+      break;
+    }
+    length += static_cast<std::size_t>(bytes);
+  }
+  buffer[length] = '\0';
+  return static_cast<ssize_t>(length);
+}
+
+const char* SkipFields(const char* p, int fields) {
+  for (; fields > 0 && *p; --fields) {
+    while (*p && *p != ' ') ++p;
+    while (*p == ' ') ++p;
+  }
+  return p;
+}
+
+unsigned long long ParseUnsigned(const char* p) {
+  unsigned long long value = 0;
+  for (; *p >= '0' && *p <= '9'; ++p) {
+    value = value * 10 + (*p - '0');
+  }
+  return value;
+}
+
+double BootTimeSeconds() {
+  std::ifstream stat{"/proc/stat"};
+  std::string key;
+  while (stat >> key) {
+    if (key == "btime") {
+      double boot_time;
+      if (stat >> boot_time) {
+        return boot_time;
+      }
+      break;
+    }
+    stat.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return -1;
+}
+
+// Number of entries in the directory open at `fd`, without "." and "..".
+double CountDirectoryEntries(int fd) {
+#ifdef SYS_getdents64
+  if (fd < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+    return -1;
+  }
+  struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+  };
+  alignas(linux_dirent64) char buffer[4096];
+  double entries = 0;
+  for (;;) {
+    auto bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (bytes < 0) {
+      return -1;
+    }
+    if (bytes == 0) {
+      return entries;
+    }
+    for (long offset = 0; offset < bytes;) {
+      auto entry = reinterpret_cast<linux_dirent64*>(buffer + offset);
+      if (std::strcmp(entry->d_name, ".") != 0 &&
+          std::strcmp(entry->d_name, "..") != 0) {
+        ++entries;
+      }
+      offset += entry->d_reclen;
+    }
+  }
+#else
+  (void)fd;
+  return -1;
+#endif
+}
+
+void AddFamily(builders_t* builders, const char* name, const char* help,
+               io::prometheus::client::MetricType type, double value) {
+  if (value < 0) {
+    return;
+  }
+  auto bld = make_bld_t();
+  auto labels = label_pair_t{};
+  auto metric = type == io::prometheus::client::MetricType_COUNTER
+                    ? Counter::CollectValue(value, &labels, bld.get())
+                    : Gauge::CollectValue(value, &labels, bld.get());
+  auto metrics = bld->CreateVector(std::vector<metric_collect_t>{metric});
+  auto family = io::prometheus::client::CreateMetricFamily(
+      *bld, bld->CreateString(name), bld->CreateString(help), type, metrics);
+  bld->Finish(family);
+  builders->push_back(bld);
+}
+}  // namespace
+
+ProcessCollector::ProcessCollector(
+    std::chrono::steady_clock::duration min_interval)
+    : min_interval_(min_interval),
+      page_size_(sysconf(_SC_PAGESIZE)),
+      ticks_per_second_(sysconf(_SC_CLK_TCK)) {
+  Open();
+}
+
+ProcessCollector::~ProcessCollector() { Close(); }
+
+void ProcessCollector::Open() {
+  pid_ = getpid();
+  auto path = "/proc/" + std::to_string(pid_);
+  stat_fd_ = open((path + "/stat").c_str(), O_RDONLY | O_CLOEXEC);
+  statm_fd_ = open((path + "/statm").c_str(), O_RDONLY | O_CLOEXEC);
+  fd_dir_fd_ =
+      open((path + "/fd").c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  // the start time never changes, so it is computed once per process
+  start_time_seconds_ = -1;
+  char buffer[1024];
+  auto boot_time = BootTimeSeconds();
+  if (boot_time >= 0 && ReadFile(stat_fd_, buffer, sizeof(buffer)) > 0) {
+    auto fields = std::strrchr(buffer, ')');
+    if (fields) {
+      // fields after the command name start with the state, field 3
+      auto start_ticks = ParseUnsigned(SkipFields(fields + 2, 22 - 3));
+      start_time_seconds_ = boot_time + start_ticks / ticks_per_second_;
+    }
+  }
+}
+
+void ProcessCollector::Close() {
+  for (auto fd : {stat_fd_, statm_fd_, fd_dir_fd_}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+void ProcessCollector::Read() {
+  values_ = Values{};
+  char buffer[1024];
+
+  if (ReadFile(stat_fd_, buffer, sizeof(buffer)) > 0) {
+    auto fields = std::strrchr(buffer, ')');
+    if (fields) {
+      auto utime = SkipFields(fields + 2, 14 - 3);
+      auto stime = SkipFields(utime, 1);
+      values_.cpu_seconds =
+          (ParseUnsigned(utime) + ParseUnsigned(stime)) / ticks_per_second_;
+    }
+  }
+
+  if (ReadFile(statm_fd_, buffer, sizeof(buffer)) > 0) {
+    values_.virtual_memory_bytes = ParseUnsigned(buffer) * page_size_;
+    values_.resident_memory_bytes =
+        ParseUnsigned(SkipFields(buffer, 1)) * page_size_;
+  }
+
+  values_.open_fds = CountDirectoryEntries(fd_dir_fd_);
+
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY) {
+    values_.max_fds = limit.rlim_cur;
+  }
+}
+
+builders_t ProcessCollector::Collect() {
+  using io::prometheus::client::MetricType_COUNTER;
+  using io::prometheus::client::MetricType_GAUGE;
+
+  auto builders = builders_t{};
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (getpid() != pid_) {
+    // a forked child; the values read so far belong to the parent
+    Close();
+    Open();
+    read_once_ = false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (!read_once_ || now - last_read_ >= min_interval_) {
+    Read();
+    read_once_ = true;
+    last_read_ = now;
+  }
+
+  AddFamily(&builders, "process_cpu_seconds_total",
+            "Total user and system CPU time spent in seconds",
+            MetricType_COUNTER, values_.cpu_seconds);
+  AddFamily(&builders, "process_resident_memory_bytes",
+            "Resident memory size in bytes", MetricType_GAUGE,
+            values_.resident_memory_bytes);
+  AddFamily(&builders, "process_virtual_memory_bytes",
+            "Virtual memory size in bytes", MetricType_GAUGE,
+            values_.virtual_memory_bytes);
+  AddFamily(&builders, "process_open_fds", "Number of open file descriptors",
+            MetricType_GAUGE, values_.open_fds);
+  AddFamily(&builders, "process_max_fds",
+            "Maximum number of open file descriptors", MetricType_GAUGE,
+            values_.max_fds);
+  AddFamily(&builders, "process_start_time_seconds",
+            "Start time of the process since unix epoch in seconds",
+            MetricType_GAUGE, start_time_seconds_);
+  return builders;
+}
+}
@@ -1,7 +1,35 @@
 #include "prometheus/registry.h"
 #include "prometheus/exposer.h"
 
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
 namespace prometheus {
+Registry::NameIndex::NameIndex(std::size_t capacity)
+    : slots(new std::atomic<const IndexEntry*>[capacity]),
+      capacity(capacity) {
+  for (std::size_t i = 0; i < capacity; ++i) {
+    slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+namespace {
+std::string NextRegistryId() {
+  static std::atomic<std::size_t> next_id{0};
+  return std::to_string(next_id.fetch_add(1));
+}
+}
+
+Registry::Registry() : id_(NextRegistryId()) {
+  snapshots_.emplace_back(new Snapshot(16));
+  snapshot_.store(snapshots_.back().get());
+  indexes_.emplace_back(new NameIndex(32));
+  index_.store(indexes_.back().get());
+}
+
 std::shared_ptr<Registry> Registry::Create(Exposer& exposer) {
   std::shared_ptr<Registry> reg = std::make_shared<Registry>();
   exposer.RegisterCollectable(reg);
@@ -11,35 +39,98 @@ std::shared_ptr<Registry> Registry::Create(Exposer& exposer) {
 Family<Counter>& Registry::AddCounter(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels) {
-  std::lock_guard<std::mutex> lock{mutex_};
-  auto counter_family = new Family<Counter>(name, help, labels);
-  collectables_.push_back(std::unique_ptr<Collectable>{counter_family});
-  return *counter_family;
+  return Add<Family<Counter>>(name, help, labels);
 }
 
 Family<Gauge>& Registry::AddGauge(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels) {
-  std::lock_guard<std::mutex> lock{mutex_};
-  auto gauge_family = new Family<Gauge>(name, help, labels);
-  collectables_.push_back(std::unique_ptr<Collectable>{gauge_family});
-  return *gauge_family;
+  return Add<Family<Gauge>>(name, help, labels);
 }
 
 Family<Histogram>& Registry::AddHistogram(
     const std::string& name, const std::string& help,
     const std::map<std::string, std::string>& labels) {
-  std::lock_guard<std::mutex> lock{mutex_};
-  auto histogram_family = new Family<Histogram>(name, help, labels);
-  collectables_.push_back(std::unique_ptr<Collectable>{histogram_family});
-  return *histogram_family;
+  return Add<Family<Histogram>>(name, help, labels);
+}
+
+void Registry::Publish(Collectable* collectable) {
+  auto snapshot = snapshot_.load(std::memory_order_relaxed);
+  auto size = snapshot->size.load(std::memory_order_relaxed);
+  if (size == snapshot->capacity) {
+    auto grown = new Snapshot(2 * snapshot->capacity);
+    snapshots_.emplace_back(grown);
+    std::copy(snapshot->items.get(), snapshot->items.get() + size,
+              grown->items.get());
+    grown->size.store(size, std::memory_order_relaxed);
+    snapshot_.store(grown, std::memory_order_release);
+    snapshot = grown;
+  }
+  snapshot->items[size] = collectable;
+  snapshot->size.store(size + 1, std::memory_order_release);
+}
+
+const Registry::IndexEntry* Registry::Find(const std::string& name) const {
+  auto index = index_.load(std::memory_order_acquire);
+  auto mask = index->capacity - 1;
+  for (auto i = std::hash<std::string>{}(name) & mask;; i = (i + 1) & mask) {
+    auto entry = index->slots[i].load(std::memory_order_acquire);
+    if (!entry || entry->name == name) {
+      return entry;
+    }
+  }
+}
+
+const Registry::IndexEntry* Registry::AddToIndex(
+    const std::string& name, const std::type_info& type,
+    const std::map<std::string, std::string>& constant_labels,
+    Collectable* collectable) {
+  auto insert = [](NameIndex& index, const IndexEntry* entry) {
+    auto mask = index.capacity - 1;
+    auto i = std::hash<std::string>{}(entry->name) & mask;
+    while (index.slots[i].load(std::memory_order_relaxed)) {
+      i = (i + 1) & mask;
+    }
+    index.slots[i].store(entry, std::memory_order_release);
+  };
+
+  auto index = index_.load(std::memory_order_relaxed);
+  if (2 * (index_entries_.size() + 1) > index->capacity) {
+    auto grown = new NameIndex(2 * index->capacity);
+    indexes_.emplace_back(grown);
+    for (auto& entry : index_entries_) {
+      insert(*grown, entry.get());
+    }
+    index_.store(grown, std::memory_order_release);
+    index = grown;
+  }
+
+  auto entry = new IndexEntry{name, &type, constant_labels, collectable};
+  index_entries_.push_back(std::unique_ptr<IndexEntry>{entry});
+  insert(*index, entry);
+  return entry;
+}
+
+void Registry::CheckCompatible(
+    const IndexEntry& entry, const std::type_info& type,
+    const std::map<std::string, std::string>& constant_labels) {
+  if (*entry.type != type) {
+    throw std::invalid_argument("family " + entry.name +
+                                " is already registered with another type");
+  }
+  if (entry.constant_labels != constant_labels) {
+    throw std::invalid_argument(
+        "family " + entry.name +
+        " is already registered with other constant labels");
+  }
 }
 
 builders_t Registry::Collect() {
-  std::lock_guard<std::mutex> lock{mutex_};
+  auto snapshot = snapshot_.load(std::memory_order_acquire);
+  auto size = snapshot->size.load(std::memory_order_acquire);
   auto results = builders_t{};
-  for (auto&& collectable : collectables_) {
-    auto metrics = collectable->Collect();
+  for (std::size_t i = 0; i < size; ++i) {
+    auto metrics = snapshot->items[i]->Collect();
     results.insert(results.end(), metrics.begin(), metrics.end());
   }
 
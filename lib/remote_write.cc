@@ -0,0 +1,279 @@
+#include "prometheus/remote_write.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <utility>
+
+#include "http_client.h"
+#include "remote_write_encoder.h"
+#include "snappy.h"
+
+namespace prometheus {
+
+// Sends the batches of one part of the series in order on its own thread.
+class RemoteWriteExporter::Shard {
+ public:
+  Shard(const std::string& url, const RemoteWriteOptions& options)
+      : url_(url), options_(options), sender_(&Shard::Run, this) {}
+
+  ~Shard() {
+    Stop(std::chrono::steady_clock::now() + options_.shutdown_timeout);
+    sender_.join();
+  }
+
+  // Lets the sender send what is queued until `deadline` and drop the rest.
+  // The earliest deadline wins.
+  void Stop(std::chrono::steady_clock::time_point deadline) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (!stopping_ || deadline < deadline_) {
+        deadline_ = deadline;
+      }
+      stopping_ = true;
+    }
+    // also cuts a running backoff short
+    wakeup_.notify_one();
+  }
+
+  void Enqueue(std::vector<detail::TimeSeries> batch) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (queue_.size() >= options_.max_pending_batches) {
+        ++dropped_batches_;
+        return;
+      }
+      queue_.push_back(std::move(batch));
+    }
+    wakeup_.notify_one();
+  }
+
+  void Flush() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    drained_.wait(lock, [this] { return queue_.empty() && !sending_; });
+  }
+
+  std::size_t FailedBatches() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return failed_batches_;
+  }
+
+  std::size_t DroppedBatches() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return dropped_batches_;
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+      wakeup_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      if (stopping_ && std::chrono::steady_clock::now() >= deadline_) {
+        dropped_batches_ += queue_.size();
+        queue_.clear();
+        drained_.notify_all();
+        return;
+      }
+      auto batch = std::move(queue_.front());
+      queue_.pop_front();
+      sending_ = true;
+
+      lock.unlock();
+      auto sent = Send(batch);
+      lock.lock();
+
+      sending_ = false;
+      if (!sent) {
+        ++failed_batches_;
+      }
+      if (queue_.empty()) {
+        drained_.notify_all();
+      }
+    }
+  }
+
+  bool Send(const std::vector<detail::TimeSeries>& batch) {
+    // encoding and compression happen here so collecting stays cheap
+    auto body = detail::SnappyCompress(detail::EncodeWriteRequest(batch));
+    const auto headers = detail::http_headers_t{
+        {"Content-Encoding", "snappy"},
+        {"Content-Type", "application/x-protobuf"},
+        {"X-Prometheus-Remote-Write-Version", "0.1.0"}};
+
+    auto backoff = options_.initial_backoff;
+    for (auto attempt = 0;; ++attempt) {
+      auto timeout = std::chrono::milliseconds{};
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        timeout = RequestTimeout();
+      }
+      if (timeout == std::chrono::milliseconds::zero()) {
+        return false;
+      }
+      auto status = detail::HttpRequest("POST", url_, headers, body, timeout);
+      if (status >= 200 && status < 300) {
+        return true;
+      }
+      // client errors other than throttling will not go away by retrying
+      auto retryable = status < 0 || status == 429 || status >= 500;
+      if (!retryable || attempt >= options_.max_retries) {
+        return false;
+      }
+      {
+        // Stop() wakes the sender up, the backoff then ends at the shutdown
+        // deadline at the latest
+        auto resume = std::chrono::steady_clock::now() + backoff;
+        std::unique_lock<std::mutex> lock{mutex_};
+        auto until = [this, resume] {
+          return stopping_ ? std::min(resume, deadline_) : resume;
+        };
+        while (std::chrono::steady_clock::now() < until()) {
+          wakeup_.wait_until(lock, until());
+        }
+      }
+      backoff = std::min(2 * backoff, options_.max_backoff);
+    }
+  }
+
+  // Time limit of the next request, cut to what is left until the shutdown
+  // deadline; runs with mutex_ held.
+  std::chrono::milliseconds RequestTimeout() const {
+    if (!stopping_) {
+      return options_.timeout;
+    }
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline_ - std::chrono::steady_clock::now());
+    return std::max(std::chrono::milliseconds::zero(),
+                    std::min(options_.timeout, left));
+  }
+
+  const std::string url_;
+  const RemoteWriteOptions& options_;
+
+  std::deque<std::vector<detail::TimeSeries>> queue_;
+  bool sending_ = false;
+  bool stopping_ = false;
+  std::chrono::steady_clock::time_point deadline_;
+  std::size_t failed_batches_ = 0;
+  std::size_t dropped_batches_ = 0;
+  mutable std::mutex mutex_;
+  std::condition_variable wakeup_;
+  std::condition_variable drained_;
+  std::thread sender_;
+};
+
+RemoteWriteExporter::RemoteWriteExporter(const std::string& url,
+                                         const RemoteWriteOptions& options)
+    : options_(options) {
+  auto shards = std::max<std::size_t>(options_.shards, 1);
+  for (std::size_t i = 0; i < shards; ++i) {
+    shards_.emplace_back(new Shard{url, options_});
+  }
+  if (options_.interval.count() > 0) {
+    collector_ = std::thread{&RemoteWriteExporter::Run, this};
+  }
+}
+
+RemoteWriteExporter::~RemoteWriteExporter() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  wakeup_.notify_one();
+  if (collector_.joinable()) {
+    collector_.join();
+  }
+  CollectNow();
+  // all shards share one deadline, so they drain in parallel
+  auto deadline = std::chrono::steady_clock::now() + options_.shutdown_timeout;
+  for (auto& shard : shards_) {
+    shard->Stop(deadline);
+  }
+  shards_.clear();
+}
+
+void RemoteWriteExporter::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  collectables_.push_back(collectable);
+}
+
+void RemoteWriteExporter::CollectNow() {
+  auto collectables = std::vector<std::weak_ptr<Collectable>>{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    collectables = collectables_;
+  }
+
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  auto series = std::vector<detail::TimeSeries>{};
+  for (auto& weak : collectables) {
+    if (auto collectable = weak.lock()) {
+      detail::AppendTimeSeries(collectable->Collect(), now, &series);
+    }
+  }
+
+  // a series always goes to the same shard, so its samples stay in order
+  auto batches =
+      std::vector<std::vector<detail::TimeSeries>>(shards_.size());
+  auto max_samples = std::max<std::size_t>(options_.max_samples_per_send, 1);
+  for (auto& sample : series) {
+    auto hash = std::size_t{0};
+    for (const auto& label : sample.labels) {
+      hash = hash * 31 + std::hash<std::string>{}(label.first);
+      hash = hash * 31 + std::hash<std::string>{}(label.second);
+    }
+    auto index = hash % shards_.size();
+    batches[index].push_back(std::move(sample));
+    if (batches[index].size() == max_samples) {
+      shards_[index]->Enqueue(std::move(batches[index]));
+      batches[index].clear();
+    }
+  }
+  for (std::size_t i = 0; i < shards_.size(); ++i) {
+    if (!batches[i].empty()) {
+      shards_[i]->Enqueue(std::move(batches[i]));
+    }
+  }
+}
+
+void RemoteWriteExporter::Flush() {
+  for (auto& shard : shards_) {
+    shard->Flush();
+  }
+}
+
+std::size_t RemoteWriteExporter::FailedBatches() const {
+  auto failed = std::size_t{0};
+  for (auto& shard : shards_) {
+    failed += shard->FailedBatches();
+  }
+  return failed;
+}
+
+std::size_t RemoteWriteExporter::DroppedBatches() const {
+  auto dropped = std::size_t{0};
+  for (auto& shard : shards_) {
+    dropped += shard->DroppedBatches();
+  }
+  return dropped;
+}
+
+void RemoteWriteExporter::Run() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (!stopping_) {
+    if (wakeup_.wait_for(lock, options_.interval,
+                         [this] { return stopping_; })) {
+      return;
+    }
+    lock.unlock();
+    CollectNow();
+    lock.lock();
+  }
+}
+}
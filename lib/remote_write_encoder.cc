@@ -0,0 +1,211 @@
+#include "remote_write_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+using io::prometheus::client::MetricFamily;
+using MetricMessage = io::prometheus::client::Metric;
+
+// Label values such as le are formatted like Go's strconv.FormatFloat with
+// the shortest representation, so they match what a scrape would produce.
+std::string FormatDouble(double value) {
+  if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  char buffer[32];
+  for (auto precision = 1; precision <= 17; ++precision) {
+    std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+    if (std::strtod(buffer, nullptr) == value) {
+      break;
+    }
+  }
+  return buffer;
+}
+
+class SeriesBuilder {
+ public:
+  SeriesBuilder(const MetricFamily* family, const MetricMessage* metric,
+                std::int64_t timestamp_ms, std::vector<TimeSeries>* series)
+      : family_(family),
+        metric_(metric),
+        timestamp_ms_(timestamp_ms),
+        series_(series) {}
+
+  void Add(const char* suffix, double value, const char* extra_name = nullptr,
+           const std::string& extra_value = "") {
+    auto sample = TimeSeries{};
+    sample.labels.emplace_back("__name__", family_->name()->str() + suffix);
+    if (auto labels = metric_->label()) {
+      for (unsigned int i = 0; i < labels->size(); ++i) {
+        sample.labels.emplace_back(labels->Get(i)->name()->str(),
+                                   labels->Get(i)->value()->str());
+      }
+    }
+    if (extra_name) {
+      sample.labels.emplace_back(extra_name, extra_value);
+    }
+    std::sort(sample.labels.begin(), sample.labels.end());
+    sample.value = value;
+    sample.timestamp_ms =
+        metric_->timestamp_ms() != 0 ? metric_->timestamp_ms() : timestamp_ms_;
+    series_->push_back(std::move(sample));
+  }
+
+ private:
+  const MetricFamily* family_;
+  const MetricMessage* metric_;
+  const std::int64_t timestamp_ms_;
+  std::vector<TimeSeries>* series_;
+};
+
+void AppendMetric(const MetricFamily* family, const MetricMessage* metric,
+                  std::int64_t timestamp_ms, std::vector<TimeSeries>* series) {
+  SeriesBuilder builder{family, metric, timestamp_ms, series};
+  switch (family->type()) {
+    case io::prometheus::client::MetricType_COUNTER:
+      builder.Add("", metric->counter()->value());
+      break;
+    case io::prometheus::client::MetricType_GAUGE:
+      builder.Add("", metric->gauge()->value());
+      break;
+    case io::prometheus::client::MetricType_UNTYPED:
+      builder.Add("", metric->untyped()->value());
+      break;
+    case io::prometheus::client::MetricType_SUMMARY: {
+      auto summary = metric->summary();
+      builder.Add("_count", summary->sample_count());
+      builder.Add("_sum", summary->sample_sum());
+      auto quantiles = summary->quantile();
+      for (unsigned int i = 0; quantiles && i < quantiles->size(); ++i) {
+        builder.Add("", quantiles->Get(i)->value(), "quantile",
+                    FormatDouble(quantiles->Get(i)->quantile()));
+      }
+      break;
+    }
+    case io::prometheus::client::MetricType_HISTOGRAM: {
+      auto histogram = metric->histogram();
+      builder.Add("_count", histogram->sample_count());
+      builder.Add("_sum", histogram->sample_sum());
+      auto buckets = histogram->bucket();
+      auto last = -std::numeric_limits<double>::infinity();
+      for (unsigned int i = 0; buckets && i < buckets->size(); ++i) {
+        last = buckets->Get(i)->upper_bound();
+        builder.Add("_bucket", buckets->Get(i)->cumulative_count(), "le",
+                    FormatDouble(last));
+      }
+      if (last != std::numeric_limits<double>::infinity()) {
+        builder.Add("_bucket", histogram->sample_count(), "le", "+Inf");
+      }
+      break;
+    }
+  }
+}
+
+std::size_t VarintSize(std::uint64_t value) {
+  std::size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+void AppendVarint(std::uint64_t value, std::string* output) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output->push_back(static_cast<char>(value));
+}
+
+// Size of a length-delimited field with a one byte tag.
+std::size_t FieldSize(std::size_t length) {
+  return 1 + VarintSize(length) + length;
+}
+
+void AppendField(int field, const std::string& value, std::string* output) {
+  output->push_back(static_cast<char>((field << 3) | 2));
+  AppendVarint(value.size(), output);
+  output->append(value);
+}
+
+std::size_t LabelSize(const std::pair<std::string, std::string>& label) {
+  return FieldSize(label.first.size()) + FieldSize(label.second.size());
+}
+
+std::size_t SampleSize(const TimeSeries& series) {
+  return 9 + 1 + VarintSize(static_cast<std::uint64_t>(series.timestamp_ms));
+}
+
+std::size_t TimeSeriesSize(const TimeSeries& series) {
+  std::size_t size = FieldSize(SampleSize(series));
+  for (const auto& label : series.labels) {
+    size += FieldSize(LabelSize(label));
+  }
+  return size;
+}
+}  // namespace
+
+void AppendTimeSeries(const builders_t& collected, std::int64_t timestamp_ms,
+                      std::vector<TimeSeries>* series) {
+  for (const auto& bld : collected) {
+    auto family =
+        io::prometheus::client::GetMetricFamily(bld->GetBufferPointer());
+    auto metrics = family->metric();
+    for (unsigned int i = 0; metrics && i < metrics->size(); ++i) {
+      AppendMetric(family, metrics->Get(i), timestamp_ms, series);
+    }
+  }
+}
+
+// message WriteRequest { repeated TimeSeries timeseries = 1; }
+// message TimeSeries {
+//   repeated Label labels = 1;
+//   repeated Sample samples = 2;
+// }
+// message Label { string name = 1; string value = 2; }
+// message Sample { double value = 1; int64 timestamp = 2; }
+std::string EncodeWriteRequest(const std::vector<TimeSeries>& series) {
+  std::size_t total = 0;
+  for (const auto& entry : series) {
+    total += FieldSize(TimeSeriesSize(entry));
+  }
+
+  std::string output;
+  output.reserve(total);
+  for (const auto& entry : series) {
+    output.push_back((1 << 3) | 2);
+    AppendVarint(TimeSeriesSize(entry), &output);
+
+    for (const auto& label : entry.labels) {
+      output.push_back((1 << 3) | 2);
+      AppendVarint(LabelSize(label), &output);
+      AppendField(1, label.first, &output);
+      AppendField(2, label.second, &output);
+    }
+
+    output.push_back((2 << 3) | 2);
+    AppendVarint(SampleSize(entry), &output);
+    output.push_back((1 << 3) | 1);
+    char value[sizeof(double)];
+    std::memcpy(value, &entry.value, sizeof(value));
+    // protobuf fixed64 fields are little endian, like the hosts we support
+    output.append(value, sizeof(value));
+    output.push_back((2 << 3) | 0);
+    AppendVarint(static_cast<std::uint64_t>(entry.timestamp_ms), &output);
+  }
+  return output;
+}
+}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/metric.h"
+
+namespace prometheus {
+namespace detail {
+
+// One sample of the remote-write protocol. Labels are sorted by name and
+// include __name__.
+struct TimeSeries {
+  label_pair_t labels;
+  double value;
+  std::int64_t timestamp_ms;
+};
+
+// Flattens collected families into time series the way the text format
+// does, e.g. a histogram into its _count, _sum and _bucket series.
+void AppendTimeSeries(const builders_t& collected, std::int64_t timestamp_ms,
+                      std::vector<TimeSeries>* series);
+
+// Encodes the prometheus.WriteRequest protobuf message for `series`
+// directly, without protobuf message objects.
+std::string EncodeWriteRequest(const std::vector<TimeSeries>& series);
+}
+}
@@ -0,0 +1,46 @@
+#include <cmath>
+
+#include "prometheus/sampling_marker.h"
+
+namespace prometheus {
+
+AdaptiveSampler::AdaptiveSampler(double observations_per_second)
+    : observations_per_second_(
+          observations_per_second > 0 ? observations_per_second : 1),
+      threshold_(detail::SamplingThreshold(1)),
+      sampled_in_window_(0),
+      window_start_(
+          std::chrono::steady_clock::now().time_since_epoch().count()) {}
+
+void AdaptiveSampler::Sampled(std::chrono::steady_clock::time_point now) {
+  sampled_in_window_.fetch_add(1, std::memory_order_relaxed);
+
+  const auto window = std::chrono::steady_clock::duration{
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::seconds(1))};
+  auto start = window_start_.load(std::memory_order_relaxed);
+  auto elapsed = std::chrono::steady_clock::duration{
+      now.time_since_epoch().count() - start};
+  if (elapsed < window) {
+    return;
+  }
+  // only one thread gets to close the window and recompute the rate
+  if (!window_start_.compare_exchange_strong(
+          start, now.time_since_epoch().count(), std::memory_order_relaxed)) {
+    return;
+  }
+
+  auto sampled = sampled_in_window_.exchange(0, std::memory_order_relaxed);
+  auto seconds = std::chrono::duration<double>(elapsed).count();
+  auto calls_per_second = static_cast<double>(sampled) * Rate() / seconds;
+  auto rate = std::ceil(calls_per_second / observations_per_second_);
+  threshold_.store(detail::SamplingThreshold(
+                       rate < 1 ? 1 : static_cast<std::uint64_t>(rate)),
+                   std::memory_order_relaxed);
+}
+
+std::uint64_t AdaptiveSampler::Rate() const {
+  return std::numeric_limits<std::uint64_t>::max() /
+         threshold_.load(std::memory_order_relaxed);
+}
+}
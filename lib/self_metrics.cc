@@ -0,0 +1,68 @@
+#include "self_metrics.h"
+
+namespace prometheus {
+namespace detail {
+namespace {
+
+Family<Counter>& EvictedFamily() {
+  static auto& family =
+      BuildCounter()
+          .Name("exposer_evicted_idle_series")
+          .Help("Number of series removed after exceeding their idle timeout")
+          .Register(*SelfMetricsRegistry());
+  return family;
+}
+
+Family<Gauge>& SeriesFamily() {
+  static auto& family =
+      BuildGauge()
+          .Name("exposer_family_series")
+          .Help("Number of series in families with a series limit")
+          .Register(*SelfMetricsRegistry());
+  return family;
+}
+
+Family<Counter>& OverflowFamily() {
+  static auto& family =
+      BuildCounter()
+          .Name("exposer_family_series_overflows")
+          .Help("Number of new label sets redirected to the overflow series")
+          .Register(*SelfMetricsRegistry());
+  return family;
+}
+}
+
+std::shared_ptr<Registry> SelfMetricsRegistry() {
+  // intentionally leaked, see IdleSweeper::Instance()
+  static auto registry =
+      new std::shared_ptr<Registry>{std::make_shared<Registry>()};
+  return *registry;
+}
+
+Counter& EvictedSeriesCounter(const std::string& registry,
+                              const std::string& family) {
+  return EvictedFamily().Add({{"family", family}, {"registry", registry}});
+}
+
+Gauge& FamilySeriesGauge(const std::string& registry,
+                         const std::string& family) {
+  return SeriesFamily().Add({{"family", family}, {"registry", registry}});
+}
+
+Counter& FamilyOverflowCounter(const std::string& registry,
+                               const std::string& family) {
+  return OverflowFamily().Add({{"family", family}, {"registry", registry}});
+}
+
+void RemoveEvictedSeriesCounter(const std::string& registry,
+                                const std::string& family) {
+  EvictedFamily().Remove(&EvictedSeriesCounter(registry, family));
+}
+
+void RemoveFamilySeriesLimit(const std::string& registry,
+                             const std::string& family) {
+  SeriesFamily().Remove(&FamilySeriesGauge(registry, family));
+  OverflowFamily().Remove(&FamilyOverflowCounter(registry, family));
+}
+}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "prometheus/counter.h"
+#include "prometheus/gauge.h"
+#include "prometheus/registry.h"
+
+namespace prometheus {
+namespace detail {
+
+// Registry for the library's own bookkeeping metrics. Every Exposer serves
+// it next to its request metrics.
+std::shared_ptr<Registry> SelfMetricsRegistry();
+
+// Series of a family are labeled with its name and the Id() of its
+// registry, so same-named families of different registries stay apart.
+Counter& EvictedSeriesCounter(const std::string& registry,
+                              const std::string& family);
+Gauge& FamilySeriesGauge(const std::string& registry,
+                         const std::string& family);
+Counter& FamilyOverflowCounter(const std::string& registry,
+                               const std::string& family);
+
+// Remove the series of a family that is destroyed.
+void RemoveEvictedSeriesCounter(const std::string& registry,
+                                const std::string& family);
+void RemoveFamilySeriesLimit(const std::string& registry,
+                             const std::string& family);
+}
+}
@@ -0,0 +1,273 @@
+#include "prometheus/shared_memory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include "shared_memory_layout.h"
+
+namespace prometheus {
+
+namespace {
+
+std::runtime_error SystemError(const std::string& what,
+                               const std::string& path) {
+  return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+}  // namespace
+
+SharedMemorySegment::SharedMemorySegment(const std::string& path,
+                                         std::size_t size, SegmentMode mode)
+    : size_(std::max(size, sizeof(detail::SegmentHeader))) {
+  if (mode == SegmentMode::kRestore && Restore(path)) {
+    return;
+  }
+  Create(path);
+}
+
+void SharedMemorySegment::Create(const std::string& path) {
+  // build the segment next to `path` and rename it into place, so readers
+  // never map a file that is still being set up or truncated under them
+  auto temporary = path + ".tmp." + std::to_string(getpid());
+  auto fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 0644);
+  if (fd < 0) {
+    throw SystemError("cannot create", temporary);
+  }
+  if (ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+    auto error = SystemError("cannot resize", temporary);
+    close(fd);
+    unlink(temporary.c_str());
+    throw error;
+  }
+  auto mapping =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    auto error = SystemError("cannot map", temporary);
+    unlink(temporary.c_str());
+    throw error;
+  }
+  base_ = static_cast<unsigned char*>(mapping);
+
+  auto header = new (base_) detail::SegmentHeader{};
+  std::memcpy(header->magic, detail::kSegmentMagic, sizeof(header->magic));
+  header->version = detail::kSegmentVersion;
+  header->size = size_;
+  header->pid = getpid();
+  header->used.store(sizeof(detail::SegmentHeader), std::memory_order_release);
+
+  if (rename(temporary.c_str(), path.c_str()) != 0) {
+    auto error = SystemError("cannot rename to", path);
+    munmap(base_, size_);
+    unlink(temporary.c_str());
+    throw error;
+  }
+}
+
+bool SharedMemorySegment::Restore(const std::string& path) {
+  auto fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      status.st_size < static_cast<off_t>(sizeof(detail::SegmentHeader))) {
+    close(fd);
+    return false;
+  }
+  auto old_size = static_cast<std::size_t>(status.st_size);
+  auto mapping =
+      mmap(nullptr, old_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  auto valid =
+      detail::IsValidSegment(static_cast<unsigned char*>(mapping), old_size);
+  munmap(mapping, old_size);
+  // a file that is no segment is replaced like with SegmentMode::kCreate
+  if (!valid) {
+    close(fd);
+    return false;
+  }
+
+  size_ = std::max(size_, old_size);
+  if (size_ > old_size && ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+    size_ = old_size;
+  }
+  mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw SystemError("cannot map", path);
+  }
+  base_ = static_cast<unsigned char*>(mapping);
+  auto header = reinterpret_cast<detail::SegmentHeader*>(base_);
+  header->size = size_;
+  header->pid = getpid();
+
+  // one pass over the records, which are hashed and compared in place;
+  // values stay where they are
+  detail::ForEachRecordOffset(base_, size_, [this](std::size_t offset) {
+    auto record = reinterpret_cast<detail::RecordHeader*>(base_ + offset);
+    auto hash = detail::SeriesHash(record);
+    auto range = restored_.equal_range(hash);
+    for (auto restored_iter = range.first; restored_iter != range.second;
+         ++restored_iter) {
+      auto other = reinterpret_cast<const detail::RecordHeader*>(
+          base_ + restored_iter->second);
+      if (detail::SameSeries(record, other)) {
+        record->state.store(detail::kRecordRemoved, std::memory_order_release);
+        return;
+      }
+    }
+    restored_.insert({hash, offset});
+    if (record->type == io::prometheus::client::MetricType_GAUGE) {
+      detail::RecordValues(record)->store(0.0);
+    }
+  });
+  return true;
+}
+
+SharedMemorySegment::~SharedMemorySegment() { munmap(base_, size_); }
+
+detail::SharedSeries SharedMemorySegment::AddSeries(
+    io::prometheus::client::MetricType type, const std::string& name,
+    const std::string& help, const label_pair_t& labels,
+    std::size_t value_count, const std::vector<double>& bounds) {
+  auto size =
+      detail::RecordSize(name, help, labels, value_count, bounds.size());
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!restored_.empty()) {
+    auto range = restored_.equal_range(detail::SeriesHash(name, labels));
+    for (auto restored_iter = range.first; restored_iter != range.second;
+         ++restored_iter) {
+      auto offset = restored_iter->second;
+      auto record = reinterpret_cast<detail::RecordHeader*>(base_ + offset);
+      if (!detail::IsSeries(record, name, labels)) {
+        continue;
+      }
+      restored_.erase(restored_iter);
+      auto record_bounds = detail::RecordBounds(record);
+      if (record->type == static_cast<std::uint32_t>(type) &&
+          record->value_count == value_count &&
+          record->bound_count == bounds.size() &&
+          std::equal(bounds.begin(), bounds.end(), record_bounds)) {
+        return {detail::RecordValues(record), record_bounds, offset};
+      }
+      // the series changed its shape, it starts over in a new record
+      record->state.store(detail::kRecordRemoved, std::memory_order_release);
+      break;
+    }
+  }
+
+  auto header = reinterpret_cast<detail::SegmentHeader*>(base_);
+  auto used = header->used.load(std::memory_order_relaxed);
+  if (size > size_ - used) {
+    throw std::length_error("shared memory segment is full");
+  }
+  auto record = detail::WriteRecord(base_ + used, size, type, name, help,
+                                    labels, value_count, bounds);
+  header->used.store(used + size, std::memory_order_release);
+  return {detail::RecordValues(record), detail::RecordBounds(record), used};
+}
+
+void SharedMemorySegment::Checkpoint() {
+  auto header = reinterpret_cast<detail::SegmentHeader*>(base_);
+  msync(base_, header->used.load(std::memory_order_acquire), MS_SYNC);
+}
+
+std::size_t SharedMemorySegment::RetireRestored() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  for (const auto& restored : restored_) {
+    RemoveSeries(restored.second);
+  }
+  auto retired = restored_.size();
+  restored_.clear();
+  return retired;
+}
+
+void SharedMemorySegment::RemoveSeries(std::size_t offset) {
+  auto record = reinterpret_cast<detail::RecordHeader*>(base_ + offset);
+  record->state.store(detail::kRecordRemoved, std::memory_order_release);
+}
+
+builders_t SharedMemorySegment::Collect() {
+  auto records = std::vector<detail::RecordView>{};
+  detail::ForEachRecord(
+      base_, size_,
+      [&records](const detail::RecordView& record) {
+        records.push_back(record);
+      });
+  return detail::BuildFamilies(records);
+}
+
+SharedMemoryReader::SharedMemoryReader(const std::string& path)
+    : path_(path) {}
+
+SharedMemoryReader::~SharedMemoryReader() { Unmap(); }
+
+builders_t SharedMemoryReader::Collect() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  Remap();
+  auto records = std::vector<detail::RecordView>{};
+  if (base_) {
+    detail::ForEachRecord(
+        base_, size_,
+        [&records](const detail::RecordView& record) {
+          records.push_back(record);
+        });
+  }
+  return detail::BuildFamilies(records);
+}
+
+void SharedMemoryReader::Remap() {
+  struct stat status;
+  if (stat(path_.c_str(), &status) != 0) {
+    Unmap();
+    return;
+  }
+  if (base_ && status.st_dev == device_ && status.st_ino == inode_ &&
+      static_cast<std::size_t>(status.st_size) == size_) {
+    return;
+  }
+  Unmap();
+
+  auto fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  // the size is fixed when the segment is created, so the mapping covers
+  // every record the writer can ever append
+  if (fstat(fd, &status) != 0 ||
+      status.st_size < static_cast<off_t>(sizeof(detail::SegmentHeader))) {
+    close(fd);
+    return;
+  }
+  auto size = static_cast<std::size_t>(status.st_size);
+  auto mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return;
+  }
+  base_ = static_cast<const unsigned char*>(mapping);
+  size_ = size;
+  device_ = status.st_dev;
+  inode_ = status.st_ino;
+}
+
+void SharedMemoryReader::Unmap() {
+  if (base_) {
+    munmap(const_cast<unsigned char*>(base_), size_);
+    base_ = nullptr;
+    size_ = 0;
+  }
+}
+}
@@ -0,0 +1,392 @@
+#include "shared_memory_layout.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+#include "prometheus/counter.h"
+#include "prometheus/gauge.h"
+#include "prometheus/histogram.h"
+
+namespace prometheus {
+namespace detail {
+
+const char kSegmentMagic[8] = {'P', 'R', 'O', 'M', 'S', 'H', 'M', 0};
+
+namespace {
+
+std::size_t Pad(std::size_t size) { return (size + 7) / 8 * 8; }
+
+// Size of everything a record describes, without the padding.
+std::size_t PayloadSize(const RecordHeader& record) {
+  return sizeof(RecordHeader) +
+         sizeof(double) * (static_cast<std::size_t>(record.value_count) +
+                           record.bound_count) +
+         2 * sizeof(std::uint32_t) * record.label_count + record.name_size +
+         record.help_size;
+}
+
+bool ValidType(std::uint32_t type) {
+  using namespace io::prometheus::client;
+  return type == MetricType_COUNTER || type == MetricType_GAUGE ||
+         type == MetricType_HISTOGRAM;
+}
+
+// Histograms need a count per bucket and the sum, others one value.
+bool ValidShape(const RecordHeader& record) {
+  if (record.type == io::prometheus::client::MetricType_HISTOGRAM) {
+    return record.value_count == record.bound_count + 2;
+  }
+  return record.value_count == 1 && record.bound_count == 0;
+}
+
+// Start of the label sizes, which are followed by the name, the help and the
+// label bytes.
+const unsigned char* LabelSizes(const RecordHeader* record) {
+  return reinterpret_cast<const unsigned char*>(record) +
+         sizeof(RecordHeader) +
+         sizeof(double) * (static_cast<std::size_t>(record->value_count) +
+                           record->bound_count);
+}
+
+void LabelSize(const RecordHeader* record, std::size_t i,
+               std::uint32_t* sizes) {
+  std::memcpy(sizes, LabelSizes(record) + 2 * sizeof(std::uint32_t) * i,
+              2 * sizeof(std::uint32_t));
+}
+
+const char* RecordName(const RecordHeader* record) {
+  return reinterpret_cast<const char*>(
+      LabelSizes(record) + 2 * sizeof(std::uint32_t) * record->label_count);
+}
+
+// All label names and values, back to back.
+const char* RecordLabels(const RecordHeader* record) {
+  return RecordName(record) + record->name_size + record->help_size;
+}
+
+// Checks that the record at `offset` lies within `used` and that everything
+// it describes fits into it, so it can be read in place.
+bool ValidRecord(const unsigned char* base, std::size_t offset,
+                 std::size_t used) {
+  auto record = reinterpret_cast<const RecordHeader*>(base + offset);
+  if (used - offset < sizeof(RecordHeader) || record->size % 8 != 0 ||
+      record->size > used - offset || PayloadSize(*record) > record->size ||
+      !ValidType(record->type) || !ValidShape(*record)) {
+    return false;
+  }
+  auto size = PayloadSize(*record);
+  for (std::size_t i = 0; i < record->label_count; ++i) {
+    std::uint32_t sizes[2];
+    LabelSize(record, i, sizes);
+    size += static_cast<std::size_t>(sizes[0]) + sizes[1];
+  }
+  return size <= record->size;
+}
+
+std::uint64_t HashBytes(std::uint64_t hash, const char* data,
+                        std::size_t size) {
+  // FNV-1a over the bytes, followed by the length so that ("ab", "c") and
+  // ("a", "bc") differ
+  for (std::size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ULL;
+  }
+  return (hash ^ size) * 0x100000001b3ULL;
+}
+
+const std::uint64_t kHashBasis = 0xcbf29ce484222325ULL;
+}  // namespace
+
+std::string SeriesKey(const std::string& name, const label_pair_t& labels) {
+  auto key = name;
+  for (const auto& label : labels) {
+    key.push_back('\0');
+    key += label.first;
+    key.push_back('\0');
+    key += label.second;
+  }
+  return key;
+}
+
+std::size_t SeriesHash(const std::string& name, const label_pair_t& labels) {
+  auto hash = HashBytes(kHashBasis, name.data(), name.size());
+  for (const auto& label : labels) {
+    hash = HashBytes(hash, label.first.data(), label.first.size());
+    hash = HashBytes(hash, label.second.data(), label.second.size());
+  }
+  return static_cast<std::size_t>(hash);
+}
+
+std::size_t SeriesHash(const RecordHeader* record) {
+  auto hash = HashBytes(kHashBasis, RecordName(record), record->name_size);
+  auto bytes = RecordLabels(record);
+  for (std::size_t i = 0; i < record->label_count; ++i) {
+    std::uint32_t sizes[2];
+    LabelSize(record, i, sizes);
+    hash = HashBytes(hash, bytes, sizes[0]);
+    bytes += sizes[0];
+    hash = HashBytes(hash, bytes, sizes[1]);
+    bytes += sizes[1];
+  }
+  return static_cast<std::size_t>(hash);
+}
+
+bool IsSeries(const RecordHeader* record, const std::string& name,
+              const label_pair_t& labels) {
+  if (record->name_size != name.size() ||
+      record->label_count != labels.size() ||
+      std::memcmp(RecordName(record), name.data(), name.size()) != 0) {
+    return false;
+  }
+  auto bytes = RecordLabels(record);
+  for (std::size_t i = 0; i < labels.size(); ++i) {
+    std::uint32_t sizes[2];
+    LabelSize(record, i, sizes);
+    const auto& label = labels[i];
+    if (sizes[0] != label.first.size() || sizes[1] != label.second.size() ||
+        std::memcmp(bytes, label.first.data(), sizes[0]) != 0 ||
+        std::memcmp(bytes + sizes[0], label.second.data(), sizes[1]) != 0) {
+      return false;
+    }
+    bytes += sizes[0] + sizes[1];
+  }
+  return true;
+}
+
+bool SameSeries(const RecordHeader* a, const RecordHeader* b) {
+  if (a->name_size != b->name_size || a->label_count != b->label_count ||
+      std::memcmp(RecordName(a), RecordName(b), a->name_size) != 0 ||
+      std::memcmp(LabelSizes(a), LabelSizes(b),
+                  2 * sizeof(std::uint32_t) * a->label_count) != 0) {
+    return false;
+  }
+  // equal label sizes, so the label bytes have the same length
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < a->label_count; ++i) {
+    std::uint32_t sizes[2];
+    LabelSize(a, i, sizes);
+    size += static_cast<std::size_t>(sizes[0]) + sizes[1];
+  }
+  return std::memcmp(RecordLabels(a), RecordLabels(b), size) == 0;
+}
+
+std::size_t RecordSize(const std::string& name, const std::string& help,
+                       const label_pair_t& labels, std::size_t value_count,
+                       std::size_t bound_count) {
+  auto size = sizeof(RecordHeader) +
+              sizeof(double) * (value_count + bound_count) +
+              2 * sizeof(std::uint32_t) * labels.size() + name.size() +
+              help.size();
+  for (const auto& label : labels) {
+    size += label.first.size() + label.second.size();
+  }
+  return Pad(size);
+}
+
+RecordHeader* WriteRecord(unsigned char* at, std::size_t size,
+                          io::prometheus::client::MetricType type,
+                          const std::string& name, const std::string& help,
+                          const label_pair_t& labels, std::size_t value_count,
+                          const std::vector<double>& bounds) {
+  auto record = new (at) RecordHeader{};
+  record->type = type;
+  record->size = static_cast<std::uint32_t>(size);
+  record->value_count = static_cast<std::uint32_t>(value_count);
+  record->bound_count = static_cast<std::uint32_t>(bounds.size());
+  record->label_count = static_cast<std::uint32_t>(labels.size());
+  record->name_size = static_cast<std::uint32_t>(name.size());
+  record->help_size = static_cast<std::uint32_t>(help.size());
+
+  auto cursor = at + sizeof(RecordHeader);
+  for (std::size_t i = 0; i < value_count; ++i) {
+    new (cursor) std::atomic<double>(0.0);
+    cursor += sizeof(double);
+  }
+  std::memcpy(cursor, bounds.data(), sizeof(double) * bounds.size());
+  cursor += sizeof(double) * bounds.size();
+  for (const auto& label : labels) {
+    std::uint32_t sizes[2] = {static_cast<std::uint32_t>(label.first.size()),
+                              static_cast<std::uint32_t>(label.second.size())};
+    std::memcpy(cursor, sizes, sizeof(sizes));
+    cursor += sizeof(sizes);
+  }
+  std::memcpy(cursor, name.data(), name.size());
+  cursor += name.size();
+  std::memcpy(cursor, help.data(), help.size());
+  cursor += help.size();
+  for (const auto& label : labels) {
+    std::memcpy(cursor, label.first.data(), label.first.size());
+    cursor += label.first.size();
+    std::memcpy(cursor, label.second.data(), label.second.size());
+    cursor += label.second.size();
+  }
+
+  record->state.store(kRecordLive, std::memory_order_release);
+  return record;
+}
+
+std::atomic<double>* RecordValues(RecordHeader* record) {
+  return reinterpret_cast<std::atomic<double>*>(
+      reinterpret_cast<unsigned char*>(record) + sizeof(RecordHeader));
+}
+
+const double* RecordBounds(RecordHeader* record) {
+  return reinterpret_cast<const double*>(RecordValues(record) +
+                                         record->value_count);
+}
+
+bool IsValidSegment(const unsigned char* base, std::size_t size) {
+  if (size < sizeof(SegmentHeader)) {
+    return false;
+  }
+  auto header = reinterpret_cast<const SegmentHeader*>(base);
+  auto used = header->used.load(std::memory_order_acquire);
+  return std::memcmp(header->magic, kSegmentMagic, sizeof(kSegmentMagic)) ==
+             0 &&
+         header->version == kSegmentVersion && header->size == size &&
+         used >= sizeof(SegmentHeader) && used <= size;
+}
+
+void ForEachRecordOffset(const unsigned char* base, std::size_t size,
+                         const std::function<void(std::size_t)>& f) {
+  if (!IsValidSegment(base, size)) {
+    return;
+  }
+  auto header = reinterpret_cast<const SegmentHeader*>(base);
+  auto used = header->used.load(std::memory_order_acquire);
+
+  for (auto offset = std::size_t{sizeof(SegmentHeader)}; offset < used;) {
+    if (!ValidRecord(base, offset, used)) {
+      return;
+    }
+    auto record = reinterpret_cast<const RecordHeader*>(base + offset);
+    auto next = offset + record->size;
+    if (record->state.load(std::memory_order_acquire) == kRecordLive) {
+      f(offset);
+    }
+    offset = next;
+  }
+}
+
+void ForEachRecord(const unsigned char* base, std::size_t size,
+                   const std::function<void(const RecordView&)>& f) {
+  RecordView view;
+  ForEachRecordOffset(base, size, [base, &view, &f](std::size_t offset) {
+    auto record = reinterpret_cast<const RecordHeader*>(base + offset);
+    auto values = reinterpret_cast<const std::atomic<double>*>(
+        base + offset + sizeof(RecordHeader));
+    view.offset = offset;
+    view.type = static_cast<io::prometheus::client::MetricType>(record->type);
+    view.values.resize(record->value_count);
+    for (std::size_t i = 0; i < record->value_count; ++i) {
+      view.values[i] = values[i].load(std::memory_order_relaxed);
+    }
+    auto bounds = reinterpret_cast<const double*>(values + record->value_count);
+    view.bounds.assign(bounds, bounds + record->bound_count);
+
+    view.name.assign(RecordName(record), record->name_size);
+    view.help.assign(RecordName(record) + record->name_size,
+                     record->help_size);
+    auto bytes = RecordLabels(record);
+    view.labels.resize(record->label_count);
+    for (std::size_t i = 0; i < record->label_count; ++i) {
+      std::uint32_t sizes[2];
+      LabelSize(record, i, sizes);
+      view.labels[i].first.assign(bytes, sizes[0]);
+      bytes += sizes[0];
+      view.labels[i].second.assign(bytes, sizes[1]);
+      bytes += sizes[1];
+    }
+    f(view);
+  });
+}
+
+bool ReadSegmentFile(const std::string& path, std::int64_t* pid,
+                     std::vector<RecordView>* records) {
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      status.st_size < static_cast<off_t>(sizeof(SegmentHeader))) {
+    close(fd);
+    return false;
+  }
+  auto size = static_cast<std::size_t>(status.st_size);
+  auto mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  auto base = static_cast<const unsigned char*>(mapping);
+  auto valid = IsValidSegment(base, size);
+  if (valid) {
+    *pid = reinterpret_cast<const SegmentHeader*>(base)->pid;
+    ForEachRecord(base, size, [records](const RecordView& record) {
+      records->push_back(record);
+    });
+  }
+  munmap(mapping, size);
+  return valid;
+}
+
+builders_t BuildFamilies(const std::vector<RecordView>& records) {
+  using namespace io::prometheus::client;
+  auto groups = std::vector<std::vector<const RecordView*>>{};
+  auto index = std::unordered_map<std::string, std::size_t>{};
+  for (const auto& record : records) {
+    auto inserted = index.insert({record.name, groups.size()});
+    if (inserted.second) {
+      groups.emplace_back();
+    }
+    auto& group = groups[inserted.first->second];
+    if (group.empty() || group.front()->type == record.type) {
+      group.push_back(&record);
+    }
+  }
+
+  auto builders = builders_t{};
+  builders.reserve(groups.size());
+  for (const auto& group : groups) {
+    auto bld = make_bld_t();
+    auto metrics_vec = std::vector<metric_collect_t>{};
+    metrics_vec.reserve(group.size());
+    for (auto record : group) {
+      auto labels = record->labels;
+      switch (record->type) {
+        case MetricType_COUNTER:
+          metrics_vec.push_back(
+              Counter::CollectValue(record->values[0], &labels, bld.get()));
+          break;
+        case MetricType_GAUGE:
+          metrics_vec.push_back(
+              Gauge::CollectValue(record->values[0], &labels, bld.get()));
+          break;
+        default: {
+          auto counts = std::vector<double>(record->values.begin(),
+                                            record->values.end() - 1);
+          metrics_vec.push_back(Histogram::CollectValue(
+              record->bounds, counts, record->values.back(), &labels,
+              bld.get()));
+          break;
+        }
+      }
+    }
+    auto metrics = bld->CreateVector(metrics_vec);
+    auto family = CreateMetricFamily(
+        *bld, bld->CreateString(group.front()->name),
+        bld->CreateString(group.front()->help), group.front()->type, metrics);
+    bld->Finish(family);
+    builders.push_back(bld);
+  }
+  return builders;
+}
+}
+}
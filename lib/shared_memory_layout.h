@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/metric.h"
+
+namespace prometheus {
+namespace detail {
+
+// A segment file starts with a SegmentHeader followed by append-only
+// records, one per series. Everything up to `used` is published: the writer
+// fills a record completely before it advances `used` with release
+// semantics, so readers in other processes never see a partial record.
+// Values are std::atomic<double> updated in place by the instrumented
+// process.
+struct SegmentHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t size;
+  // process that created the segment
+  std::int64_t pid;
+  std::atomic<std::uint64_t> used;
+};
+
+// Record layout: RecordHeader, value_count values, bound_count histogram
+// bounds, label_count pairs of name and value sizes, then the bytes of the
+// name, the help and all label names and values. Records are padded to
+// 8 bytes. Histograms store one non-cumulative count per bucket including
+// +Inf, followed by the sum.
+struct RecordHeader {
+  std::atomic<std::uint32_t> state;
+  std::uint32_t type;
+  std::uint32_t size;
+  std::uint32_t value_count;
+  std::uint32_t bound_count;
+  std::uint32_t label_count;
+  std::uint32_t name_size;
+  std::uint32_t help_size;
+};
+
+enum RecordState : std::uint32_t { kRecordLive = 1, kRecordRemoved = 2 };
+
+static_assert(sizeof(std::atomic<double>) == sizeof(double),
+              "values must be plain doubles in the segment");
+static_assert(sizeof(SegmentHeader) % 8 == 0 && sizeof(RecordHeader) % 8 == 0,
+              "records must stay 8 byte aligned");
+
+extern const char kSegmentMagic[8];
+const std::uint32_t kSegmentVersion = 1;
+
+// Copy of one live record.
+struct RecordView {
+  io::prometheus::client::MetricType type;
+  std::string name;
+  std::string help;
+  label_pair_t labels;
+  std::vector<double> bounds;
+  std::vector<double> values;
+  // position of the record in the segment
+  std::size_t offset;
+};
+
+// Identifies a series by name and labels, e.g. across segments.
+std::string SeriesKey(const std::string& name, const label_pair_t& labels);
+
+// Hash of the name and labels of a series. The second overload reads them in
+// place from a record checked by ForEachRecordOffset(), without decoding it;
+// both agree for the same series.
+std::size_t SeriesHash(const std::string& name, const label_pair_t& labels);
+std::size_t SeriesHash(const RecordHeader* record);
+// Compare in place whether `record` holds the series of `name` and
+// `labels`, and whether `a` and `b` hold the same series.
+bool IsSeries(const RecordHeader* record, const std::string& name,
+              const label_pair_t& labels);
+bool SameSeries(const RecordHeader* a, const RecordHeader* b);
+
+std::size_t RecordSize(const std::string& name, const std::string& help,
+                       const label_pair_t& labels, std::size_t value_count,
+                       std::size_t bound_count);
+
+// Writes a live record at `at`, which must have RecordSize() zeroed bytes.
+RecordHeader* WriteRecord(unsigned char* at, std::size_t size,
+                          io::prometheus::client::MetricType type,
+                          const std::string& name, const std::string& help,
+                          const label_pair_t& labels, std::size_t value_count,
+                          const std::vector<double>& bounds);
+
+std::atomic<double>* RecordValues(RecordHeader* record);
+const double* RecordBounds(RecordHeader* record);
+
+// Checks the header of a mapped segment of `size` bytes.
+bool IsValidSegment(const unsigned char* base, std::size_t size);
+
+// Calls `f` with the offset of every live record of a valid segment. Stops
+// at the first record that is inconsistent, the file may have been written
+// by anything.
+void ForEachRecordOffset(const unsigned char* base, std::size_t size,
+                         const std::function<void(std::size_t)>& f);
+
+// Like ForEachRecordOffset(), but calls `f` with a copy of every record.
+void ForEachRecord(const unsigned char* base, std::size_t size,
+                   const std::function<void(const RecordView&)>& f);
+
+// Maps the segment file at `path` once and copies its live records into
+// `records`. Returns false if the file cannot be read or is no segment.
+bool ReadSegmentFile(const std::string& path, std::int64_t* pid,
+                     std::vector<RecordView>* records);
+
+// Groups records by name into one family each, in order of appearance.
+// Records whose type differs from the first one of their name are skipped.
+builders_t BuildFamilies(const std::vector<RecordView>& records);
+}
+}
@@ -0,0 +1,200 @@
+#include "snappy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+// Matches are searched within blocks of this size, so that offsets always
+// fit the two byte copy encoding.
+const std::size_t kBlockSize = 1 << 16;
+const int kHashBits = 14;
+
+std::uint32_t Load32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t Hash(const char* p) {
+  return (Load32(p) * 0x1e35a7bdu) >> (32 - kHashBits);
+}
+
+void AppendVarint(std::uint64_t value, std::string* output) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output->push_back(static_cast<char>(value));
+}
+
+void AppendLiteral(const char* begin, std::size_t length, std::string* output) {
+  if (length == 0) {
+    return;
+  }
+  auto n = length - 1;
+  if (n < 60) {
+    output->push_back(static_cast<char>(n << 2));
+  } else {
+    auto bytes = 1;
+    while (bytes < 4 && (n >> (8 * bytes)) != 0) {
+      ++bytes;
+    }
+    output->push_back(static_cast<char>((59 + bytes) << 2));
+    for (auto i = 0; i < bytes; ++i) {
+      output->push_back(static_cast<char>(n >> (8 * i)));
+    }
+  }
+  output->append(begin, length);
+}
+
+void AppendCopy(std::size_t offset, std::size_t length, std::string* output) {
+  // a copy is at most 64 bytes long; keep at least 4 for the last one
+  while (length >= 68) {
+    AppendCopy(offset, 64, output);
+    length -= 64;
+  }
+  if (length > 64) {
+    AppendCopy(offset, 60, output);
+    length -= 60;
+  }
+  if (length < 12 && offset < 2048) {
+    output->push_back(
+        static_cast<char>(1 | ((length - 4) << 2) | ((offset >> 8) << 5)));
+    output->push_back(static_cast<char>(offset & 0xff));
+  } else {
+    output->push_back(static_cast<char>(2 | ((length - 1) << 2)));
+    output->push_back(static_cast<char>(offset & 0xff));
+    output->push_back(static_cast<char>(offset >> 8));
+  }
+}
+
+void CompressBlock(const char* begin, std::size_t size,
+                   std::vector<std::int32_t>* table, std::string* output) {
+  std::fill(table->begin(), table->end(), -1);
+  std::size_t literal_start = 0;
+  std::size_t i = 0;
+  while (size >= 4 && i <= size - 4) {
+    auto& entry = (*table)[Hash(begin + i)];
+    auto candidate = entry;
+    entry = static_cast<std::int32_t>(i);
+    if (candidate < 0 || Load32(begin + candidate) != Load32(begin + i)) {
+      ++i;
+      continue;
+    }
+    std::size_t length = 4;
+    while (i + length < size &&
+           begin[candidate + length] == begin[i + length]) {
+      ++length;
+    }
+    AppendLiteral(begin + literal_start, i - literal_start, output);
+    AppendCopy(i - candidate, length, output);
+    i += length;
+    literal_start = i;
+  }
+  AppendLiteral(begin + literal_start, size - literal_start, output);
+}
+}  // namespace
+
+std::string SnappyCompress(const std::string& input) {
+  std::string output;
+  output.reserve(input.size() + input.size() / 6 + 32);
+  AppendVarint(input.size(), &output);
+  std::vector<std::int32_t> table(1 << kHashBits);
+  for (std::size_t start = 0; start < input.size(); start += kBlockSize) {
+    CompressBlock(input.data() + start,
+                  std::min(kBlockSize, input.size() - start), &table, &output);
+  }
+  return output;
+}
+
+bool SnappyUncompress(const std::string& input, std::string* output) {
+  auto p = reinterpret_cast<const unsigned char*>(input.data());
+  auto end = p + input.size();
+
+  std::uint64_t expected = 0;
+  for (auto shift = 0;; shift += 7) {
+    if (p == end || shift > 63) {
+      return false;
+    }
+    expected |= static_cast<std::uint64_t>(*p & 0x7f) << shift;
+    if ((*p++ & 0x80) == 0) {
+      break;
+    }
+  }
+
+  output->clear();
+  // the header is untrusted, so it only limits the output
+  output->reserve(std::min<std::uint64_t>(expected, 4 * input.size()));
+  auto read_le = [&p](int bytes) {
+    std::size_t value = 0;
+    for (auto i = 0; i < bytes; ++i) {
+      value |= static_cast<std::size_t>(*p++) << (8 * i);
+    }
+    return value;
+  };
+
+  while (p != end) {
+    auto tag = *p++;
+    std::size_t length;
+    std::size_t offset;
+    switch (tag & 3) {
+      case 0: {
+        length = tag >> 2;
+        if (length >= 60) {
+          auto bytes = static_cast<int>(length - 59);
+          if (end - p < bytes) {
+            return false;
+          }
+          length = read_le(bytes);
+        }
+        ++length;
+        if (static_cast<std::size_t>(end - p) < length ||
+            output->size() + length > expected) {
+          return false;
+        }
+        output->append(reinterpret_cast<const char*>(p), length);
+        p += length;
+        continue;
+      }
+      case 1:
+        if (end - p < 1) {
+          return false;
+        }
+        length = ((tag >> 2) & 7) + 4;
+        offset = (static_cast<std::size_t>(tag >> 5) << 8) | *p++;
+        break;
+      case 2:
+        if (end - p < 2) {
+          return false;
+        }
+        length = (tag >> 2) + 1;
+        offset = read_le(2);
+        break;
+      default:
+        if (end - p < 4) {
+          return false;
+        }
+        length = (tag >> 2) + 1;
+        offset = read_le(4);
+        break;
+    }
+    if (offset == 0 || offset > output->size() ||
+        output->size() + length > expected) {
+      return false;
+    }
+    // copies may overlap the bytes they produce
+    auto from = output->size() - offset;
+    for (std::size_t i = 0; i < length; ++i) {
+      output->push_back((*output)[from + i]);
+    }
+  }
+  return output->size() == expected;
+}
+}
+}
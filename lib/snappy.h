@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace prometheus {
+namespace detail {
+
+// Compresses `input` into the raw snappy block format (no framing), as
+// required by the remote-write protocol.
+std::string SnappyCompress(const std::string& input);
+
+// Decompresses a raw snappy block. Returns false if `input` is malformed.
+bool SnappyUncompress(const std::string& input, std::string* output);
+}
+}
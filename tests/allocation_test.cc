@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/registry.h>
+#include <prometheus/typed_family.h>
+
+#include "benchmark/allocation_counter.h"
+
+using namespace testing;
+using namespace prometheus;
+
+PROMETHEUS_LABEL(AllocationTestPath, "path");
+
+class AllocationTest : public Test {
+ public:
+  // Heap allocations made by `operation` when run `times` times.
+  template <typename F>
+  static std::uint64_t AllocationsOf(F operation, int times = 1000) {
+    auto start = ThreadAllocationCount();
+    for (auto i = 0; i < times; ++i) {
+      operation();
+    }
+    return ThreadAllocationCount().allocations - start.allocations;
+  }
+};
+
+TEST_F(AllocationTest, counter_increment_does_not_allocate) {
+  Family<Counter> family{"requests", "", {}};
+  auto& counter = family.Add({});
+  EXPECT_EQ(AllocationsOf([&counter] { counter.Increment(); }), 0);
+}
+
+TEST_F(AllocationTest, histogram_observe_does_not_allocate) {
+  Family<Histogram> family{"latencies", "", {}};
+  auto& histogram = family.Add({}, Histogram::BucketBoundaries{1, 2, 3});
+  auto value = 0.0;
+  EXPECT_EQ(AllocationsOf([&] { histogram.Observe(value += 0.5); }), 0);
+}
+
+TEST_F(AllocationTest, existing_series_lookup_does_not_allocate) {
+  Family<Counter> family{"requests", "", {}};
+  // values longer than the small string buffer, so that copying or
+  // concatenating them would allocate
+  auto labels = std::map<std::string, std::string>{
+      {"method", "GET"}, {"path", "/api/v1/users/profile"}};
+  family.Add(labels);
+  EXPECT_EQ(AllocationsOf([&] { family.Add(labels).Increment(); }), 0);
+}
+
+TEST_F(AllocationTest, existing_typed_series_lookup_does_not_allocate) {
+  TypedFamily<Counter, Labels<AllocationTestPath>> family{"requests", "", {}};
+  auto path = std::string{"/api/v1/users/profile"};
+  family.Add({path});
+  EXPECT_EQ(AllocationsOf([&] { family.Add({path}).Increment(); }), 0);
+}
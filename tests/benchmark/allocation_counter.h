@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made by the calling thread so far. Linking
+// allocation_counter.cc replaces the global operator new to count them.
+struct AllocationCount {
+  std::uint64_t allocations;
+  std::uint64_t bytes;
+};
+
+AllocationCount ThreadAllocationCount();
+
+// Reports the allocations the calling thread made since `start` as the
+// allocs_per_iter and alloc_bytes_per_iter counters of the benchmark
+// `state`. A template so that tests can use the counter without linking
+// Google Benchmark.
+template <typename State>
+void ReportAllocations(State& state, const AllocationCount& start) {
+  auto end = ThreadAllocationCount();
+  auto iterations = static_cast<double>(state.iterations());
+  if (iterations == 0) {
+    return;
+  }
+  state.counters["allocs_per_iter"] =
+      (end.allocations - start.allocations) / iterations;
+  state.counters["alloc_bytes_per_iter"] =
+      (end.bytes - start.bytes) / iterations;
+}
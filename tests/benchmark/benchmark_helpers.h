@@ -6,3 +6,18 @@
 std::string GenerateRandomString(size_t length);
 std::map<std::string, std::string> GenerateRandomLabels(
     std::size_t number_of_labels);
+
+// Index of the calling benchmark thread. State::thread_index is a data
+// member in older Google Benchmark releases and a method in newer ones.
+template <typename State>
+auto ThreadIndexOf(const State& state, int) -> decltype(state.thread_index()) {
+  return state.thread_index();
+}
+template <typename State>
+auto ThreadIndexOf(const State& state, long) -> decltype(state.thread_index) {
+  return state.thread_index;
+}
+template <typename State>
+int ThreadIndex(const State& state) {
+  return static_cast<int>(ThreadIndexOf(state, 0));
+}
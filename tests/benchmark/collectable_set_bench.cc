@@ -0,0 +1,52 @@
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "lib/collectable_set.h"
+
+namespace {
+class StubCollectable : public prometheus::Collectable {
+ public:
+  prometheus::builders_t Collect() override { return {}; }
+};
+}
+
+// Registers and removes one collectable in a set that already holds
+// range(0) others; the cost should not grow with the set.
+static void BM_CollectableSet_AddRemove(benchmark::State& state) {
+  using prometheus::Collectable;
+  using prometheus::detail::CollectableSet;
+  CollectableSet set;
+  auto existing = std::vector<std::shared_ptr<Collectable>>{};
+  for (auto i = 0; i < state.range(0); i++) {
+    existing.push_back(std::make_shared<StubCollectable>());
+    set.Add(existing.back());
+  }
+
+  auto collectable = std::make_shared<StubCollectable>();
+  while (state.KeepRunning()) {
+    set.Add(collectable);
+    set.Remove(collectable);
+  }
+}
+BENCHMARK(BM_CollectableSet_AddRemove)->Range(1, 1 << 14);
+
+// Fills an empty set with range(0) collectables.
+static void BM_CollectableSet_Grow(benchmark::State& state) {
+  using prometheus::Collectable;
+  using prometheus::detail::CollectableSet;
+  auto collectables = std::vector<std::shared_ptr<Collectable>>{};
+  for (auto i = 0; i < state.range(0); i++) {
+    collectables.push_back(std::make_shared<StubCollectable>());
+  }
+
+  while (state.KeepRunning()) {
+    CollectableSet set;
+    for (auto& collectable : collectables) {
+      set.Add(collectable);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CollectableSet_Grow)->Range(1, 1 << 14);
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Compares two Google Benchmark JSON reports and flags regressions.
+
+Both reports should be produced with --benchmark_repetitions so that every
+benchmark has several samples. A benchmark is reported as a regression when
+its mean time grew by more than --threshold and Welch's t-test rejects equal
+means at --alpha. The exit status is 1 if any regression was found.
+"""
+
+import argparse
+import json
+import math
+import os
+import sys
+
+AGGREGATE_SUFFIXES = ("_mean", "_median", "_stddev", "_cv")
+
+
+def load_samples(path, metric):
+    with open(path) as report:
+        benchmarks = json.load(report)["benchmarks"]
+    samples = {}
+    for benchmark in benchmarks:
+        name = benchmark.get("run_name", benchmark["name"])
+        if benchmark.get("run_type") == "aggregate" or (
+                "run_type" not in benchmark and
+                benchmark["name"].endswith(AGGREGATE_SUFFIXES)):
+            continue
+        if benchmark.get("error_occurred"):
+            continue
+        samples.setdefault(name, []).append(float(benchmark[metric]))
+    return samples
+
+
+def mean_and_variance(values):
+    mean = sum(values) / len(values)
+    if len(values) < 2:
+        return mean, 0.0
+    variance = sum((v - mean) ** 2 for v in values) / (len(values) - 1)
+    return mean, variance
+
+
+def incomplete_beta(a, b, x):
+    """Regularized incomplete beta function I_x(a, b)."""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    if x > (a + 1.0) / (a + b + 2.0):
+        return 1.0 - incomplete_beta(b, a, 1.0 - x)
+    front = math.exp(
+        math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) +
+        a * math.log(x) + b * math.log(1.0 - x)) / a
+    # Lentz's algorithm for the continued fraction
+    tiny = 1e-300
+    f, c, d = 1.0, 1.0, 0.0
+    for i in range(400):
+        m = i // 2
+        if i == 0:
+            numerator = 1.0
+        elif i % 2 == 0:
+            numerator = (m * (b - m) * x) / ((a + 2 * m - 1) * (a + 2 * m))
+        else:
+            numerator = -((a + m) * (a + b + m) * x) / (
+                (a + 2 * m) * (a + 2 * m + 1))
+        d = 1.0 + numerator * d
+        d = tiny if abs(d) < tiny else d
+        d = 1.0 / d
+        c = 1.0 + numerator / c
+        c = tiny if abs(c) < tiny else c
+        f *= c * d
+        if abs(1.0 - c * d) < 1e-12:
+            break
+    return front * (f - 1.0)
+
+
+def welch_p_value(baseline, current):
+    """Two-sided p-value of Welch's t-test for equal means."""
+    if len(baseline) < 2 or len(current) < 2:
+        return None
+    mean_a, var_a = mean_and_variance(baseline)
+    mean_b, var_b = mean_and_variance(current)
+    se_a, se_b = var_a / len(baseline), var_b / len(current)
+    if se_a + se_b == 0.0:
+        return 0.0 if mean_a != mean_b else 1.0
+    t = (mean_b - mean_a) / math.sqrt(se_a + se_b)
+    df = (se_a + se_b) ** 2 / (
+        se_a ** 2 / (len(baseline) - 1) + se_b ** 2 / (len(current) - 1))
+    return incomplete_beta(df / 2.0, 0.5, df / (df + t * t))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("baseline", help="JSON report of the baseline run")
+    parser.add_argument("current", help="JSON report of the run to check")
+    parser.add_argument("--metric", default="real_time",
+                        choices=("real_time", "cpu_time"))
+    parser.add_argument("--alpha", type=float, default=0.05,
+                        help="significance level of the t-test")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative slowdown that is tolerated")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.baseline):
+        print("no baseline report at {}, record one with the "
+              "benchmark_baseline target first".format(args.baseline))
+        return 2
+    baseline = load_samples(args.baseline, args.metric)
+    current = load_samples(args.current, args.metric)
+
+    regressions = 0
+    row = "{:<60} {:>12} {:>12} {:>9} {:>8}  {}"
+    print(row.format("benchmark", "baseline", "current", "change", "p",
+                     "verdict"))
+    for name in sorted(current):
+        if name not in baseline:
+            print(row.format(name, "-", "-", "-", "-", "new"))
+            continue
+        old_mean, old_var = mean_and_variance(baseline[name])
+        new_mean, new_var = mean_and_variance(current[name])
+        change = (new_mean - old_mean) / old_mean if old_mean else 0.0
+        p = welch_p_value(baseline[name], current[name])
+        significant = p is not None and p < args.alpha
+        if significant and change > args.threshold:
+            verdict = "REGRESSION"
+            regressions += 1
+        elif significant and change < -args.threshold:
+            verdict = "improvement"
+        elif p is None:
+            verdict = "too few repetitions"
+        else:
+            verdict = ""
+        print(row.format(name[:60],
+                         "{:.1f}±{:.1f}".format(old_mean, math.sqrt(old_var)),
+                         "{:.1f}±{:.1f}".format(new_mean, math.sqrt(new_var)),
+                         "{:+.1%}".format(change),
+                         "-" if p is None else "{:.3f}".format(p), verdict))
+    for name in sorted(set(baseline) - set(current)):
+        print(row.format(name[:60], "-", "-", "-", "-", "removed"))
+
+    print("{} regression(s) at alpha={} and threshold={:.0%}".format(
+        regressions, args.alpha, args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
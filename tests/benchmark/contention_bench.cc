@@ -0,0 +1,123 @@
+#include <map>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/registry.h>
+
+#include "allocation_counter.h"
+#include "benchmark_helpers.h"
+
+// Metrics shared by all threads of a benchmark. Function-local statics are
+// initialized exactly once even when several benchmark threads get here at
+// the same time, and they outlive every run.
+struct SharedMetrics {
+  prometheus::Registry registry;
+  prometheus::Family<prometheus::Counter>& counters =
+      prometheus::BuildCounter().Name("counter").Help("").Register(registry);
+  prometheus::Family<prometheus::Gauge>& gauges =
+      prometheus::BuildGauge().Name("gauge").Help("").Register(registry);
+  prometheus::Family<prometheus::Histogram>& histograms =
+      prometheus::BuildHistogram().Name("histogram").Help("").Register(
+          registry);
+};
+
+static SharedMetrics& Shared() {
+  static SharedMetrics shared;
+  return shared;
+}
+
+// The update benchmarks take one argument: 1 makes every thread update the
+// same series, 0 gives each thread a series of its own. Compare
+// items_per_second across thread counts to see how updates scale.
+
+// Labels of the series a thread updates: one series for all threads when
+// `same_series` is set, one series per thread otherwise.
+static std::map<std::string, std::string> SeriesLabels(
+    const benchmark::State& state, bool same_series) {
+  return {{"thread",
+           same_series ? "shared" : std::to_string(ThreadIndex(state))}};
+}
+
+static prometheus::Histogram::BucketBoundaries Buckets() {
+  return {1, 2, 4, 8, 16, 32, 64, 128, 256, 512};
+}
+
+static void BM_Contention_CounterIncrement(benchmark::State& state) {
+  auto& counter = Shared().counters.Add(SeriesLabels(state, state.range(0)));
+
+  while (state.KeepRunning()) counter.Increment();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Contention_CounterIncrement)
+    ->Arg(1)
+    ->Arg(0)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+static void BM_Contention_GaugeIncrement(benchmark::State& state) {
+  auto& gauge = Shared().gauges.Add(SeriesLabels(state, state.range(0)));
+
+  while (state.KeepRunning()) gauge.Increment();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Contention_GaugeIncrement)
+    ->Arg(1)
+    ->Arg(0)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+static void BM_Contention_HistogramObserve(benchmark::State& state) {
+  auto& histogram =
+      Shared().histograms.Add(SeriesLabels(state, state.range(0)), Buckets());
+  auto observation = 0.0;
+
+  while (state.KeepRunning()) {
+    histogram.Observe(observation);
+    observation = observation < 600 ? observation + 7 : 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Contention_HistogramObserve)
+    ->Arg(1)
+    ->Arg(0)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+static void BM_Contention_FamilyAddLookup(benchmark::State& state) {
+  auto& family = Shared().counters;
+  auto labels = SeriesLabels(state, state.range(0));
+  family.Add(labels);
+
+  auto allocations = ThreadAllocationCount();
+  while (state.KeepRunning()) benchmark::DoNotOptimize(&family.Add(labels));
+  state.SetItemsProcessed(state.iterations());
+  ReportAllocations(state, allocations);
+}
+BENCHMARK(BM_Contention_FamilyAddLookup)
+    ->Arg(1)
+    ->Arg(0)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Thread 0 scrapes the registry continuously while all other threads
+// increment their own series; items are the increments of the other threads.
+static void BM_Contention_CounterIncrementDuringCollect(
+    benchmark::State& state) {
+  auto& shared = Shared();
+  auto& counter = shared.counters.Add(SeriesLabels(state, false));
+  auto scraper = ThreadIndex(state) == 0;
+
+  while (state.KeepRunning()) {
+    if (scraper) {
+      benchmark::DoNotOptimize(shared.registry.Collect());
+    } else {
+      counter.Increment();
+    }
+  }
+  if (!scraper) {
+    state.SetItemsProcessed(state.iterations());
+  }
+}
+BENCHMARK(BM_Contention_CounterIncrementDuringCollect)
+    ->ThreadRange(2, 16)
+    ->UseRealTime();
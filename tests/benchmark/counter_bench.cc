@@ -1,5 +1,11 @@
+#include <vector>
+
 #include <benchmark/benchmark.h>
+#include <prometheus/local_recorder.h>
 #include <prometheus/registry.h>
+#include <prometheus/typed_family.h>
+
+#include "allocation_counter.h"
 
 static void BM_Counter_Increment(benchmark::State& state) {
   using prometheus::Registry;
@@ -10,7 +16,9 @@ static void BM_Counter_Increment(benchmark::State& state) {
       BuildCounter().Name("benchmark_counter").Help("").Register(registry);
   auto& counter = counter_family.Add({});
 
+  auto allocations = ThreadAllocationCount();
   while (state.KeepRunning()) counter.Increment();
+  ReportAllocations(state, allocations);
 }
 BENCHMARK(BM_Counter_Increment);
 
@@ -23,8 +31,90 @@ static void BM_Counter_Collect(benchmark::State& state) {
       BuildCounter().Name("benchmark_counter").Help("").Register(registry);
   auto& counter = counter_family.Add({});
 
+  auto labels = prometheus::label_pair_t{};
+  flatbuffers::FlatBufferBuilder builder;
+
   while (state.KeepRunning()) {
-    benchmark::DoNotOptimize(counter.Collect());
-  };
+    benchmark::DoNotOptimize(counter.Collect(&labels, &builder));
+    builder.Clear();
+  }
 }
 BENCHMARK(BM_Counter_Collect);
+
+static void BM_Counter_FamilyLookup(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::BuildCounter;
+  Registry registry;
+  auto& counter_family =
+      BuildCounter().Name("benchmark_counter").Help("").Register(registry);
+  counter_family.Add({{"method", "GET"}, {"code", "200"}});
+
+  auto allocations = ThreadAllocationCount();
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        &counter_family.Add({{"method", "GET"}, {"code", "200"}}));
+  }
+  ReportAllocations(state, allocations);
+}
+BENCHMARK(BM_Counter_FamilyLookup);
+
+namespace {
+PROMETHEUS_LABEL(MethodLabel, "method");
+PROMETHEUS_LABEL(CodeLabel, "code");
+}
+
+static void BM_Counter_TypedFamilyLookup(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::BuildCounter;
+  using prometheus::Labels;
+  Registry registry;
+  auto& counter_family = BuildCounter()
+                             .Name("benchmark_counter")
+                             .Help("")
+                             .RegisterTyped<Labels<MethodLabel, CodeLabel>>(
+                                 registry);
+  counter_family.Add({"GET", "200"});
+
+  auto allocations = ThreadAllocationCount();
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(&counter_family.Add({"GET", "200"}));
+  }
+  ReportAllocations(state, allocations);
+}
+BENCHMARK(BM_Counter_TypedFamilyLookup);
+
+static void BM_Counter_IncrementLoop(benchmark::State& state) {
+  using prometheus::Counter;
+  Counter counter;
+  auto values = std::vector<double>(state.range(0), 1.0);
+
+  while (state.KeepRunning()) {
+    for (auto value : values) {
+      counter.Increment(value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Counter_IncrementLoop)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+static void BM_Counter_IncrementBatch(benchmark::State& state) {
+  using prometheus::Counter;
+  Counter counter;
+  auto values = std::vector<double>(state.range(0), 1.0);
+
+  while (state.KeepRunning()) {
+    counter.IncrementBatch(values.data(), values.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Counter_IncrementBatch)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+static void BM_Counter_LocalIncrement(benchmark::State& state) {
+  using prometheus::Counter;
+  using prometheus::LocalCounter;
+  Counter counter;
+  LocalCounter local{counter};
+
+  while (state.KeepRunning()) local.Increment();
+}
+BENCHMARK(BM_Counter_LocalIncrement);
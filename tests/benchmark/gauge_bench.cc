@@ -1,6 +1,8 @@
 #include <benchmark/benchmark.h>
 #include <prometheus/registry.h>
 
+#include "allocation_counter.h"
+
 static void BM_Gauge_Increment(benchmark::State& state) {
   using prometheus::Registry;
   using prometheus::Gauge;
@@ -10,7 +12,9 @@ static void BM_Gauge_Increment(benchmark::State& state) {
       BuildGauge().Name("benchmark_gauge").Help("").Register(registry);
   auto& gauge = gauge_family.Add({});
 
+  auto allocations = ThreadAllocationCount();
   while (state.KeepRunning()) gauge.Increment(2);
+  ReportAllocations(state, allocations);
 }
 BENCHMARK(BM_Gauge_Increment);
 
@@ -49,8 +53,12 @@ static void BM_Gauge_Collect(benchmark::State& state) {
       BuildGauge().Name("benchmark_gauge").Help("").Register(registry);
   auto& gauge = gauge_family.Add({});
 
+  auto labels = prometheus::label_pair_t{};
+  flatbuffers::FlatBufferBuilder builder;
+
   while (state.KeepRunning()) {
-    benchmark::DoNotOptimize(gauge.Collect());
-  };
+    benchmark::DoNotOptimize(gauge.Collect(&labels, &builder));
+    builder.Clear();
+  }
 }
 BENCHMARK(BM_Gauge_Collect);
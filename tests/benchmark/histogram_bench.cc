@@ -1,8 +1,13 @@
 #include <chrono>
 #include <random>
+#include <vector>
 
 #include <benchmark/benchmark.h>
 #include <prometheus/registry.h>
+#include <prometheus/sampling_marker.h>
+#include <prometheus/static_histogram.h>
+
+#include "allocation_counter.h"
 
 using prometheus::Histogram;
 
@@ -31,6 +36,7 @@ static void BM_Histogram_Observe(benchmark::State& state) {
   std::mt19937 gen(rd());
   std::uniform_real_distribution<> d(0, number_of_buckets);
 
+  auto allocations = ThreadAllocationCount();
   while (state.KeepRunning()) {
     auto observation = d(gen);
     auto start = std::chrono::high_resolution_clock::now();
@@ -41,6 +47,7 @@ static void BM_Histogram_Observe(benchmark::State& state) {
         std::chrono::duration_cast<std::chrono::duration<double>>(end - start);
     state.SetIterationTime(elapsed_seconds.count());
   }
+  ReportAllocations(state, allocations);
 }
 BENCHMARK(BM_Histogram_Observe)->Range(0, 4096);
 
@@ -57,8 +64,127 @@ static void BM_Histogram_Collect(benchmark::State& state) {
   auto bucket_boundaries = CreateLinearBuckets(0, number_of_buckets - 1, 1);
   auto& histogram = histogram_family.Add({}, bucket_boundaries);
 
+  auto labels = prometheus::label_pair_t{};
+  flatbuffers::FlatBufferBuilder builder;
+
   while (state.KeepRunning()) {
-    benchmark::DoNotOptimize(histogram.Collect());
+    benchmark::DoNotOptimize(histogram.Collect(&labels, &builder));
+    builder.Clear();
   }
 }
 BENCHMARK(BM_Histogram_Collect)->Range(0, 4096);
+
+static void BM_Histogram_SamplingMarker(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::Histogram;
+  using prometheus::BuildHistogram;
+  using prometheus::FixedRateSampler;
+  using prometheus::SamplingMarker;
+
+  Registry registry;
+  auto& histogram_family =
+      BuildHistogram().Name("benchmark_histogram").Help("").Register(registry);
+  auto& histogram = histogram_family.Add({}, CreateLinearBuckets(0, 10, 1));
+  FixedRateSampler sampler{static_cast<std::uint64_t>(state.range(0))};
+
+  while (state.KeepRunning()) {
+    SamplingMarker<FixedRateSampler> marker{histogram, sampler};
+  }
+}
+BENCHMARK(BM_Histogram_SamplingMarker)->Arg(1)->Arg(16)->Arg(256);
+
+using LatencyBuckets =
+    prometheus::Buckets<5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000,
+                        10000>;
+
+static void BM_Histogram_ObserveDynamicLatency(benchmark::State& state) {
+  using prometheus::Histogram;
+  using prometheus::StaticHistogram;
+
+  Histogram histogram{StaticHistogram<LatencyBuckets>::BucketBoundaries()};
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<> d(0, 12000);
+  auto observations = std::vector<double>(1024);
+  for (auto& observation : observations) {
+    observation = d(gen);
+  }
+
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    histogram.Observe(observations[i++ & 1023]);
+  }
+}
+BENCHMARK(BM_Histogram_ObserveDynamicLatency);
+
+static void BM_Histogram_ObserveStaticLatency(benchmark::State& state) {
+  using prometheus::StaticHistogram;
+
+  StaticHistogram<LatencyBuckets> histogram;
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<> d(0, 12000);
+  auto observations = std::vector<double>(1024);
+  for (auto& observation : observations) {
+    observation = d(gen);
+  }
+
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    histogram.Observe(observations[i++ & 1023]);
+  }
+}
+BENCHMARK(BM_Histogram_ObserveStaticLatency);
+
+static std::vector<double> CreateLatencies(std::size_t count) {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<> d(0, 12000);
+  auto latencies = std::vector<double>(count);
+  for (auto& latency : latencies) {
+    latency = d(gen);
+  }
+  return latencies;
+}
+
+static void BM_Histogram_ObserveLoop(benchmark::State& state) {
+  using prometheus::Histogram;
+  using prometheus::StaticHistogram;
+
+  Histogram histogram{StaticHistogram<LatencyBuckets>::BucketBoundaries()};
+  auto latencies = CreateLatencies(state.range(0));
+
+  while (state.KeepRunning()) {
+    for (auto latency : latencies) {
+      histogram.Observe(latency);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Histogram_ObserveLoop)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+static void BM_Histogram_ObserveBatch(benchmark::State& state) {
+  using prometheus::Histogram;
+  using prometheus::StaticHistogram;
+
+  Histogram histogram{StaticHistogram<LatencyBuckets>::BucketBoundaries()};
+  auto latencies = CreateLatencies(state.range(0));
+
+  while (state.KeepRunning()) {
+    histogram.ObserveBatch(latencies.data(), latencies.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Histogram_ObserveBatch)->RangeMultiplier(8)->Range(1, 64 << 10);
+
+static void BM_Histogram_ObserveStaticBatch(benchmark::State& state) {
+  using prometheus::StaticHistogram;
+
+  StaticHistogram<LatencyBuckets> histogram;
+  auto latencies = CreateLatencies(state.range(0));
+
+  while (state.KeepRunning()) {
+    histogram.ObserveBatch(latencies.data(), latencies.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Histogram_ObserveStaticBatch)
+    ->RangeMultiplier(8)
+    ->Range(1, 64 << 10);
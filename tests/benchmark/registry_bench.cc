@@ -1,6 +1,10 @@
+#include <atomic>
 #include <chrono>
+#include <string>
+#include <thread>
 
 #include <benchmark/benchmark.h>
+#include <prometheus/columnar_family.h>
 #include <prometheus/registry.h>
 
 #include "benchmark_helpers.h"
@@ -10,11 +14,34 @@ static void BM_Registry_CreateFamily(benchmark::State& state) {
   using prometheus::Counter;
   using prometheus::BuildCounter;
   Registry registry;
+  std::size_t i = 0;
 
+  while (state.KeepRunning()) {
+    // a new name every time, so that each call creates a family
+    auto name = "benchmark_counter_" + std::to_string(i++);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    BuildCounter().Name(name).Help("").Register(registry);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    auto elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(end - start);
+    state.SetIterationTime(elapsed_seconds.count());
+  }
+}
+BENCHMARK(BM_Registry_CreateFamily)->UseManualTime();
+
+static void BM_Registry_LookupFamily(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::Counter;
+  using prometheus::BuildCounter;
+  Registry registry;
+
+  // every call after the first finds the family through the name index
   while (state.KeepRunning())
     BuildCounter().Name("benchmark_counter").Help("").Register(registry);
 }
-BENCHMARK(BM_Registry_CreateFamily);
+BENCHMARK(BM_Registry_LookupFamily);
 
 static void BM_Registry_CreateCounter(benchmark::State& state) {
   using prometheus::Registry;
@@ -40,3 +67,128 @@ static void BM_Registry_CreateCounter(benchmark::State& state) {
   }
 }
 BENCHMARK(BM_Registry_CreateCounter)->Range(0, 4096);
+
+static void BM_Registry_CreateFamilyDuringCollect(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::Counter;
+  using prometheus::BuildCounter;
+  Registry registry;
+  auto& counter_family =
+      BuildCounter().Name("benchmark_counter").Help("").Register(registry);
+  for (auto i = 0; i < state.range(0); i++) {
+    counter_family.Add({{"series", std::to_string(i)}});
+  }
+
+  std::atomic<bool> done{false};
+  std::thread scraper{[&] {
+    while (!done) {
+      benchmark::DoNotOptimize(registry.Collect());
+    }
+  }};
+
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    auto name = "benchmark_family_" + std::to_string(i++);
+    auto start = std::chrono::high_resolution_clock::now();
+    BuildCounter().Name(name).Help("").Register(registry);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    auto elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(end - start);
+    state.SetIterationTime(elapsed_seconds.count());
+  }
+
+  done = true;
+  scraper.join();
+}
+BENCHMARK(BM_Registry_CreateFamilyDuringCollect)
+    ->Range(1, 1 << 16)
+    ->UseManualTime();
+
+static void BM_Registry_LookupFamilyDuringCollect(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::Counter;
+  using prometheus::BuildCounter;
+  Registry registry;
+  auto& counter_family =
+      BuildCounter().Name("benchmark_counter").Help("").Register(registry);
+  for (auto i = 0; i < state.range(0); i++) {
+    counter_family.Add({{"series", std::to_string(i)}});
+  }
+
+  std::atomic<bool> done{false};
+  std::thread scraper{[&] {
+    while (!done) {
+      benchmark::DoNotOptimize(registry.Collect());
+    }
+  }};
+
+  while (state.KeepRunning()) {
+    auto start = std::chrono::high_resolution_clock::now();
+    BuildCounter().Name("benchmark_counter").Help("").Register(registry);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    auto elapsed_seconds =
+        std::chrono::duration_cast<std::chrono::duration<double>>(end - start);
+    state.SetIterationTime(elapsed_seconds.count());
+  }
+
+  done = true;
+  scraper.join();
+}
+BENCHMARK(BM_Registry_LookupFamilyDuringCollect)
+    ->Range(1, 1 << 16)
+    ->UseManualTime();
+
+static void BM_Registry_CollectLargeFamily(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::Counter;
+  using prometheus::BuildCounter;
+  Registry registry;
+  auto& counter_family =
+      BuildCounter().Name("benchmark_counter").Help("").Register(registry);
+  for (auto i = 0; i < state.range(0); i++) {
+    counter_family.Add({{"series", std::to_string(i)}});
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(registry.Collect());
+  }
+}
+BENCHMARK(BM_Registry_CollectLargeFamily)->Range(1, 1 << 16);
+
+static void BM_Registry_CollectLargeColumnarFamily(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::BuildCounter;
+  Registry registry;
+  auto& counter_family = BuildCounter()
+                             .Name("benchmark_counter")
+                             .Help("")
+                             .RegisterColumnar(registry);
+  for (auto i = 0; i < state.range(0); i++) {
+    counter_family.Add({{"series", std::to_string(i)}});
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(registry.Collect());
+  }
+}
+BENCHMARK(BM_Registry_CollectLargeColumnarFamily)->Range(1, 1 << 16);
+
+static void BM_Registry_SumColumnarFamily(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::BuildCounter;
+  Registry registry;
+  auto& counter_family = BuildCounter()
+                             .Name("benchmark_counter")
+                             .Help("")
+                             .RegisterColumnar(registry);
+  for (auto i = 0; i < state.range(0); i++) {
+    counter_family.Add({{"series", std::to_string(i)}}).Increment(i);
+  }
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(counter_family.Sum());
+  }
+}
+BENCHMARK(BM_Registry_SumColumnarFamily)->Range(1, 1 << 16);
@@ -0,0 +1,156 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/exposer.h>
+#include <prometheus/registry.h>
+
+#include "allocation_counter.h"
+#include "benchmark_helpers.h"
+#include "lib/text_serializer.h"
+
+// The scrape benchmarks take the shape of the registry as arguments:
+// families, series per family, random labels per series and histogram
+// buckets, where 0 buckets means counter families. They report the series
+// and bytes of one scrape as items and bytes per second.
+
+static std::shared_ptr<prometheus::Registry> BuildRegistry(
+    const benchmark::State& state) {
+  using prometheus::BuildCounter;
+  using prometheus::BuildHistogram;
+  using prometheus::Histogram;
+
+  auto registry = std::make_shared<prometheus::Registry>();
+  auto buckets = Histogram::BucketBoundaries{};
+  for (auto i = 0; i < state.range(3); i++) {
+    buckets.push_back(i);
+  }
+
+  auto series_labels = [&state](int series) {
+    auto labels = GenerateRandomLabels(state.range(2));
+    labels.insert({"series", std::to_string(series)});
+    return labels;
+  };
+
+  for (auto family = 0; family < state.range(0); family++) {
+    auto name = "family_" + std::to_string(family);
+    if (buckets.empty()) {
+      auto& counters = BuildCounter().Name(name).Help("").Register(*registry);
+      for (auto series = 0; series < state.range(1); series++) {
+        counters.Add(series_labels(series)).Increment(series);
+      }
+    } else {
+      auto& histograms =
+          BuildHistogram().Name(name).Help("").Register(*registry);
+      for (auto series = 0; series < state.range(1); series++) {
+        histograms.Add(series_labels(series), buckets)
+            .Observe(series % buckets.size());
+      }
+    }
+  }
+  return registry;
+}
+
+static void ReportThroughput(benchmark::State& state, std::size_t bytes) {
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// Fetches `uri` from the loopback server at `port` and returns the size of
+// the response, or 0 on failure.
+static std::size_t Scrape(int port, const std::string& uri) {
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  auto request = "GET " + uri + " HTTP/1.1\r\nHost: localhost\r\n" +
+                 "Connection: close\r\n\r\n";
+
+  std::size_t received = 0;
+  auto connected =
+      connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+  if (connected && send(fd, request.data(), request.size(), 0) ==
+                       static_cast<ssize_t>(request.size())) {
+    char buffer[64 * 1024];
+    ssize_t bytes;
+    while ((bytes = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      received += bytes;
+    }
+  }
+  close(fd);
+  return received;
+}
+
+static void BM_Scrape_Collect(benchmark::State& state) {
+  auto registry = BuildRegistry(state);
+  std::size_t bytes = 0;
+
+  auto allocations = ThreadAllocationCount();
+  while (state.KeepRunning()) {
+    auto collected = registry->Collect();
+    bytes = 0;
+    for (auto& bld : collected) {
+      bytes += bld->GetSize();
+    }
+  }
+  ReportThroughput(state, bytes);
+  ReportAllocations(state, allocations);
+}
+
+static void BM_Scrape_Serialize(benchmark::State& state) {
+  auto registry = BuildRegistry(state);
+  auto collected = registry->Collect();
+  prometheus::TextSerializer serializer;
+  std::size_t bytes = 0;
+
+  auto allocations = ThreadAllocationCount();
+  while (state.KeepRunning()) {
+    bytes = serializer.Serialize(collected).size();
+  }
+  ReportThroughput(state, bytes);
+  ReportAllocations(state, allocations);
+}
+
+static void BM_Scrape_EndToEnd(benchmark::State& state) {
+  auto registry = BuildRegistry(state);
+  prometheus::Exposer exposer{"127.0.0.1:0"};
+  exposer.RegisterCollectable(registry);
+  auto ports = exposer.GetListeningPorts();
+  if (ports.empty()) {
+    state.SkipWithError("exposer is not listening");
+    return;
+  }
+  std::size_t bytes = 0;
+
+  while (state.KeepRunning()) {
+    bytes = Scrape(ports.front(), "/metrics");
+    if (bytes == 0) {
+      state.SkipWithError("scrape failed");
+      break;
+    }
+  }
+  ReportThroughput(state, bytes);
+}
+
+static void ScrapeShapes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Args({10, 100, 2, 0})
+      ->Args({10, 100, 2, 10})
+      ->Args({100, 1000, 4, 0})
+      ->Args({1, 10000, 2, 0})
+      ->Args({10, 1000, 2, 20});
+}
+
+BENCHMARK(BM_Scrape_Collect)->Apply(ScrapeShapes);
+BENCHMARK(BM_Scrape_Serialize)->Apply(ScrapeShapes);
+BENCHMARK(BM_Scrape_EndToEnd)->Apply(ScrapeShapes)->UseRealTime();
@@ -0,0 +1,61 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/shared_memory.h>
+
+// Writes a segment with `series` counters and returns its path.
+static std::string WriteCounterSegment(int series) {
+  using prometheus::BuildCounter;
+  using prometheus::SharedMemorySegment;
+  auto path = "/tmp/shared_memory_bench." + std::to_string(getpid());
+  SharedMemorySegment segment{path, static_cast<std::size_t>(series) * 128 +
+                                        4096};
+  auto& family =
+      BuildCounter().Name("benchmark_counter").Help("").RegisterShared(
+          segment);
+  for (auto i = 0; i < series; ++i) {
+    family.Add({{"series", std::to_string(i)}}).Increment(i);
+  }
+  return path;
+}
+
+static void BM_SharedMemory_Restore(benchmark::State& state) {
+  using prometheus::SegmentMode;
+  using prometheus::SharedMemorySegment;
+  auto path = WriteCounterSegment(state.range(0));
+
+  while (state.KeepRunning()) {
+    SharedMemorySegment segment{path, 0, SegmentMode::kRestore};
+    benchmark::DoNotOptimize(&segment);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_SharedMemory_Restore)->Range(1 << 10, 1 << 20);
+
+static void BM_SharedMemory_RestoreAndReattach(benchmark::State& state) {
+  using prometheus::BuildCounter;
+  using prometheus::SegmentMode;
+  using prometheus::SharedMemorySegment;
+  auto path = WriteCounterSegment(state.range(0));
+  auto labels = std::vector<std::string>{};
+  for (auto i = 0; i < state.range(0); ++i) {
+    labels.push_back(std::to_string(i));
+  }
+
+  while (state.KeepRunning()) {
+    SharedMemorySegment segment{path, 0, SegmentMode::kRestore};
+    auto& family =
+        BuildCounter().Name("benchmark_counter").Help("").RegisterShared(
+            segment);
+    for (const auto& label : labels) {
+      benchmark::DoNotOptimize(family.Add({{"series", label}}));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_SharedMemory_RestoreAndReattach)->Range(1 << 10, 1 << 18);
@@ -0,0 +1,91 @@
+#include <stdexcept>
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/registry.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class CallbackMetricTest : public Test {
+ public:
+  static const io::prometheus::client::MetricFamily* Collected(
+      const builders_t& collected) {
+    return io::prometheus::client::GetMetricFamily(
+        collected.at(0)->GetBufferPointer());
+  }
+};
+
+TEST_F(CallbackMetricTest, gauge_callback_is_evaluated_on_collect) {
+  Family<Gauge> family{"queue_depth", "", {{"component", "test"}}};
+  auto depth = 3.0;
+  family.AddCallback({{"queue", "a"}}, [&depth] { return depth; });
+  depth = 5;
+  auto collected = family.Collect();
+  auto metrics = Collected(collected)->metric();
+  ASSERT_EQ(metrics->size(), 1);
+  EXPECT_EQ(metrics->Get(0)->gauge()->value(), 5);
+  ASSERT_EQ(metrics->Get(0)->label()->size(), 2);
+  EXPECT_EQ(metrics->Get(0)->label()->Get(1)->value()->str(), "a");
+}
+
+TEST_F(CallbackMetricTest, callbacks_collect_next_to_regular_series) {
+  Family<Counter> family{"requests", "", {}};
+  family.Add({{"code", "200"}}).Increment();
+  family.AddCallback({{"code", "500"}}, [] { return 2.0; });
+  auto collected = family.Collect();
+  EXPECT_EQ(Collected(collected)->metric()->size(), 2);
+}
+
+TEST_F(CallbackMetricTest, remove_callback) {
+  Family<Gauge> family{"queue_depth", "", {}};
+  family.AddCallback({{"queue", "a"}}, [] { return 1.0; });
+  family.RemoveCallback({{"queue", "a"}});
+  auto collected = family.Collect();
+  EXPECT_EQ(Collected(collected)->metric()->size(), 0);
+}
+
+TEST_F(CallbackMetricTest, callback_for_existing_series_is_rejected) {
+  Family<Counter> family{"requests", "", {}};
+  family.Add({{"code", "200"}});
+  EXPECT_THROW(family.AddCallback({{"code", "200"}}, [] { return 1.0; }),
+               std::invalid_argument);
+}
+
+TEST_F(CallbackMetricTest, duplicate_callback_is_rejected) {
+  Family<Gauge> family{"queue_depth", "", {}};
+  family.AddCallback({{"queue", "a"}}, [] { return 1.0; });
+  EXPECT_THROW(family.AddCallback({{"queue", "a"}}, [] { return 2.0; }),
+               std::invalid_argument);
+  auto collected = family.Collect();
+  auto metrics = Collected(collected)->metric();
+  ASSERT_EQ(metrics->size(), 1);
+  EXPECT_EQ(metrics->Get(0)->gauge()->value(), 1);
+}
+
+TEST_F(CallbackMetricTest, series_for_existing_callback_is_rejected) {
+  Family<Gauge> family{"queue_depth", "", {}};
+  family.AddCallback({{"queue", "a"}}, [] { return 1.0; });
+  EXPECT_THROW(family.Add({{"queue", "a"}}), std::invalid_argument);
+  family.RemoveCallback({{"queue", "a"}});
+  EXPECT_NO_THROW(family.Add({{"queue", "a"}}));
+}
+
+TEST_F(CallbackMetricTest, batch_callback_emits_many_series) {
+  Family<Gauge> family{"cache_size", "", {}};
+  auto id =
+      family.AddBatchCallback([](const Family<Gauge>::SeriesEmitter& emit) {
+        for (auto i = 0; i < 3; i++) {
+          emit({{"cache", std::to_string(i)}}, i);
+        }
+      });
+  auto collected = family.Collect();
+  auto metrics = Collected(collected)->metric();
+  ASSERT_EQ(metrics->size(), 3);
+  EXPECT_EQ(metrics->Get(2)->gauge()->value(), 2);
+
+  family.RemoveBatchCallback(id);
+  collected = family.Collect();
+  EXPECT_EQ(Collected(collected)->metric()->size(), 0);
+}
@@ -0,0 +1,160 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "lib/collectable_set.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class CollectableSetTest : public Test {
+ public:
+  class StubCollectable : public Collectable {
+   public:
+    builders_t Collect() override { return {}; }
+  };
+
+  static std::shared_ptr<Collectable> MakeCollectable() {
+    return std::make_shared<StubCollectable>();
+  }
+
+  detail::CollectableSet set_;
+};
+
+TEST_F(CollectableSetTest, snapshot_returns_added_collectables) {
+  auto first = MakeCollectable();
+  auto second = MakeCollectable();
+  set_.Add(first);
+  set_.Add(second);
+  EXPECT_THAT(set_.Snapshot(), ElementsAre(first, second));
+}
+
+TEST_F(CollectableSetTest, remove_drops_only_the_given_collectable) {
+  auto first = MakeCollectable();
+  auto second = MakeCollectable();
+  set_.Add(first);
+  set_.Add(second);
+  set_.Remove(first);
+  EXPECT_THAT(set_.Snapshot(), ElementsAre(second));
+  set_.Remove(first);
+  EXPECT_EQ(set_.size(), 1);
+}
+
+TEST_F(CollectableSetTest, snapshot_prunes_expired_entries) {
+  auto kept = MakeCollectable();
+  auto expired = MakeCollectable();
+  set_.Add(kept);
+  set_.Add(expired);
+  expired.reset();
+  EXPECT_EQ(set_.size(), 2);
+  EXPECT_THAT(set_.Snapshot(), ElementsAre(kept));
+  EXPECT_EQ(set_.size(), 1);
+}
+
+TEST_F(CollectableSetTest, growing_prunes_expired_entries) {
+  auto expired = MakeCollectable();
+  set_.Add(expired);
+  expired.reset();
+  auto kept = std::vector<std::shared_ptr<Collectable>>{};
+  for (int i = 0; i < 100; ++i) {
+    kept.push_back(MakeCollectable());
+    set_.Add(kept.back());
+  }
+  EXPECT_EQ(set_.size(), 100);
+  EXPECT_EQ(set_.Snapshot(), kept);
+}
+
+TEST_F(CollectableSetTest, add_of_present_collectable_is_ignored) {
+  auto collectable = MakeCollectable();
+  set_.Add(collectable);
+  set_.Add(collectable);
+  EXPECT_THAT(set_.Snapshot(), ElementsAre(collectable));
+}
+
+TEST_F(CollectableSetTest, readding_after_remove) {
+  auto collectable = MakeCollectable();
+  for (int i = 0; i < 100; ++i) {
+    set_.Add(collectable);
+    set_.Remove(collectable);
+  }
+  set_.Add(collectable);
+  EXPECT_THAT(set_.Snapshot(), ElementsAre(collectable));
+  EXPECT_EQ(set_.size(), 1);
+}
+
+TEST_F(CollectableSetTest, ids_are_never_reused) {
+  auto first = MakeCollectable();
+  auto second = MakeCollectable();
+  set_.Add(first);
+  set_.Add(second);
+  set_.Remove(first);
+  set_.Add(first);
+
+  auto ids = std::vector<std::size_t>{};
+  auto version = std::size_t{0};
+  EXPECT_THAT(set_.Snapshot(&ids, &version), ElementsAre(second, first));
+  EXPECT_THAT(ids, ElementsAre(1, 2));
+  EXPECT_EQ(version, 4);
+}
+
+TEST_F(CollectableSetTest, remove_of_expired_collectable) {
+  auto expired = MakeCollectable();
+  std::weak_ptr<Collectable> weak = expired;
+  set_.Add(weak);
+  expired.reset();
+  set_.Remove(weak);
+  EXPECT_EQ(set_.size(), 0);
+  EXPECT_TRUE(set_.Snapshot().empty());
+}
+
+TEST_F(CollectableSetTest, concurrent_changes_during_snapshots) {
+  auto permanent = MakeCollectable();
+  set_.Add(permanent);
+
+  std::atomic<bool> done{false};
+  std::atomic<bool> lost_permanent{false};
+  auto scrapers = std::vector<std::thread>{};
+  for (int t = 0; t < 2; ++t) {
+    scrapers.emplace_back([&] {
+      while (!done) {
+        auto snapshot = set_.Snapshot();
+        auto found = false;
+        for (auto& collectable : snapshot) {
+          collectable->Collect();
+          found = found || collectable == permanent;
+        }
+        if (!found) {
+          lost_permanent = true;
+        }
+      }
+    });
+  }
+
+  auto writers = std::vector<std::thread>{};
+  for (int t = 0; t < 2; ++t) {
+    writers.emplace_back([&] {
+      for (int i = 0; i < 500; ++i) {
+        auto collectable = MakeCollectable();
+        set_.Add(collectable);
+        if (i % 2 == 0) {
+          set_.Remove(collectable);
+        }
+        // the others expire here and are pruned later
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  done = true;
+  for (auto& scraper : scrapers) {
+    scraper.join();
+  }
+
+  EXPECT_FALSE(lost_permanent);
+  EXPECT_THAT(set_.Snapshot(), ElementsAre(permanent));
+  EXPECT_EQ(set_.size(), 1);
+}
@@ -0,0 +1,75 @@
+#include <gmock/gmock.h>
+
+#include <prometheus/columnar_family.h>
+#include <prometheus/registry.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class ColumnarFamilyTest : public Test {
+ public:
+  static const io::prometheus::client::MetricFamily* Collected(
+      const builders_t& collected) {
+    return io::prometheus::client::GetMetricFamily(
+        collected.at(0)->GetBufferPointer());
+  }
+};
+
+TEST_F(ColumnarFamilyTest, counter_handles) {
+  ColumnarFamily<Counter> family{"requests", "", {}};
+  auto counter = family.Add({{"code", "200"}});
+  counter.Increment();
+  counter.Increment(2);
+  counter.Increment(-5);
+  EXPECT_EQ(counter.Value(), 3);
+  EXPECT_EQ(family.Add({{"code", "200"}}).Value(), 3);
+}
+
+TEST_F(ColumnarFamilyTest, gauge_handles) {
+  ColumnarFamily<Gauge> family{"queue_depth", "", {}};
+  auto gauge = family.Add({});
+  gauge.Set(5);
+  gauge.Decrement(2);
+  EXPECT_EQ(gauge.Value(), 3);
+}
+
+TEST_F(ColumnarFamilyTest, sum_over_many_series) {
+  ColumnarFamily<Counter> family{"requests", "", {}};
+  for (int i = 0; i < 5000; i++) {
+    family.Add({{"id", std::to_string(i)}}).Increment(i);
+  }
+  EXPECT_EQ(family.Sum(), 4999.0 * 5000 / 2);
+}
+
+TEST_F(ColumnarFamilyTest, collect_skips_removed_series) {
+  ColumnarFamily<Counter> family{"requests", "", {{"component", "test"}}};
+  auto first = family.Add({{"code", "200"}});
+  family.Add({{"code", "500"}}).Increment(7);
+  family.Remove(first);
+  auto collected = family.Collect();
+  auto metrics = Collected(collected)->metric();
+  ASSERT_EQ(metrics->size(), 1);
+  EXPECT_EQ(metrics->Get(0)->counter()->value(), 7);
+  ASSERT_EQ(metrics->Get(0)->label()->size(), 2);
+  EXPECT_EQ(metrics->Get(0)->label()->Get(1)->value()->str(), "500");
+}
+
+TEST_F(ColumnarFamilyTest, removed_slot_is_reused_zeroed) {
+  ColumnarFamily<Gauge> family{"queue_depth", "", {}};
+  auto first = family.Add({{"queue", "a"}});
+  first.Set(10);
+  family.Remove(first);
+  EXPECT_EQ(family.Add({{"queue", "b"}}).Value(), 0);
+  EXPECT_EQ(family.Sum(), 0);
+}
+
+TEST_F(ColumnarFamilyTest, register_through_builder) {
+  Registry registry;
+  auto& family =
+      BuildCounter().Name("columnar").Help("").RegisterColumnar(registry);
+  family.Add({}).Increment();
+  auto collected = registry.Collect();
+  ASSERT_EQ(collected.size(), 1);
+  EXPECT_EQ(Collected(collected)->type(),
+            io::prometheus::client::MetricType_COUNTER);
+}
@@ -31,3 +31,11 @@ TEST_F(CounterTest, inc_multiple) {
   counter.Increment(5);
   EXPECT_EQ(counter.Value(), 7.0);
 }
+
+TEST_F(CounterTest, inc_batch) {
+  Counter counter;
+  const double values[] = {1, 2, -5, 4};
+  counter.IncrementBatch(values, 4);
+  counter.IncrementBatch(values, 0);
+  EXPECT_EQ(counter.Value(), 7.0);
+}
@@ -0,0 +1,90 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/exposer.h>
+#include <prometheus/registry.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class ExposerTest : public Test {
+ public:
+  // Fetches /metrics and returns the whole response.
+  std::string Scrape() {
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(exposer_.GetListeningPorts().front());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    auto request = std::string{
+        "GET /metrics HTTP/1.1\r\nHost: localhost\r\n"
+        "Connection: close\r\n\r\n"};
+
+    auto response = std::string{};
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+            0 &&
+        send(fd, request.data(), request.size(), 0) ==
+            static_cast<ssize_t>(request.size())) {
+      char buffer[4096];
+      ssize_t bytes;
+      while ((bytes = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, bytes);
+      }
+    }
+    close(fd);
+    return response;
+  }
+
+  static std::string DurationSeries(const std::string& id) {
+    return "exposer_collectable_collect_duration{collectable=\"" + id + "\"}";
+  }
+
+  Exposer exposer_{"127.0.0.1:0"};
+};
+
+TEST_F(ExposerTest, stage_latencies_are_observed_on_every_scrape) {
+  Scrape();
+  // the second response reports the stages of the first scrape
+  auto response = Scrape();
+  for (auto stage : {"collect", "serialize", "write"}) {
+    EXPECT_THAT(response,
+                HasSubstr("exposer_scrape_stage_latencies_count{stage=\"" +
+                          std::string{stage} + "\"} 1\n"));
+  }
+}
+
+TEST_F(ExposerTest, collectable_ids_are_kept_when_others_are_removed) {
+  // ids 0 and 1 belong to the registries the exposer registers itself
+  auto first = std::make_shared<Registry>();
+  auto second = std::make_shared<Registry>();
+  exposer_.RegisterCollectable(first);
+  exposer_.RegisterCollectable(second);
+  exposer_.UnregisterCollectable(first);
+
+  auto response = Scrape();
+  EXPECT_THAT(response, Not(HasSubstr(DurationSeries("2"))));
+  EXPECT_THAT(response, HasSubstr(DurationSeries("3")));
+
+  auto third = std::make_shared<Registry>();
+  exposer_.RegisterCollectable(third);
+  response = Scrape();
+  EXPECT_THAT(response, Not(HasSubstr(DurationSeries("2"))));
+  EXPECT_THAT(response, HasSubstr(DurationSeries("3")));
+  EXPECT_THAT(response, HasSubstr(DurationSeries("4")));
+}
+
+TEST_F(ExposerTest, series_of_expired_collectable_is_removed) {
+  auto registry = std::make_shared<Registry>();
+  exposer_.RegisterCollectable(registry);
+  EXPECT_THAT(Scrape(), HasSubstr(DurationSeries("2")));
+
+  registry.reset();
+  EXPECT_THAT(Scrape(), Not(HasSubstr(DurationSeries("2"))));
+}
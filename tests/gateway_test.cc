@@ -0,0 +1,110 @@
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/gateway.h>
+#include <prometheus/registry.h>
+
+#include "http_stand_in.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class GatewayTest : public Test {
+ public:
+  GatewayTest() : registry_(std::make_shared<Registry>()) {
+    BuildCounter()
+        .Name("jobs_processed")
+        .Help("")
+        .Register(*registry_)
+        .Add({})
+        .Increment(3);
+    options_.initial_backoff = std::chrono::milliseconds{1};
+  }
+
+ protected:
+  HttpStandIn server_;
+  std::shared_ptr<Registry> registry_;
+  GatewayOptions options_;
+};
+
+TEST_F(GatewayTest, push_sends_text_format_to_group) {
+  Gateway gateway{server_.Url(), "batch", {{"instance", "a b"}}, options_};
+  gateway.RegisterCollectable(registry_);
+  EXPECT_TRUE(gateway.Push());
+  gateway.Flush();
+
+  auto requests = server_.Requests();
+  ASSERT_EQ(requests.size(), 1);
+  EXPECT_EQ(requests[0].method, "PUT");
+  EXPECT_EQ(requests[0].path, "/metrics/job/batch/instance/a%20b");
+  EXPECT_THAT(requests[0].body, HasSubstr("jobs_processed 3"));
+}
+
+TEST_F(GatewayTest, push_add_uses_post) {
+  Gateway gateway{server_.Url(), "batch", {}, options_};
+  gateway.RegisterCollectable(registry_);
+  gateway.PushAdd();
+  gateway.Flush();
+
+  auto requests = server_.Requests();
+  ASSERT_EQ(requests.size(), 1);
+  EXPECT_EQ(requests[0].method, "POST");
+}
+
+TEST_F(GatewayTest, retries_server_errors) {
+  server_.RespondWith({500, 503});
+  Gateway gateway{server_.Url(), "batch", {}, options_};
+  gateway.RegisterCollectable(registry_);
+  gateway.Push();
+  gateway.Flush();
+
+  EXPECT_EQ(server_.Requests().size(), 3);
+  EXPECT_EQ(gateway.FailedPushes(), 0);
+}
+
+TEST_F(GatewayTest, gives_up_after_max_retries) {
+  server_.RespondWith({500, 500, 500, 500});
+  options_.max_retries = 2;
+  Gateway gateway{server_.Url(), "batch", {}, options_};
+  gateway.Push();
+  gateway.Flush();
+
+  EXPECT_EQ(server_.Requests().size(), 3);
+  EXPECT_EQ(gateway.FailedPushes(), 1);
+}
+
+TEST_F(GatewayTest, does_not_retry_client_errors) {
+  server_.RespondWith({400});
+  Gateway gateway{server_.Url(), "batch", {}, options_};
+  gateway.Push();
+  gateway.Flush();
+
+  EXPECT_EQ(server_.Requests().size(), 1);
+  EXPECT_EQ(gateway.FailedPushes(), 1);
+}
+
+TEST_F(GatewayTest, destructor_sends_queued_pushes) {
+  {
+    Gateway gateway{server_.Url(), "batch", {}, options_};
+    gateway.RegisterCollectable(registry_);
+    gateway.Push();
+  }
+  EXPECT_EQ(server_.Requests().size(), 1);
+}
+
+TEST_F(GatewayTest, destructor_gives_up_at_shutdown_timeout) {
+  server_.RespondWith(std::vector<int>(100, 500));
+  options_.max_retries = 100;
+  options_.initial_backoff = std::chrono::milliseconds{1000};
+  options_.shutdown_timeout = std::chrono::milliseconds{100};
+  auto start = std::chrono::steady_clock::now();
+  {
+    Gateway gateway{server_.Url(), "batch", {}, options_};
+    gateway.Push();
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{1});
+  EXPECT_GE(server_.Requests().size(), 1);
+}
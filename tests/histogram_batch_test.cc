@@ -0,0 +1,87 @@
+#include <gmock/gmock.h>
+
+#include <limits>
+#include <vector>
+
+#include <prometheus/histogram.h>
+#include <prometheus/static_histogram.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class HistogramBatchTest : public Test {
+ public:
+  template <typename H>
+  static std::vector<std::uint64_t> CumulativeCounts(H& histogram,
+                                                     double* sum) {
+    auto labels = label_pair_t{};
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(histogram.Collect(&labels, &builder));
+    auto collected = flatbuffers::GetRoot<io::prometheus::client::Metric>(
+                         builder.GetBufferPointer())
+                         ->histogram();
+    *sum = collected->sample_sum();
+    auto counts = std::vector<std::uint64_t>{};
+    for (flatbuffers::uoffset_t i = 0; i < collected->bucket()->size(); ++i) {
+      counts.push_back(collected->bucket()->Get(i)->cumulative_count());
+    }
+    return counts;
+  }
+};
+
+TEST_F(HistogramBatchTest, batch_matches_single_observations) {
+  const auto values = std::vector<double>{
+      -1, 0, 1, 1.5, 2, 3, 100, std::numeric_limits<double>::infinity()};
+  Histogram single{{1, 2, 3}};
+  Histogram batch{{1, 2, 3}};
+  for (auto value : values) {
+    single.Observe(value);
+  }
+  batch.ObserveBatch(values.data(), values.size());
+
+  double single_sum;
+  double batch_sum;
+  EXPECT_EQ(CumulativeCounts(batch, &batch_sum),
+            CumulativeCounts(single, &single_sum));
+  EXPECT_EQ(batch_sum, single_sum);
+}
+
+TEST_F(HistogramBatchTest, empty_batch) {
+  Histogram histogram{{1}};
+  histogram.ObserveBatch(nullptr, 0);
+  double sum;
+  EXPECT_THAT(CumulativeCounts(histogram, &sum), ElementsAre(0, 0));
+  EXPECT_FALSE(histogram.ConsumeUpdated());
+}
+
+TEST_F(HistogramBatchTest, many_buckets_use_binary_search) {
+  auto bounds = Histogram::BucketBoundaries{};
+  for (int i = 0; i < 200; ++i) {
+    bounds.push_back(i);
+  }
+  Histogram single{bounds};
+  Histogram batch{bounds};
+  auto values = std::vector<double>{};
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(i * 0.25 - 10);
+  }
+  for (auto value : values) {
+    single.Observe(value);
+  }
+  batch.ObserveBatch(values.data(), values.size());
+
+  double single_sum;
+  double batch_sum;
+  EXPECT_EQ(CumulativeCounts(batch, &batch_sum),
+            CumulativeCounts(single, &single_sum));
+  EXPECT_DOUBLE_EQ(batch_sum, single_sum);
+}
+
+TEST_F(HistogramBatchTest, static_histogram_batch) {
+  StaticHistogram<Buckets<1, 2>> histogram;
+  const double values[] = {0.5, 1.5, 1.7, 5};
+  histogram.ObserveBatch(values, 4);
+  double sum;
+  EXPECT_THAT(CumulativeCounts(histogram, &sum), ElementsAre(1, 3, 4));
+  EXPECT_EQ(sum, 8.7);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP server on a loopback port that records every request and
+// answers with the queued status codes, 200 once they run out.
+class HttpStandIn {
+ public:
+  struct Request {
+    std::string method;
+    std::string path;
+    std::string body;
+  };
+
+  HttpStandIn() : fd_(socket(AF_INET, SOCK_STREAM, 0)) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+    listen(fd_, 16);
+    thread_ = std::thread{&HttpStandIn::Serve, this};
+  }
+
+  ~HttpStandIn() {
+    shutdown(fd_, SHUT_RDWR);
+    close(fd_);
+    thread_.join();
+  }
+
+  std::string Url() const {
+    return "http://127.0.0.1:" + std::to_string(port_);
+  }
+
+  void RespondWith(std::vector<int> statuses) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    statuses_.assign(statuses.begin(), statuses.end());
+  }
+
+  std::vector<Request> Requests() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return requests_;
+  }
+
+ private:
+  void Serve() {
+    for (;;) {
+      auto connection = accept(fd_, nullptr, nullptr);
+      if (connection < 0) {
+        return;
+      }
+      Handle(connection);
+      close(connection);
+    }
+  }
+
+  void Handle(int connection) {
+    std::string data;
+    char buffer[4096];
+    std::size_t header_end;
+    while ((header_end = data.find("\r\n\r\n")) == std::string::npos) {
+      auto bytes = recv(connection, buffer, sizeof(buffer), 0);
+      if (bytes <= 0) {
+        return;
+      }
+      data.append(buffer, bytes);
+    }
+    auto length_pos = data.find("Content-Length: ");
+    auto length = length_pos < header_end
+                      ? std::strtoul(data.c_str() + length_pos + 16, nullptr,
+                                     10)
+                      : 0;
+    while (data.size() < header_end + 4 + length) {
+      auto bytes = recv(connection, buffer, sizeof(buffer), 0);
+      if (bytes <= 0) {
+        return;
+      }
+      data.append(buffer, bytes);
+    }
+
+    auto request = Request{};
+    auto method_end = data.find(' ');
+    auto path_end = data.find(' ', method_end + 1);
+    request.method = data.substr(0, method_end);
+    request.path = data.substr(method_end + 1, path_end - method_end - 1);
+    request.body = data.substr(header_end + 4, length);
+
+    auto status = 200;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      requests_.push_back(request);
+      if (!statuses_.empty()) {
+        status = statuses_.front();
+        statuses_.pop_front();
+      }
+    }
+    auto response = "HTTP/1.1 " + std::to_string(status) +
+                    " Status\r\nContent-Length: 0\r\n\r\n";
+    send(connection, response.data(), response.size(), MSG_NOSIGNAL);
+  }
+
+  int fd_;
+  int port_;
+  std::mutex mutex_;
+  std::deque<int> statuses_;
+  std::vector<Request> requests_;
+  std::thread thread_;
+};
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/registry.h>
+
+#include "lib/self_metrics.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class IdleTimeoutTest : public Test {
+ public:
+  static std::size_t SeriesCount(Collectable& collectable) {
+    auto collected = collectable.Collect();
+    auto family = io::prometheus::client::GetMetricFamily(
+        collected.at(0)->GetBufferPointer());
+    return family->metric()->size();
+  }
+
+  Registry registry_;
+  // long enough for the background sweeper to stay out of the way
+  Family<Counter>& family_ = BuildCounter()
+                                 .Name("requests")
+                                 .Help("")
+                                 .IdleTimeout(std::chrono::hours(1))
+                                 .Register(registry_);
+};
+
+TEST_F(IdleTimeoutTest, keeps_fresh_series) {
+  family_.Add({{"client", "a"}});
+  auto now = std::chrono::steady_clock::now();
+  EXPECT_EQ(family_.EvictIdle(now), 0);
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(30)), 0);
+  EXPECT_EQ(SeriesCount(family_), 1);
+}
+
+TEST_F(IdleTimeoutTest, evicts_idle_series) {
+  auto& active = family_.Add({{"client", "a"}});
+  family_.Add({{"client", "b"}});
+  auto now = std::chrono::steady_clock::now();
+  family_.EvictIdle(now);
+
+  active.Increment();
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(61)), 1);
+  EXPECT_EQ(SeriesCount(family_), 1);
+  EXPECT_EQ(&family_.Add({{"client", "a"}}), &active);
+}
+
+TEST_F(IdleTimeoutTest, evicted_series_starts_over_on_add) {
+  family_.Add({{"client", "a"}}).Increment(3);
+  auto now = std::chrono::steady_clock::now();
+  family_.EvictIdle(now);
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(61)), 1);
+  EXPECT_EQ(SeriesCount(family_), 0);
+
+  EXPECT_EQ(family_.Add({{"client", "a"}}).Value(), 0);
+  EXPECT_EQ(SeriesCount(family_), 1);
+  // the idle period starts over with the next sweep
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(62)), 0);
+}
+
+TEST_F(IdleTimeoutTest, eviction_frees_storage) {
+  for (int i = 0; i < 1000; ++i) {
+    family_.Add({{"client", std::to_string(i)}});
+  }
+  auto now = std::chrono::steady_clock::now();
+  family_.EvictIdle(now);
+  auto capacity = family_.capacity();
+  EXPECT_GE(capacity, 1000);
+
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(61)), 1000);
+  EXPECT_EQ(SeriesCount(family_), 0);
+  EXPECT_LT(family_.capacity(), capacity);
+}
+
+TEST_F(IdleTimeoutTest, update_restarts_idle_period) {
+  auto& counter = family_.Add({{"client", "a"}});
+  auto now = std::chrono::steady_clock::now();
+  family_.EvictIdle(now);
+  counter.Increment();
+  family_.EvictIdle(now + std::chrono::minutes(50));
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(100)), 0);
+  EXPECT_EQ(family_.EvictIdle(now + std::chrono::minutes(111)), 1);
+}
+
+TEST_F(IdleTimeoutTest, without_timeout_nothing_is_evicted) {
+  auto& family = BuildGauge().Name("queue_depth").Help("").Register(registry_);
+  family.Add({{"queue", "a"}});
+  auto now = std::chrono::steady_clock::now();
+  family.EvictIdle(now);
+  EXPECT_EQ(family.EvictIdle(now + std::chrono::hours(24)), 0);
+}
+
+TEST_F(IdleTimeoutTest, background_sweeper_evicts_and_reports) {
+  auto& family = BuildCounter()
+                     .Name("short_lived")
+                     .Help("")
+                     .IdleTimeout(std::chrono::milliseconds(20))
+                     .Register(registry_);
+  family.Add({{"client", "a"}});
+  family.Add({{"client", "b"}});
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  EXPECT_EQ(SeriesCount(family), 0);
+  EXPECT_EQ(detail::EvictedSeriesCounter(registry_.Id(), "short_lived").Value(),
+            2);
+}
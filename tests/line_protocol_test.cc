@@ -0,0 +1,203 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/line_protocol_exporter.h>
+#include <prometheus/registry.h>
+
+#include "lib/line_protocol_serializer.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class LineProtocolTest : public Test {
+ public:
+  LineProtocolTest() : registry_(std::make_shared<Registry>()) {}
+
+  std::string Serialize() {
+    auto collected = registry_->Collect();
+    return LineProtocolSerializer{}.Serialize(collected);
+  }
+
+  // Binds a datagram socket on a loopback port and returns its address.
+  std::string ListenUdp() {
+    receiver_ = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(receiver_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(receiver_, reinterpret_cast<sockaddr*>(&address), &length);
+    return "udp://127.0.0.1:" + std::to_string(ntohs(address.sin_port));
+  }
+
+  std::vector<std::string> Received() {
+    auto datagrams = std::vector<std::string>{};
+    char buffer[65536];
+    for (;;) {
+      auto size = recv(receiver_, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (size < 0) {
+        return datagrams;
+      }
+      datagrams.emplace_back(buffer, size);
+    }
+  }
+
+  ~LineProtocolTest() {
+    if (receiver_ >= 0) {
+      close(receiver_);
+    }
+  }
+
+ protected:
+  std::shared_ptr<Registry> registry_;
+  int receiver_ = -1;
+};
+
+TEST_F(LineProtocolTest, serializes_counter_with_sorted_tags) {
+  BuildCounter()
+      .Name("requests")
+      .Help("")
+      .Labels({{"job", "api"}})
+      .Register(*registry_)
+      .Add({{"code", "200"}})
+      .Increment(7);
+  EXPECT_EQ(Serialize(), "requests,code=200,job=api counter=7\n");
+}
+
+TEST_F(LineProtocolTest, escapes_tags) {
+  BuildGauge()
+      .Name("temperature")
+      .Help("")
+      .Register(*registry_)
+      .Add({{"room", "a b,c=d"}, {"empty", ""}})
+      .Set(21.5);
+  EXPECT_EQ(Serialize(), "temperature,room=a\\ b\\,c\\=d gauge=21.5\n");
+}
+
+TEST_F(LineProtocolTest, escapes_backslashes) {
+  BuildGauge()
+      .Name("disk_usage")
+      .Help("")
+      .Register(*registry_)
+      .Add({{"path", "C:\\data\\"}})
+      .Set(1);
+  EXPECT_EQ(Serialize(), "disk_usage,path=C:\\\\data\\\\ gauge=1\n");
+}
+
+TEST_F(LineProtocolTest, line_breaks_do_not_end_the_line) {
+  BuildGauge()
+      .Name("temperature")
+      .Help("")
+      .Register(*registry_)
+      .Add({{"room", "a\nb\r\nc"}})
+      .Set(1);
+  EXPECT_EQ(Serialize(), "temperature,room=a\\nb\\r\\nc gauge=1\n");
+}
+
+TEST_F(LineProtocolTest, serializes_histogram_buckets_as_fields) {
+  BuildHistogram()
+      .Name("latency")
+      .Help("")
+      .Register(*registry_)
+      .Add({}, Histogram::BucketBoundaries{0.5, 1})
+      .Observe(0.7);
+  EXPECT_EQ(Serialize(), "latency count=1,sum=0.7,0.5=0,1=1\n");
+}
+
+TEST_F(LineProtocolTest, skips_values_without_representation) {
+  BuildGauge().Name("ratio").Help("").Register(*registry_).Add({}).Set(
+      std::numeric_limits<double>::quiet_NaN());
+  EXPECT_EQ(Serialize(), "");
+}
+
+TEST_F(LineProtocolTest, packs_lines_into_datagrams) {
+  auto& family = BuildGauge().Name("queue").Help("").Register(*registry_);
+  for (auto i = 0; i < 10; ++i) {
+    family.Add({{"id", std::to_string(i)}}).Set(i);
+  }
+  LineProtocolExporterOptions options;
+  options.interval = std::chrono::milliseconds{0};
+  // each line is "queue,id=N gauge=N\n", 19 bytes
+  options.max_datagram_size = 40;
+  LineProtocolExporter exporter{ListenUdp(), options};
+  exporter.RegisterCollectable(registry_);
+  exporter.SendNow();
+
+  auto datagrams = Received();
+  ASSERT_EQ(datagrams.size(), 5);
+  for (const auto& datagram : datagrams) {
+    EXPECT_LE(datagram.size(), options.max_datagram_size);
+    EXPECT_EQ(datagram.back(), '\n');
+  }
+  EXPECT_EQ(datagrams[0], "queue,id=0 gauge=0\nqueue,id=1 gauge=1\n");
+  EXPECT_EQ(exporter.SentDatagrams(), 5);
+}
+
+TEST_F(LineProtocolTest, drops_lines_larger_than_a_datagram) {
+  BuildGauge()
+      .Name("queue")
+      .Help("")
+      .Register(*registry_)
+      .Add({{"id", std::string(100, 'x')}});
+  LineProtocolExporterOptions options;
+  options.interval = std::chrono::milliseconds{0};
+  options.max_datagram_size = 64;
+  LineProtocolExporter exporter{ListenUdp(), options};
+  exporter.RegisterCollectable(registry_);
+  exporter.SendNow();
+
+  EXPECT_THAT(Received(), IsEmpty());
+  EXPECT_EQ(exporter.DroppedDatagrams(), 1);
+}
+
+TEST_F(LineProtocolTest, sends_to_unix_socket) {
+  BuildCounter().Name("requests").Help("").Register(*registry_).Add({});
+  auto path = "/tmp/line_protocol_test." + std::to_string(getpid());
+  receiver_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  ASSERT_EQ(bind(receiver_, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)),
+            0);
+
+  LineProtocolExporterOptions options;
+  options.interval = std::chrono::milliseconds{0};
+  LineProtocolExporter exporter{"unixgram://" + path, options};
+  exporter.RegisterCollectable(registry_);
+  exporter.SendNow();
+  unlink(path.c_str());
+
+  EXPECT_THAT(Received(), ElementsAre("requests counter=0\n"));
+}
+
+TEST_F(LineProtocolTest, sends_periodically) {
+  BuildCounter().Name("requests").Help("").Register(*registry_).Add({});
+  LineProtocolExporterOptions options;
+  options.interval = std::chrono::milliseconds{10};
+  {
+    LineProtocolExporter exporter{ListenUdp(), options};
+    exporter.RegisterCollectable(registry_);
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+  }
+  EXPECT_GT(Received().size(), 2);
+}
+
+TEST_F(LineProtocolTest, rejects_invalid_address) {
+  EXPECT_THROW(LineProtocolExporter{"tcp://localhost:8094"},
+               std::invalid_argument);
+  EXPECT_THROW(LineProtocolExporter{"udp://localhost"},
+               std::invalid_argument);
+}
@@ -0,0 +1,176 @@
+#include <chrono>
+#include <thread>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/local_recorder.h>
+#include <prometheus/registry.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class LocalRecorderTest : public Test {
+ public:
+  static LocalRecorderOptions ManualOptions() {
+    auto options = LocalRecorderOptions{};
+    options.max_staleness = std::chrono::steady_clock::duration::zero();
+    options.max_pending_updates = 0;
+    return options;
+  }
+
+  static std::uint64_t SampleCount(Histogram& histogram) {
+    auto labels = label_pair_t{};
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(histogram.Collect(&labels, &builder));
+    return flatbuffers::GetRoot<io::prometheus::client::Metric>(
+               builder.GetBufferPointer())
+        ->histogram()
+        ->sample_count();
+  }
+};
+
+TEST_F(LocalRecorderTest, counter_updates_stay_local_until_flush) {
+  Counter counter;
+  LocalCounter local{counter, ManualOptions()};
+  local.Increment();
+  local.Increment(2);
+  local.Increment(-4);
+  EXPECT_EQ(counter.Value(), 0);
+  local.Flush();
+  EXPECT_EQ(counter.Value(), 3);
+  local.Flush();
+  EXPECT_EQ(counter.Value(), 3);
+}
+
+TEST_F(LocalRecorderTest, threshold_publishes) {
+  Counter counter;
+  auto options = ManualOptions();
+  options.max_pending_updates = 3;
+  LocalCounter local{counter, options};
+  local.Increment();
+  local.Increment();
+  EXPECT_EQ(counter.Value(), 0);
+  local.Increment();
+  EXPECT_EQ(counter.Value(), 3);
+}
+
+TEST_F(LocalRecorderTest, destruction_publishes) {
+  Counter counter;
+  {
+    LocalCounter local{counter, ManualOptions()};
+    local.Increment(5);
+  }
+  EXPECT_EQ(counter.Value(), 5);
+}
+
+TEST_F(LocalRecorderTest, thread_exit_publishes) {
+  Counter counter;
+  std::thread{[&counter] {
+    static thread_local LocalCounter local{counter, ManualOptions()};
+    local.Increment(7);
+  }}.join();
+  EXPECT_EQ(counter.Value(), 7);
+}
+
+TEST_F(LocalRecorderTest, collect_publishes) {
+  Registry registry;
+  auto& counter =
+      BuildCounter().Name("requests").Help("").Register(registry).Add({});
+  LocalCounter local{counter, ManualOptions()};
+  local.Increment(4);
+  auto collected = registry.Collect();
+  auto family = io::prometheus::client::GetMetricFamily(
+      collected.at(0)->GetBufferPointer());
+  EXPECT_EQ(family->metric()->Get(0)->counter()->value(), 4);
+}
+
+TEST_F(LocalRecorderTest, staleness_bound_publishes_in_background) {
+  Counter counter;
+  auto options = ManualOptions();
+  options.max_staleness = std::chrono::milliseconds(20);
+  LocalCounter local{counter, options};
+  local.Increment();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (counter.Value() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(counter.Value(), 1);
+}
+
+TEST_F(LocalRecorderTest, histogram_matches_direct_observations) {
+  Histogram direct{{1, 2}};
+  Histogram combined{{1, 2}};
+  {
+    LocalHistogram local{combined, ManualOptions()};
+    for (auto value : {-1.0, 0.5, 1.0, 1.5, 3.0}) {
+      direct.Observe(value);
+      local.Observe(value);
+    }
+    EXPECT_EQ(SampleCount(combined), 5);
+  }
+  auto labels = label_pair_t{};
+  flatbuffers::FlatBufferBuilder direct_builder;
+  flatbuffers::FlatBufferBuilder combined_builder;
+  direct_builder.Finish(direct.Collect(&labels, &direct_builder));
+  combined_builder.Finish(combined.Collect(&labels, &combined_builder));
+  auto direct_histogram =
+      flatbuffers::GetRoot<io::prometheus::client::Metric>(
+          direct_builder.GetBufferPointer())
+          ->histogram();
+  auto combined_histogram =
+      flatbuffers::GetRoot<io::prometheus::client::Metric>(
+          combined_builder.GetBufferPointer())
+          ->histogram();
+  EXPECT_EQ(combined_histogram->sample_sum(), direct_histogram->sample_sum());
+  for (flatbuffers::uoffset_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(combined_histogram->bucket()->Get(i)->cumulative_count(),
+              direct_histogram->bucket()->Get(i)->cumulative_count());
+  }
+}
+
+TEST_F(LocalRecorderTest, records_while_background_flusher_runs) {
+  Counter counter;
+  Histogram histogram{{1, 2}};
+  auto options = LocalRecorderOptions{};
+  options.max_staleness = std::chrono::milliseconds(2);
+  options.max_pending_updates = 1000;
+  {
+    LocalCounter local_counter{counter, options};
+    LocalHistogram local_histogram{histogram, options};
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+    auto recorded = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+      local_counter.Increment();
+      local_histogram.Observe(1.5);
+      // slow enough that both the threshold and the staleness bound publish
+      if (++recorded % 50 == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+    local_counter.Flush();
+    EXPECT_EQ(counter.Value(), recorded);
+  }
+  EXPECT_EQ(SampleCount(histogram),
+            static_cast<std::uint64_t>(counter.Value()));
+}
+
+TEST_F(LocalRecorderTest, many_threads_one_counter) {
+  Counter counter;
+  auto threads = std::vector<std::thread>{};
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&counter] {
+      auto options = LocalRecorderOptions{};
+      options.max_staleness = std::chrono::milliseconds(5);
+      options.max_pending_updates = 100;
+      LocalCounter local{counter, options};
+      for (int i = 0; i < 10000; ++i) {
+        local.Increment();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(counter.Value(), 40000);
+}
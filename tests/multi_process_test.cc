@@ -0,0 +1,231 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/counter_builder.h>
+#include <prometheus/gauge_builder.h>
+#include <prometheus/histogram_builder.h>
+#include <prometheus/multi_process.h>
+
+#include "lib/text_serializer.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class MultiProcessTest : public Test {
+ public:
+  MultiProcessTest() {
+    char directory[] = "/tmp/multi_process_test.XXXXXX";
+    directory_ = mkdtemp(directory);
+  }
+
+  ~MultiProcessTest() {
+    StopWorkers();
+    std::system(("rm -rf " + directory_).c_str());
+  }
+
+  // Forks a worker that sets up its segment with `setup` and keeps running
+  // until StopWorkers().
+  void StartWorker(const std::function<void(SharedMemorySegment&)>& setup) {
+    int ready[2];
+    int release[2];
+    ASSERT_EQ(pipe(ready), 0);
+    ASSERT_EQ(pipe(release), 0);
+    auto pid = fork();
+    if (pid == 0) {
+      close(ready[0]);
+      close(release[1]);
+      // other workers must see their release pipe close
+      for (auto& worker : workers_) {
+        close(worker.second);
+      }
+      auto segment = CreateWorkerSegment(directory_, 1 << 16);
+      setup(*segment);
+      char byte = 0;
+      write(ready[1], &byte, 1);
+      read(release[0], &byte, 1);
+      _exit(0);
+    }
+    close(ready[1]);
+    close(release[0]);
+    char byte;
+    read(ready[0], &byte, 1);
+    close(ready[0]);
+    workers_.push_back({pid, release[1]});
+  }
+
+  // Forks a worker that sets up its segment and exits right away.
+  void RunWorker(const std::function<void(SharedMemorySegment&)>& setup) {
+    auto pid = fork();
+    if (pid == 0) {
+      auto segment = CreateWorkerSegment(directory_, 1 << 16);
+      setup(*segment);
+      _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+  }
+
+  void StopWorkers() {
+    for (auto& worker : workers_) {
+      close(worker.second);
+      waitpid(worker.first, nullptr, 0);
+    }
+    workers_.clear();
+  }
+
+  std::string Text(MultiProcessCollector& collector) {
+    auto collected = collector.Collect();
+    return TextSerializer{}.Serialize(collected);
+  }
+
+  static std::function<void(SharedMemorySegment&)> CountRequests(
+      double value) {
+    return [value](SharedMemorySegment& segment) {
+      BuildCounter()
+          .Name("requests")
+          .Help("")
+          .RegisterShared(segment)
+          .Add({{"code", "200"}})
+          .Increment(value);
+    };
+  }
+
+  static std::function<void(SharedMemorySegment&)> SetGauges(double value) {
+    return [value](SharedMemorySegment& segment) {
+      for (auto name : {"g_sum", "g_min", "g_max", "g_latest", "g_all"}) {
+        auto& family =
+            BuildGauge().Name(name).Help("").RegisterShared(segment);
+        family.Add({}).Set(value);
+      }
+    };
+  }
+
+ protected:
+  std::string directory_;
+  std::vector<std::pair<pid_t, int>> workers_;
+};
+
+TEST_F(MultiProcessTest, sums_counters_of_workers) {
+  StartWorker(CountRequests(2));
+  StartWorker(CountRequests(3));
+
+  MultiProcessCollector collector{directory_};
+  EXPECT_THAT(Text(collector), HasSubstr("requests{code=\"200\"} 5"));
+}
+
+TEST_F(MultiProcessTest, sums_histograms_of_workers) {
+  auto observe = [](double value) {
+    return [value](SharedMemorySegment& segment) {
+      BuildHistogram()
+          .Name("latency")
+          .Help("")
+          .RegisterShared(segment)
+          .Add({}, Histogram::BucketBoundaries{1})
+          .Observe(value);
+    };
+  };
+  StartWorker(observe(0.5));
+  StartWorker(observe(2));
+
+  MultiProcessCollector collector{directory_};
+  auto text = Text(collector);
+  EXPECT_THAT(text, HasSubstr("latency_count 2"));
+  EXPECT_THAT(text, HasSubstr("latency_sum 2.5"));
+  EXPECT_THAT(text, HasSubstr("latency_bucket{le=\"1.000000\"} 1"));
+}
+
+TEST_F(MultiProcessTest, keeps_counts_of_exited_workers) {
+  MultiProcessCollector collector{directory_};
+  RunWorker(CountRequests(2));
+  StartWorker(CountRequests(3));
+
+  EXPECT_THAT(Text(collector), HasSubstr("requests{code=\"200\"} 5"));
+  // a restarted worker starts from zero, the total does not
+  RunWorker(CountRequests(1));
+  EXPECT_THAT(Text(collector), HasSubstr("requests{code=\"200\"} 6"));
+  StopWorkers();
+  EXPECT_THAT(Text(collector), HasSubstr("requests{code=\"200\"} 6"));
+  EXPECT_THAT(Text(collector), HasSubstr("requests{code=\"200\"} 6"));
+}
+
+TEST_F(MultiProcessTest, removes_files_of_exited_workers) {
+  MultiProcessCollector collector{directory_};
+  RunWorker(CountRequests(2));
+  Text(collector);
+
+  auto listing = "test -z \"$(ls " + directory_ + ")\"";
+  EXPECT_EQ(std::system(listing.c_str()), 0);
+}
+
+TEST_F(MultiProcessTest, combines_gauges_by_mode) {
+  StartWorker(SetGauges(1));
+  StartWorker(SetGauges(5));
+  StartWorker(SetGauges(3));
+
+  MultiProcessOptions options;
+  options.gauge_modes = {{"g_min", GaugeMode::kMin},
+                         {"g_max", GaugeMode::kMax},
+                         {"g_latest", GaugeMode::kLatest},
+                         {"g_all", GaugeMode::kPerProcess}};
+  MultiProcessCollector collector{directory_, options};
+  auto text = Text(collector);
+  EXPECT_THAT(text, HasSubstr("g_sum 9"));
+  EXPECT_THAT(text, HasSubstr("g_min 1"));
+  EXPECT_THAT(text, HasSubstr("g_max 5"));
+  EXPECT_THAT(text, HasSubstr("g_latest 3"));
+  auto pid = std::to_string(workers_[1].first);
+  EXPECT_THAT(text, HasSubstr("g_all{pid=\"" + pid + "\"} 5"));
+}
+
+TEST_F(MultiProcessTest, drops_gauges_of_exited_workers) {
+  StartWorker(SetGauges(1));
+  RunWorker(SetGauges(5));
+
+  MultiProcessCollector collector{directory_};
+  EXPECT_THAT(Text(collector), HasSubstr("g_sum 1"));
+}
+
+TEST_F(MultiProcessTest, per_process_gauge_keeps_its_own_pid_label) {
+  StartWorker([](SharedMemorySegment& segment) {
+    BuildGauge()
+        .Name("connections")
+        .Help("")
+        .RegisterShared(segment)
+        .Add({{"pid", "upstream"}})
+        .Set(2);
+  });
+
+  MultiProcessOptions options;
+  options.default_gauge_mode = GaugeMode::kPerProcess;
+  MultiProcessCollector collector{directory_, options};
+  auto pid = std::to_string(workers_[0].first);
+  EXPECT_THAT(Text(collector),
+              HasSubstr("connections{pid=\"upstream\",worker_pid=\"" + pid +
+                        "\"} 2"));
+}
+
+TEST_F(MultiProcessTest, counts_records_with_incompatible_buckets) {
+  auto observe = [](const Histogram::BucketBoundaries& buckets) {
+    return [buckets](SharedMemorySegment& segment) {
+      BuildHistogram()
+          .Name("latency")
+          .Help("")
+          .RegisterShared(segment)
+          .Add({}, buckets)
+          .Observe(0.5);
+    };
+  };
+  StartWorker(observe({1}));
+  StartWorker(observe({1, 2}));
+
+  MultiProcessCollector collector{directory_};
+  EXPECT_THAT(Text(collector), HasSubstr("latency_count 1"));
+  EXPECT_EQ(collector.DroppedRecords(), 1);
+}
@@ -0,0 +1,78 @@
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/process_collector.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class ProcessCollectorTest : public Test {
+ public:
+  static double Value(const builders_t& collected, const std::string& name) {
+    for (auto& bld : collected) {
+      auto family =
+          io::prometheus::client::GetMetricFamily(bld->GetBufferPointer());
+      if (family->name()->str() == name) {
+        auto metric = family->metric()->Get(0);
+        return family->type() == io::prometheus::client::MetricType_COUNTER
+                   ? metric->counter()->value()
+                   : metric->gauge()->value();
+      }
+    }
+    return -1;
+  }
+};
+
+TEST_F(ProcessCollectorTest, collects_process_metrics) {
+  ProcessCollector collector;
+  auto collected = collector.Collect();
+  EXPECT_GE(Value(collected, "process_cpu_seconds_total"), 0);
+  EXPECT_GT(Value(collected, "process_resident_memory_bytes"), 0);
+  EXPECT_GT(Value(collected, "process_virtual_memory_bytes"), 0);
+  EXPECT_GT(Value(collected, "process_open_fds"), 0);
+  EXPECT_GT(Value(collected, "process_start_time_seconds"), 1e9);
+}
+
+TEST_F(ProcessCollectorTest, counts_new_file_descriptors) {
+  ProcessCollector collector;
+  auto before = Value(collector.Collect(), "process_open_fds");
+  auto fd = open("/dev/null", O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(Value(collector.Collect(), "process_open_fds"), before + 1);
+  close(fd);
+}
+
+TEST_F(ProcessCollectorTest, throttles_reads_within_min_interval) {
+  ProcessCollector collector{std::chrono::hours{1}};
+  auto before = Value(collector.Collect(), "process_open_fds");
+  auto fd = open("/dev/null", O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(Value(collector.Collect(), "process_open_fds"), before);
+  close(fd);
+}
+
+TEST_F(ProcessCollectorTest, forked_child_reports_its_own_process) {
+  ProcessCollector collector;
+  auto parent_fds = Value(collector.Collect(), "process_open_fds");
+
+  auto pid = fork();
+  if (pid == 0) {
+    auto fds = std::vector<int>{};
+    for (int i = 0; i < 20; ++i) {
+      fds.push_back(open("/dev/null", O_RDONLY));
+    }
+    auto child_fds = Value(collector.Collect(), "process_open_fds");
+    _exit(child_fds >= parent_fds + 20 ? 0 : 1);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
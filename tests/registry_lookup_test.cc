@@ -0,0 +1,55 @@
+#include <stdexcept>
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/columnar_family.h>
+#include <prometheus/registry.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class RegistryLookupTest : public Test {};
+
+TEST_F(RegistryLookupTest, repeated_registration_returns_same_family) {
+  Registry registry;
+  auto& first = BuildCounter().Name("requests").Help("").Register(registry);
+  auto& second = BuildCounter().Name("requests").Help("").Register(registry);
+  EXPECT_EQ(&first, &second);
+  EXPECT_EQ(registry.Collect().size(), 1);
+}
+
+TEST_F(RegistryLookupTest, many_families_stay_reachable) {
+  Registry registry;
+  for (auto i = 0; i < 1000; i++) {
+    BuildGauge().Name("gauge_" + std::to_string(i)).Help("").Register(registry);
+  }
+  auto& family = BuildGauge().Name("gauge_500").Help("").Register(registry);
+  family.Add({}).Set(1);
+  EXPECT_EQ(registry.Collect().size(), 1000);
+}
+
+TEST_F(RegistryLookupTest, type_mismatch_throws) {
+  Registry registry;
+  BuildCounter().Name("requests").Help("").Register(registry);
+  EXPECT_THROW(BuildGauge().Name("requests").Help("").Register(registry),
+               std::invalid_argument);
+  EXPECT_THROW(
+      BuildCounter().Name("requests").Help("").RegisterColumnar(registry),
+      std::invalid_argument);
+}
+
+TEST_F(RegistryLookupTest, constant_label_mismatch_throws) {
+  Registry registry;
+  BuildCounter()
+      .Name("requests")
+      .Help("")
+      .Labels({{"component", "a"}})
+      .Register(registry);
+  EXPECT_THROW(BuildCounter()
+                   .Name("requests")
+                   .Help("")
+                   .Labels({{"component", "b"}})
+                   .Register(registry),
+               std::invalid_argument);
+}
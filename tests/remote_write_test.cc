@@ -0,0 +1,264 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/registry.h>
+#include <prometheus/remote_write.h>
+
+#include "http_stand_in.h"
+#include "lib/snappy.h"
+
+using namespace testing;
+using namespace prometheus;
+
+namespace {
+
+struct DecodedSeries {
+  std::map<std::string, std::string> labels;
+  double value;
+  std::int64_t timestamp_ms;
+};
+
+// Just enough of a protobuf reader to take a WriteRequest apart.
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : data_(data) {}
+
+  bool Done() const { return position_ >= data_.size(); }
+
+  std::uint64_t Varint() {
+    std::uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      auto byte = static_cast<unsigned char>(data_[position_++]);
+      value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        return value;
+      }
+    }
+  }
+
+  std::string Bytes() {
+    auto length = Varint();
+    auto bytes = data_.substr(position_, length);
+    position_ += length;
+    return bytes;
+  }
+
+  double Fixed64() {
+    double value;
+    std::memcpy(&value, data_.data() + position_, sizeof(value));
+    position_ += sizeof(value);
+    return value;
+  }
+
+ private:
+  const std::string data_;
+  std::size_t position_ = 0;
+};
+
+std::vector<DecodedSeries> DecodeWriteRequest(const std::string& body) {
+  auto decoded = std::vector<DecodedSeries>{};
+  Reader request{body};
+  while (!request.Done()) {
+    EXPECT_EQ(request.Varint(), (1 << 3) | 2);
+    Reader timeseries{request.Bytes()};
+    DecodedSeries series{};
+    while (!timeseries.Done()) {
+      auto tag = timeseries.Varint();
+      Reader message{timeseries.Bytes()};
+      if (tag == ((1 << 3) | 2)) {
+        EXPECT_EQ(message.Varint(), (1 << 3) | 2);
+        auto name = message.Bytes();
+        EXPECT_EQ(message.Varint(), (2 << 3) | 2);
+        series.labels[name] = message.Bytes();
+      } else {
+        EXPECT_EQ(message.Varint(), (1 << 3) | 1);
+        series.value = message.Fixed64();
+        EXPECT_EQ(message.Varint(), (2 << 3) | 0);
+        series.timestamp_ms = message.Varint();
+      }
+    }
+    decoded.push_back(series);
+  }
+  return decoded;
+}
+}  // namespace
+
+class RemoteWriteTest : public Test {
+ public:
+  RemoteWriteTest() : registry_(std::make_shared<Registry>()) {
+    options_.interval = std::chrono::milliseconds{0};
+    options_.shards = 1;
+    options_.initial_backoff = std::chrono::milliseconds{1};
+  }
+
+  std::vector<DecodedSeries> SentSeries() {
+    auto series = std::vector<DecodedSeries>{};
+    for (const auto& request : server_.Requests()) {
+      auto body = std::string{};
+      EXPECT_TRUE(detail::SnappyUncompress(request.body, &body));
+      auto decoded = DecodeWriteRequest(body);
+      series.insert(series.end(), decoded.begin(), decoded.end());
+    }
+    return series;
+  }
+
+ protected:
+  HttpStandIn server_;
+  std::shared_ptr<Registry> registry_;
+  RemoteWriteOptions options_;
+};
+
+TEST_F(RemoteWriteTest, sends_counter_with_labels) {
+  BuildCounter()
+      .Name("requests")
+      .Help("")
+      .Labels({{"job", "api"}})
+      .Register(*registry_)
+      .Add({{"code", "200"}})
+      .Increment(7);
+  RemoteWriteExporter exporter{server_.Url() + "/api/v1/write", options_};
+  exporter.RegisterCollectable(registry_);
+  exporter.CollectNow();
+  exporter.Flush();
+
+  auto requests = server_.Requests();
+  ASSERT_EQ(requests.size(), 1);
+  EXPECT_EQ(requests[0].method, "POST");
+  EXPECT_EQ(requests[0].path, "/api/v1/write");
+
+  auto series = SentSeries();
+  ASSERT_EQ(series.size(), 1);
+  EXPECT_THAT(series[0].labels, ElementsAre(Pair("__name__", "requests"),
+                                            Pair("code", "200"),
+                                            Pair("job", "api")));
+  EXPECT_EQ(series[0].value, 7);
+  EXPECT_GT(series[0].timestamp_ms, 0);
+}
+
+TEST_F(RemoteWriteTest, flattens_histogram) {
+  BuildHistogram()
+      .Name("latency")
+      .Help("")
+      .Register(*registry_)
+      .Add({}, Histogram::BucketBoundaries{0.5, 1})
+      .Observe(0.7);
+  RemoteWriteExporter exporter{server_.Url(), options_};
+  exporter.RegisterCollectable(registry_);
+  exporter.CollectNow();
+  exporter.Flush();
+
+  auto values = std::map<std::string, double>{};
+  for (const auto& series : SentSeries()) {
+    auto name = series.labels.at("__name__");
+    if (series.labels.count("le")) {
+      name += "{le=" + series.labels.at("le") + "}";
+    }
+    values[name] = series.value;
+  }
+  EXPECT_THAT(values, ElementsAre(Pair("latency_bucket{le=+Inf}", 1),
+                                  Pair("latency_bucket{le=0.5}", 0),
+                                  Pair("latency_bucket{le=1}", 1),
+                                  Pair("latency_count", 1),
+                                  Pair("latency_sum", 0.7)));
+}
+
+TEST_F(RemoteWriteTest, splits_into_batches) {
+  auto& family = BuildGauge().Name("queue").Help("").Register(*registry_);
+  for (auto i = 0; i < 5; ++i) {
+    family.Add({{"id", std::to_string(i)}}).Set(i);
+  }
+  options_.max_samples_per_send = 2;
+  RemoteWriteExporter exporter{server_.Url(), options_};
+  exporter.RegisterCollectable(registry_);
+  exporter.CollectNow();
+  exporter.Flush();
+
+  EXPECT_EQ(server_.Requests().size(), 3);
+  EXPECT_EQ(SentSeries().size(), 5);
+}
+
+TEST_F(RemoteWriteTest, spreads_series_over_shards) {
+  auto& family = BuildGauge().Name("queue").Help("").Register(*registry_);
+  for (auto i = 0; i < 20; ++i) {
+    family.Add({{"id", std::to_string(i)}}).Set(i);
+  }
+  options_.shards = 4;
+  RemoteWriteExporter exporter{server_.Url(), options_};
+  exporter.RegisterCollectable(registry_);
+  exporter.CollectNow();
+  exporter.Flush();
+
+  EXPECT_GT(server_.Requests().size(), 1);
+  EXPECT_EQ(SentSeries().size(), 20);
+}
+
+TEST_F(RemoteWriteTest, retries_server_errors) {
+  BuildCounter().Name("requests").Help("").Register(*registry_).Add({});
+  server_.RespondWith({500, 429});
+  RemoteWriteExporter exporter{server_.Url(), options_};
+  exporter.RegisterCollectable(registry_);
+  exporter.CollectNow();
+  exporter.Flush();
+
+  EXPECT_EQ(server_.Requests().size(), 3);
+  EXPECT_EQ(exporter.FailedBatches(), 0);
+}
+
+TEST_F(RemoteWriteTest, gives_up_on_client_errors) {
+  BuildCounter().Name("requests").Help("").Register(*registry_).Add({});
+  server_.RespondWith({400});
+  RemoteWriteExporter exporter{server_.Url(), options_};
+  exporter.RegisterCollectable(registry_);
+  exporter.CollectNow();
+  exporter.Flush();
+
+  EXPECT_EQ(server_.Requests().size(), 1);
+  EXPECT_EQ(exporter.FailedBatches(), 1);
+}
+
+TEST_F(RemoteWriteTest, destructor_sends_final_collection) {
+  BuildCounter().Name("requests").Help("").Register(*registry_).Add({});
+  {
+    RemoteWriteExporter exporter{server_.Url(), options_};
+    exporter.RegisterCollectable(registry_);
+  }
+  EXPECT_EQ(server_.Requests().size(), 1);
+}
+
+TEST_F(RemoteWriteTest, destructor_gives_up_at_shutdown_timeout) {
+  auto& family = BuildCounter().Name("requests").Help("").Register(*registry_);
+  for (auto path : {"/a", "/b", "/c"}) {
+    family.Add({{"path", path}});
+  }
+  server_.RespondWith(std::vector<int>(100, 500));
+  options_.max_samples_per_send = 1;
+  options_.max_retries = 100;
+  options_.initial_backoff = std::chrono::milliseconds{1000};
+  options_.shutdown_timeout = std::chrono::milliseconds{100};
+  auto start = std::chrono::steady_clock::now();
+  {
+    RemoteWriteExporter exporter{server_.Url(), options_};
+    exporter.RegisterCollectable(registry_);
+    exporter.CollectNow();
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{1});
+  EXPECT_GE(server_.Requests().size(), 1);
+}
+
+TEST_F(RemoteWriteTest, collects_periodically) {
+  BuildCounter().Name("requests").Help("").Register(*registry_).Add({});
+  options_.interval = std::chrono::milliseconds{10};
+  {
+    RemoteWriteExporter exporter{server_.Url(), options_};
+    exporter.RegisterCollectable(registry_);
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+  }
+  EXPECT_GT(server_.Requests().size(), 2);
+}
@@ -0,0 +1,70 @@
+#include <gmock/gmock.h>
+
+#include <prometheus/collectable.h>
+#include <prometheus/sampling_marker.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class SamplingMarkerTest : public Test {};
+
+static double TotalWeight(FixedRateSampler& sampler, int calls) {
+  double weight = 0;
+  for (int i = 0; i < calls; i++) {
+    weight += sampler.Sample();
+  }
+  return weight;
+}
+
+TEST_F(SamplingMarkerTest, rate_one_samples_every_call) {
+  FixedRateSampler sampler{1};
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(sampler.Sample(), 1);
+  }
+}
+
+TEST_F(SamplingMarkerTest, fixed_rate_is_unbiased) {
+  FixedRateSampler sampler{16};
+  const auto calls = 1000000;
+  EXPECT_THAT(TotalWeight(sampler, calls), DoubleNear(calls, calls * 0.05));
+}
+
+TEST_F(SamplingMarkerTest, adaptive_starts_by_sampling_every_call) {
+  AdaptiveSampler sampler{100};
+  EXPECT_EQ(sampler.Rate(), 1);
+  EXPECT_EQ(sampler.Sample(), 1);
+}
+
+TEST_F(SamplingMarkerTest, adaptive_lowers_rate_above_budget) {
+  AdaptiveSampler sampler{100};
+  auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10000; i++) {
+    sampler.Sampled(now);
+  }
+  sampler.Sampled(now + std::chrono::seconds(1));
+  EXPECT_THAT(sampler.Rate(), Ge(50));
+}
+
+TEST_F(SamplingMarkerTest, weighted_observation) {
+  Histogram histogram{{1}};
+  histogram.Observe(0.5, 4);
+  auto builder = make_bld_t();
+  auto labels = label_pair_t{};
+  builder->Finish(histogram.Collect(&labels, builder.get()));
+  auto metric = flatbuffers::GetRoot<io::prometheus::client::Metric>(
+      builder->GetBufferPointer());
+  EXPECT_EQ(metric->histogram()->sample_count(), 4);
+  EXPECT_EQ(metric->histogram()->sample_sum(), 2);
+}
+
+TEST_F(SamplingMarkerTest, marker_records_weight) {
+  Histogram histogram{{}};
+  FixedRateSampler sampler{1};
+  { SamplingMarker<FixedRateSampler> marker{histogram, sampler}; }
+  auto builder = make_bld_t();
+  auto labels = label_pair_t{};
+  builder->Finish(histogram.Collect(&labels, builder.get()));
+  auto metric = flatbuffers::GetRoot<io::prometheus::client::Metric>(
+      builder->GetBufferPointer());
+  EXPECT_EQ(metric->histogram()->sample_count(), 1);
+}
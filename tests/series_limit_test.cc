@@ -0,0 +1,142 @@
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <limits>
+#include <string>
+
+#include <prometheus/registry.h>
+
+#include "lib/self_metrics.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class SeriesLimitTest : public Test {
+ public:
+  // Number of self-metric series labeled with the registry `id`.
+  static std::size_t SelfMetricSeries(const std::string& id) {
+    std::size_t count = 0;
+    for (const auto& collected : detail::SelfMetricsRegistry()->Collect()) {
+      auto metrics = io::prometheus::client::GetMetricFamily(
+                         collected->GetBufferPointer())
+                         ->metric();
+      for (flatbuffers::uoffset_t i = 0; i < metrics->size(); ++i) {
+        auto labels = metrics->Get(i)->label();
+        for (flatbuffers::uoffset_t j = 0; j < labels->size(); ++j) {
+          if (labels->Get(j)->value()->str() == id) {
+            ++count;
+          }
+        }
+      }
+    }
+    return count;
+  }
+
+  Registry registry_;
+};
+
+TEST_F(SeriesLimitTest, existing_series_are_returned_at_the_limit) {
+  auto& family = BuildCounter()
+                     .Name("limited_a")
+                     .Help("")
+                     .MaxSeries(2)
+                     .Register(registry_);
+  auto& first = family.Add({{"id", "1"}});
+  auto& second = family.Add({{"id", "2"}});
+  EXPECT_EQ(&family.Add({{"id", "1"}}), &first);
+  EXPECT_EQ(&family.Add({{"id", "2"}}), &second);
+  EXPECT_EQ(detail::FamilyOverflowCounter(registry_.Id(), "limited_a").Value(),
+            0);
+}
+
+TEST_F(SeriesLimitTest, new_series_go_to_overflow) {
+  auto& family = BuildCounter()
+                     .Name("limited_b")
+                     .Help("")
+                     .MaxSeries(1)
+                     .Register(registry_);
+  auto& first = family.Add({{"id", "1"}});
+  auto& overflow = family.Add({{"id", "2"}});
+  EXPECT_NE(&overflow, &first);
+  EXPECT_EQ(&family.Add({{"id", "3"}}), &overflow);
+  EXPECT_EQ(&family.Add(Family<Counter>::OverflowLabels()), &overflow);
+  EXPECT_EQ(detail::FamilyOverflowCounter(registry_.Id(), "limited_b").Value(),
+            2);
+  EXPECT_EQ(detail::FamilySeriesGauge(registry_.Id(), "limited_b").Value(), 2);
+}
+
+TEST_F(SeriesLimitTest, removal_frees_room) {
+  auto& family =
+      BuildGauge().Name("limited_c").Help("").MaxSeries(1).Register(registry_);
+  auto& first = family.Add({{"id", "1"}});
+  family.Remove(&first);
+  EXPECT_EQ(detail::FamilySeriesGauge(registry_.Id(), "limited_c").Value(), 0);
+  auto& second = family.Add({{"id", "2"}});
+  EXPECT_NE(&second, &family.Add({{"id", "3"}}));
+  EXPECT_EQ(detail::FamilyOverflowCounter(registry_.Id(), "limited_c").Value(),
+            1);
+}
+
+TEST_F(SeriesLimitTest, histogram_overflow_uses_given_buckets) {
+  auto& family = BuildHistogram()
+                     .Name("limited_d")
+                     .Help("")
+                     .MaxSeries(1)
+                     .Register(registry_);
+  family.Add({{"id", "1"}}, Histogram::BucketBoundaries{1, 2});
+  auto& overflow = family.Add({{"id", "2"}}, Histogram::BucketBoundaries{1, 2});
+  overflow.Observe(1.5);
+
+  auto labels = label_pair_t{};
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(overflow.Collect(&labels, &builder));
+  auto buckets = flatbuffers::GetRoot<io::prometheus::client::Metric>(
+                     builder.GetBufferPointer())
+                     ->histogram()
+                     ->bucket();
+  ASSERT_EQ(buckets->size(), 3);
+  EXPECT_EQ(buckets->Get(0)->upper_bound(), 1);
+  EXPECT_EQ(buckets->Get(1)->upper_bound(), 2);
+  EXPECT_EQ(buckets->Get(1)->cumulative_count(), 1);
+  EXPECT_EQ(buckets->Get(2)->upper_bound(),
+            std::numeric_limits<double>::infinity());
+}
+
+TEST_F(SeriesLimitTest, self_metrics_are_kept_per_registry) {
+  Registry other;
+  auto& family = BuildCounter()
+                     .Name("limited_e")
+                     .Help("")
+                     .MaxSeries(1)
+                     .Register(registry_);
+  auto& other_family =
+      BuildCounter().Name("limited_e").Help("").MaxSeries(5).Register(other);
+  family.Add({{"id", "1"}});
+  family.Add({{"id", "2"}});
+  other_family.Add({{"id", "1"}});
+  EXPECT_NE(registry_.Id(), other.Id());
+  EXPECT_EQ(detail::FamilyOverflowCounter(registry_.Id(), "limited_e").Value(),
+            1);
+  EXPECT_EQ(detail::FamilyOverflowCounter(other.Id(), "limited_e").Value(), 0);
+  EXPECT_EQ(detail::FamilySeriesGauge(registry_.Id(), "limited_e").Value(), 2);
+  EXPECT_EQ(detail::FamilySeriesGauge(other.Id(), "limited_e").Value(), 1);
+}
+
+TEST_F(SeriesLimitTest, destroyed_family_removes_its_self_metrics) {
+  std::string id;
+  {
+    Registry registry;
+    id = registry.Id();
+    auto& family = BuildCounter()
+                       .Name("limited_f")
+                       .Help("")
+                       .MaxSeries(1)
+                       .IdleTimeout(std::chrono::hours(1))
+                       .Register(registry);
+    family.Add({{"id", "1"}});
+    family.Add({{"id", "2"}});
+    detail::EvictedSeriesCounter(id, "limited_f").Increment();
+    EXPECT_EQ(SelfMetricSeries(id), 3);
+  }
+  EXPECT_EQ(SelfMetricSeries(id), 0);
+}
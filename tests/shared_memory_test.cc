@@ -0,0 +1,299 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/counter_builder.h>
+#include <prometheus/gauge_builder.h>
+#include <prometheus/histogram_builder.h>
+#include <prometheus/shared_memory.h>
+
+#include "lib/text_serializer.h"
+
+using namespace testing;
+using namespace prometheus;
+
+class SharedMemoryTest : public Test {
+ public:
+  SharedMemoryTest()
+      : path_("/tmp/shared_memory_test." + std::to_string(getpid())) {}
+  ~SharedMemoryTest() { std::remove(path_.c_str()); }
+
+  static std::string Text(Collectable& collectable) {
+    auto collected = collectable.Collect();
+    return TextSerializer{}.Serialize(collected);
+  }
+
+ protected:
+  const std::string path_;
+};
+
+TEST_F(SharedMemoryTest, reader_sees_updates_in_place) {
+  SharedMemorySegment segment{path_};
+  auto requests = BuildCounter()
+                      .Name("requests")
+                      .Help("Requests served")
+                      .Labels({{"job", "api"}})
+                      .RegisterShared(segment)
+                      .Add({{"code", "200"}});
+  SharedMemoryReader reader{path_};
+
+  requests.Increment(3);
+  EXPECT_THAT(Text(reader), HasSubstr("requests{job=\"api\",code=\"200\"} 3"));
+  requests.Increment();
+  EXPECT_THAT(Text(reader), HasSubstr("requests{job=\"api\",code=\"200\"} 4"));
+  EXPECT_THAT(Text(reader), HasSubstr("# HELP requests Requests served"));
+}
+
+TEST_F(SharedMemoryTest, reader_matches_segment) {
+  SharedMemorySegment segment{path_};
+  BuildGauge().Name("queue").Help("").RegisterShared(segment).Add({}).Set(7);
+  auto latency = BuildHistogram()
+                     .Name("latency")
+                     .Help("")
+                     .RegisterShared(segment)
+                     .Add({}, Histogram::BucketBoundaries{0.5, 1});
+  latency.Observe(0.7);
+  latency.Observe(2);
+
+  SharedMemoryReader reader{path_};
+  auto text = Text(reader);
+  EXPECT_EQ(text, Text(segment));
+  EXPECT_THAT(text, HasSubstr("queue 7"));
+  EXPECT_THAT(text, HasSubstr("latency_count 2"));
+  EXPECT_THAT(text, HasSubstr("latency_bucket{le=\"1.000000\"} 1"));
+  EXPECT_THAT(text, HasSubstr("latency_bucket{le=\"+Inf\"} 2"));
+}
+
+TEST_F(SharedMemoryTest, histogram_drops_negative_values_from_sum) {
+  SharedMemorySegment segment{path_};
+  auto latency = BuildHistogram()
+                     .Name("latency")
+                     .Help("")
+                     .RegisterShared(segment)
+                     .Add({}, Histogram::BucketBoundaries{0, 1});
+  latency.Observe(-3);
+  latency.Observe(0.5);
+
+  auto text = Text(segment);
+  EXPECT_THAT(text, HasSubstr("latency_count 2"));
+  EXPECT_THAT(text, HasSubstr("latency_sum 0.5"));
+  EXPECT_THAT(text, HasSubstr("latency_bucket{le=\"0.000000\"} 1"));
+}
+
+TEST_F(SharedMemoryTest, add_returns_existing_series) {
+  SharedMemorySegment segment{path_};
+  auto& family = BuildCounter().Name("requests").Help("").RegisterShared(
+      segment);
+  family.Add({{"code", "200"}}).Increment();
+  family.Add({{"code", "200"}}).Increment();
+
+  EXPECT_EQ(family.Add({{"code", "200"}}).Value(), 2);
+  EXPECT_EQ(&family,
+            &BuildCounter().Name("requests").Help("").RegisterShared(segment));
+}
+
+TEST_F(SharedMemoryTest, removed_series_are_hidden) {
+  SharedMemorySegment segment{path_};
+  auto& family = BuildGauge().Name("queue").Help("").RegisterShared(segment);
+  family.Add({{"id", "1"}});
+  family.Remove(family.Add({{"id", "2"}}));
+
+  SharedMemoryReader reader{path_};
+  EXPECT_THAT(Text(reader), HasSubstr("id=\"1\""));
+  EXPECT_THAT(Text(reader), Not(HasSubstr("id=\"2\"")));
+}
+
+TEST_F(SharedMemoryTest, rejects_mismatching_family) {
+  SharedMemorySegment segment{path_};
+  BuildCounter().Name("requests").Help("").RegisterShared(segment);
+  EXPECT_THROW(BuildGauge().Name("requests").Help("").RegisterShared(segment),
+               std::invalid_argument);
+}
+
+TEST_F(SharedMemoryTest, throws_when_full) {
+  SharedMemorySegment segment{path_, 256};
+  auto& family = BuildCounter().Name("requests").Help("").RegisterShared(
+      segment);
+  auto add_series = [&family] {
+    for (auto i = 0; i < 10; ++i) {
+      family.Add({{"id", std::to_string(i)}});
+    }
+  };
+  EXPECT_THROW(add_series(), std::length_error);
+  SharedMemoryReader reader{path_};
+  EXPECT_THAT(Text(reader), HasSubstr("requests{id=\"0\"} 0"));
+}
+
+TEST_F(SharedMemoryTest, reader_follows_restarted_writer) {
+  SharedMemoryReader reader{path_};
+  EXPECT_EQ(Text(reader), "");
+  {
+    SharedMemorySegment segment{path_};
+    auto& family =
+        BuildGauge().Name("generation").Help("").RegisterShared(segment);
+    family.Add({}).Set(1);
+    EXPECT_THAT(Text(reader), HasSubstr("generation 1"));
+  }
+  SharedMemorySegment segment{path_};
+  auto& family =
+      BuildGauge().Name("generation").Help("").RegisterShared(segment);
+  family.Add({}).Set(2);
+  EXPECT_THAT(Text(reader), HasSubstr("generation 2"));
+}
+
+TEST_F(SharedMemoryTest, reads_segment_of_other_process) {
+  auto pid = fork();
+  if (pid == 0) {
+    SharedMemorySegment segment{path_};
+    BuildCounter()
+        .Name("jobs")
+        .Help("")
+        .RegisterShared(segment)
+        .Add({})
+        .Increment(5);
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+
+  SharedMemoryReader reader{path_};
+  EXPECT_THAT(Text(reader), HasSubstr("jobs 5"));
+}
+
+TEST_F(SharedMemoryTest, ignores_files_that_are_not_segments) {
+  auto file = std::fopen(path_.c_str(), "w");
+  std::fputs("requests 1\n", file);
+  std::fclose(file);
+
+  SharedMemoryReader reader{path_};
+  EXPECT_EQ(Text(reader), "");
+}
+
+TEST_F(SharedMemoryTest, restores_counters_and_histograms) {
+  {
+    SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+    BuildCounter()
+        .Name("requests")
+        .Help("")
+        .RegisterShared(segment)
+        .Add({{"code", "200"}})
+        .Increment(41);
+    BuildHistogram()
+        .Name("latency")
+        .Help("")
+        .RegisterShared(segment)
+        .Add({}, Histogram::BucketBoundaries{1})
+        .Observe(0.5);
+  }
+
+  SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+  // restored series are exposed before they are added again
+  EXPECT_THAT(Text(segment), HasSubstr("requests{code=\"200\"} 41"));
+
+  auto requests = BuildCounter()
+                      .Name("requests")
+                      .Help("")
+                      .RegisterShared(segment)
+                      .Add({{"code", "200"}});
+  requests.Increment();
+  EXPECT_EQ(requests.Value(), 42);
+  BuildHistogram()
+      .Name("latency")
+      .Help("")
+      .RegisterShared(segment)
+      .Add({}, Histogram::BucketBoundaries{1})
+      .Observe(2);
+
+  auto text = Text(segment);
+  EXPECT_THAT(text, HasSubstr("requests{code=\"200\"} 42"));
+  EXPECT_THAT(text, HasSubstr("latency_count 2"));
+  EXPECT_THAT(text, HasSubstr("latency_bucket{le=\"1.000000\"} 1"));
+}
+
+TEST_F(SharedMemoryTest, restarts_gauges_at_zero) {
+  {
+    SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+    BuildGauge().Name("queue").Help("").RegisterShared(segment).Add({}).Set(5);
+  }
+  SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+  auto& family = BuildGauge().Name("queue").Help("").RegisterShared(segment);
+  EXPECT_EQ(family.Add({}).Value(), 0);
+}
+
+TEST_F(SharedMemoryTest, restore_starts_over_when_buckets_change) {
+  {
+    SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+    BuildHistogram()
+        .Name("latency")
+        .Help("")
+        .RegisterShared(segment)
+        .Add({}, Histogram::BucketBoundaries{1})
+        .Observe(0.5);
+  }
+  SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+  BuildHistogram()
+      .Name("latency")
+      .Help("")
+      .RegisterShared(segment)
+      .Add({}, Histogram::BucketBoundaries{1, 2});
+
+  auto text = Text(segment);
+  EXPECT_THAT(text, HasSubstr("latency_count 0"));
+  EXPECT_THAT(text, Not(HasSubstr("latency_count 1")));
+}
+
+TEST_F(SharedMemoryTest, retire_restored_removes_series_not_added_again) {
+  {
+    SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+    auto& family =
+        BuildCounter().Name("requests").Help("").RegisterShared(segment);
+    family.Add({{"code", "200"}}).Increment(2);
+    family.Add({{"code", "500"}}).Increment(3);
+  }
+  SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+  BuildCounter()
+      .Name("requests")
+      .Help("")
+      .RegisterShared(segment)
+      .Add({{"code", "200"}})
+      .Increment();
+
+  EXPECT_EQ(segment.RetireRestored(), 1);
+  auto text = Text(segment);
+  EXPECT_THAT(text, HasSubstr("requests{code=\"200\"} 3"));
+  EXPECT_THAT(text, Not(HasSubstr("code=\"500\"")));
+  EXPECT_EQ(segment.RetireRestored(), 0);
+}
+
+TEST_F(SharedMemoryTest, restore_grows_segment) {
+  {
+    SharedMemorySegment segment{path_, 256, SegmentMode::kRestore};
+    BuildCounter().Name("requests").Help("").RegisterShared(segment).Add(
+        {{"id", "0"}});
+  }
+  SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+  auto& family = BuildCounter().Name("requests").Help("").RegisterShared(
+      segment);
+  for (auto i = 0; i < 10; ++i) {
+    family.Add({{"id", std::to_string(i)}}).Increment();
+  }
+  SharedMemoryReader reader{path_};
+  EXPECT_THAT(Text(reader), HasSubstr("requests{id=\"9\"} 1"));
+}
+
+TEST_F(SharedMemoryTest, restore_replaces_files_that_are_not_segments) {
+  auto file = std::fopen(path_.c_str(), "w");
+  std::fputs("requests 1\n", file);
+  std::fclose(file);
+
+  SharedMemorySegment segment{path_, 1 << 16, SegmentMode::kRestore};
+  BuildCounter().Name("requests").Help("").RegisterShared(segment).Add({});
+  segment.Checkpoint();
+  SharedMemoryReader reader{path_};
+  EXPECT_THAT(Text(reader), HasSubstr("requests 0"));
+}
@@ -0,0 +1,92 @@
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include <prometheus/counter.h>
+#include <prometheus/slab.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class SlabTest : public Test {
+ public:
+  static std::vector<std::size_t> Keys(const detail::Slab<Counter>& slab) {
+    auto keys = std::vector<std::size_t>{};
+    slab.ForEach([&keys](std::size_t key, Counter*) { keys.push_back(key); });
+    return keys;
+  }
+
+  detail::Slab<Counter> slab_;
+};
+
+TEST_F(SlabTest, addresses_are_stable) {
+  auto first = slab_.Emplace(0);
+  first->Increment();
+  for (std::size_t i = 1; i < 10000; i++) {
+    slab_.Emplace(i);
+  }
+  EXPECT_EQ(first->Value(), 1);
+  EXPECT_EQ(slab_.size(), 10000);
+}
+
+TEST_F(SlabTest, iterates_in_insertion_order) {
+  for (std::size_t i = 0; i < 100; i++) {
+    slab_.Emplace(i);
+  }
+  auto keys = Keys(slab_);
+  ASSERT_EQ(keys.size(), 100);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    EXPECT_EQ(keys[i], i);
+  }
+}
+
+TEST_F(SlabTest, erased_slots_are_reused) {
+  slab_.Emplace(1);
+  auto second = slab_.Emplace(2);
+  slab_.Emplace(3);
+  slab_.Erase(second);
+  EXPECT_THAT(Keys(slab_), ElementsAre(1, 3));
+  auto fourth = slab_.Emplace(4);
+  EXPECT_EQ(fourth, second);
+  EXPECT_EQ(fourth->Value(), 0);
+  EXPECT_THAT(Keys(slab_), ElementsAre(1, 4, 3));
+}
+
+TEST_F(SlabTest, cache_line_aligned_slots) {
+  slab_.SetCacheLineAligned(true);
+  for (std::size_t i = 0; i < 100; i++) {
+    auto address = reinterpret_cast<std::uintptr_t>(slab_.Emplace(i));
+    EXPECT_EQ(address % detail::Slab<Counter>::kCacheLineSize, 0);
+  }
+}
+
+TEST_F(SlabTest, empty_chunks_are_released) {
+  auto objects = std::vector<Counter*>{};
+  for (std::size_t i = 0; i < 10000; i++) {
+    objects.push_back(slab_.Emplace(i));
+  }
+  auto peak = slab_.capacity();
+  auto last = objects.back();
+  objects.pop_back();
+  for (auto object : objects) {
+    slab_.Erase(object);
+  }
+  EXPECT_EQ(slab_.size(), 1);
+  EXPECT_LT(slab_.capacity(), peak / 2);
+  EXPECT_THAT(Keys(slab_), ElementsAre(9999));
+  EXPECT_EQ(last->Value(), 0);
+
+  for (std::size_t i = 0; i < 100; i++) {
+    slab_.Emplace(i);
+  }
+  EXPECT_EQ(slab_.size(), 101);
+}
+
+TEST_F(SlabTest, newest_chunk_is_kept_when_empty) {
+  auto object = slab_.Emplace(0);
+  auto capacity = slab_.capacity();
+  slab_.Erase(object);
+  EXPECT_EQ(slab_.capacity(), capacity);
+  EXPECT_EQ(slab_.Emplace(1), object);
+}
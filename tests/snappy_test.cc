@@ -0,0 +1,58 @@
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include "lib/snappy.h"
+
+using namespace testing;
+using namespace prometheus::detail;
+
+class SnappyTest : public Test {
+ public:
+  static std::string RoundTrip(const std::string& input) {
+    std::string output;
+    EXPECT_TRUE(SnappyUncompress(SnappyCompress(input), &output));
+    return output;
+  }
+};
+
+TEST_F(SnappyTest, round_trips_empty_and_short_input) {
+  EXPECT_EQ(RoundTrip(""), "");
+  EXPECT_EQ(RoundTrip("a"), "a");
+  EXPECT_EQ(RoundTrip("abc"), "abc");
+}
+
+TEST_F(SnappyTest, compresses_repetitive_input) {
+  std::string input;
+  for (auto i = 0; i < 10000; i++) {
+    input += "http_requests_total{code=\"200\",method=\"get\"} " +
+             std::to_string(i % 7) + "\n";
+  }
+  auto compressed = SnappyCompress(input);
+  EXPECT_LT(compressed.size(), input.size() / 4);
+  EXPECT_EQ(RoundTrip(input), input);
+}
+
+TEST_F(SnappyTest, round_trips_input_spanning_blocks) {
+  std::string input;
+  unsigned int state = 1;
+  for (auto i = 0; i < 300000; i++) {
+    state = state * 1103515245 + 12345;
+    input.push_back(static_cast<char>(i % 3 == 0 ? state >> 16 : 'x'));
+  }
+  EXPECT_EQ(RoundTrip(input), input);
+}
+
+TEST_F(SnappyTest, decodes_reference_encoding) {
+  // literal "abcd" followed by a copy of length 8 at offset 4
+  std::string output;
+  ASSERT_TRUE(SnappyUncompress(std::string{"\x0c\x0c" "abcd" "\x11\x04", 8},
+                               &output));
+  EXPECT_EQ(output, "abcdabcdabcd");
+}
+
+TEST_F(SnappyTest, rejects_malformed_input) {
+  std::string output;
+  EXPECT_FALSE(SnappyUncompress(std::string{"\x05\x10" "ab", 4}, &output));
+  EXPECT_FALSE(SnappyUncompress(std::string{"\x08\x11\x04", 3}, &output));
+}
@@ -0,0 +1,129 @@
+#include <gmock/gmock.h>
+
+#include <limits>
+
+#include <prometheus/static_histogram.h>
+#include <prometheus/typed_family.h>
+
+using namespace testing;
+using namespace prometheus;
+
+class StaticHistogramTest : public Test {
+ public:
+  using Latency = Buckets<1, 5, 10>;
+
+  static const io::prometheus::client::Histogram* Collected(
+      StaticHistogram<Latency>& histogram,
+      flatbuffers::FlatBufferBuilder* builder) {
+    auto labels = label_pair_t{};
+    builder->Finish(histogram.Collect(&labels, builder));
+    return flatbuffers::GetRoot<io::prometheus::client::Metric>(
+               builder->GetBufferPointer())
+        ->histogram();
+  }
+};
+
+TEST_F(StaticHistogramTest, bounds_are_shared) {
+  EXPECT_THAT(StaticHistogram<Latency>::BucketBoundaries(),
+              ElementsAre(1, 5, 10));
+  EXPECT_EQ(&StaticHistogram<Latency>::BucketBoundaries(),
+            &StaticHistogram<Latency>::BucketBoundaries());
+}
+
+TEST_F(StaticHistogramTest, observations_land_in_buckets) {
+  StaticHistogram<Latency> histogram;
+  histogram.Observe(0);
+  histogram.Observe(1);
+  histogram.Observe(7);
+  histogram.Observe(100);
+  histogram.Observe(std::numeric_limits<double>::quiet_NaN());
+  flatbuffers::FlatBufferBuilder builder;
+  auto collected = Collected(histogram, &builder);
+  ASSERT_EQ(collected->bucket()->size(), 4);
+  EXPECT_EQ(collected->bucket()->Get(0)->cumulative_count(), 1);
+  EXPECT_EQ(collected->bucket()->Get(1)->cumulative_count(), 2);
+  EXPECT_EQ(collected->bucket()->Get(2)->cumulative_count(), 3);
+  EXPECT_EQ(collected->bucket()->Get(3)->cumulative_count(), 5);
+  EXPECT_EQ(collected->sample_count(), 5);
+}
+
+TEST_F(StaticHistogramTest, weighted_observation) {
+  StaticHistogram<Latency> histogram;
+  histogram.Observe(2, 4);
+  flatbuffers::FlatBufferBuilder builder;
+  auto collected = Collected(histogram, &builder);
+  EXPECT_EQ(collected->bucket()->Get(1)->cumulative_count(), 4);
+  EXPECT_EQ(collected->sample_sum(), 8);
+}
+
+TEST_F(StaticHistogramTest, negative_values_are_not_summed) {
+  StaticHistogram<Latency> histogram;
+  histogram.Observe(-2, 3);
+  const double values[] = {-1, 2, -3};
+  histogram.ObserveBatch(values, 3);
+  flatbuffers::FlatBufferBuilder builder;
+  auto collected = Collected(histogram, &builder);
+  EXPECT_EQ(collected->sample_count(), 6);
+  EXPECT_EQ(collected->sample_sum(), 2);
+}
+
+TEST_F(StaticHistogramTest, matches_dynamic_histogram) {
+  StaticHistogram<Latency> fixed;
+  Histogram dynamic{{1, 5, 10}};
+  for (auto value : {-2.0, 0.5, 1.0, 4.99, 5.0, 9.0, 10.0, 10.5}) {
+    fixed.Observe(value);
+    dynamic.Observe(value);
+  }
+  auto labels = label_pair_t{};
+  flatbuffers::FlatBufferBuilder fixed_builder;
+  flatbuffers::FlatBufferBuilder dynamic_builder;
+  fixed_builder.Finish(fixed.Collect(&labels, &fixed_builder));
+  dynamic_builder.Finish(dynamic.Collect(&labels, &dynamic_builder));
+  auto fixed_histogram =
+      flatbuffers::GetRoot<io::prometheus::client::Metric>(
+          fixed_builder.GetBufferPointer())
+          ->histogram();
+  auto dynamic_histogram =
+      flatbuffers::GetRoot<io::prometheus::client::Metric>(
+          dynamic_builder.GetBufferPointer())
+          ->histogram();
+  EXPECT_EQ(fixed_histogram->sample_count(),
+            dynamic_histogram->sample_count());
+  EXPECT_EQ(fixed_histogram->sample_sum(), dynamic_histogram->sample_sum());
+  ASSERT_EQ(fixed_histogram->bucket()->size(),
+            dynamic_histogram->bucket()->size());
+  for (flatbuffers::uoffset_t i = 0; i < fixed_histogram->bucket()->size();
+       ++i) {
+    EXPECT_EQ(fixed_histogram->bucket()->Get(i)->cumulative_count(),
+              dynamic_histogram->bucket()->Get(i)->cumulative_count());
+    EXPECT_EQ(fixed_histogram->bucket()->Get(i)->upper_bound(),
+              dynamic_histogram->bucket()->Get(i)->upper_bound());
+  }
+}
+
+TEST_F(StaticHistogramTest, register_with_builder) {
+  Registry registry;
+  auto& family = BuildHistogram()
+                     .Name("latency_microseconds")
+                     .Help("")
+                     .RegisterStatic<Latency>(registry);
+  family.Add({{"method", "GET"}}).Observe(3);
+  auto collected = registry.Collect();
+  ASSERT_EQ(collected.size(), 1);
+  auto metric_family = io::prometheus::client::GetMetricFamily(
+      collected.at(0)->GetBufferPointer());
+  EXPECT_EQ(metric_family->type(),
+            io::prometheus::client::MetricType_HISTOGRAM);
+  EXPECT_EQ(metric_family->metric()->Get(0)->histogram()->sample_count(), 1);
+}
+
+namespace {
+PROMETHEUS_LABEL(Method, "method");
+}
+
+TEST_F(StaticHistogramTest, typed_family_of_static_histograms) {
+  TypedFamily<StaticHistogram<Latency>, Labels<Method>> family{"latency", "",
+                                                               {}};
+  family.Add({"GET"}).Observe(3);
+  EXPECT_EQ(&family.Add({"GET"}), &family.Add({"GET"}));
+}
@@ -0,0 +1,104 @@
+#include <gmock/gmock.h>
+
+#include <prometheus/typed_family.h>
+
+using namespace testing;
+using namespace prometheus;
+
+namespace {
+PROMETHEUS_LABEL(Method, "method");
+PROMETHEUS_LABEL(Code, "code");
+}
+
+class TypedFamilyTest : public Test {
+ public:
+  static const io::prometheus::client::MetricFamily* Collected(
+      const builders_t& collected) {
+    return io::prometheus::client::GetMetricFamily(
+        collected.at(0)->GetBufferPointer());
+  }
+};
+
+TEST_F(TypedFamilyTest, same_values_return_same_series) {
+  TypedFamily<Counter, Labels<Method, Code>> family{"requests", "", {}};
+  auto& counter = family.Add({"GET", "200"});
+  counter.Increment();
+  auto method = std::string{"GET"};
+  EXPECT_EQ(&family.Add({method, "200"}), &counter);
+  EXPECT_NE(&family.Add({"GET", "500"}), &counter);
+  EXPECT_EQ(family.Add({"GET", "200"}).Value(), 1);
+}
+
+TEST_F(TypedFamilyTest, values_are_not_concatenated) {
+  TypedFamily<Gauge, Labels<Method, Code>> family{"queue_depth", "", {}};
+  EXPECT_NE(&family.Add({"ab", "c"}), &family.Add({"a", "bc"}));
+}
+
+TEST_F(TypedFamilyTest, collect_uses_schema_label_names) {
+  TypedFamily<Counter, Labels<Method, Code>> family{"requests", "",
+                                                    {{"component", "test"}}};
+  family.Add({"POST", "201"}).Increment(3);
+  auto collected = family.Collect();
+  auto metrics = Collected(collected)->metric();
+  ASSERT_EQ(metrics->size(), 1);
+  auto labels = metrics->Get(0)->label();
+  ASSERT_EQ(labels->size(), 3);
+  EXPECT_EQ(labels->Get(0)->name()->str(), "component");
+  EXPECT_EQ(labels->Get(1)->name()->str(), "method");
+  EXPECT_EQ(labels->Get(1)->value()->str(), "POST");
+  EXPECT_EQ(labels->Get(2)->name()->str(), "code");
+  EXPECT_EQ(labels->Get(2)->value()->str(), "201");
+  EXPECT_EQ(metrics->Get(0)->counter()->value(), 3);
+}
+
+TEST_F(TypedFamilyTest, remove_series) {
+  TypedFamily<Counter, Labels<Method>> family{"requests", "", {}};
+  auto& counter = family.Add({"GET"});
+  counter.Increment();
+  family.Add({"PUT"});
+  family.Remove(&counter);
+  family.Remove(&counter);
+  auto collected = family.Collect();
+  EXPECT_EQ(Collected(collected)->metric()->size(), 1);
+  EXPECT_EQ(family.Add({"GET"}).Value(), 0);
+}
+
+TEST_F(TypedFamilyTest, histogram_series_take_buckets) {
+  TypedFamily<Histogram, Labels<Method>> family{"latency", "", {}};
+  auto& histogram = family.Add({"GET"}, Histogram::BucketBoundaries{1, 2});
+  histogram.Observe(1.5);
+  auto collected = family.Collect();
+  auto metric = Collected(collected)->metric()->Get(0);
+  EXPECT_EQ(metric->histogram()->sample_count(), 1);
+  EXPECT_EQ(metric->histogram()->bucket()->size(), 3);
+}
+
+TEST_F(TypedFamilyTest, family_without_labels) {
+  TypedFamily<Gauge, Labels<>> family{"temperature", "", {}};
+  family.Add({}).Set(21);
+  EXPECT_EQ(family.Add({}).Value(), 21);
+}
+
+TEST_F(TypedFamilyTest, register_with_builder) {
+  Registry registry;
+  auto& family = BuildCounter()
+                     .Name("requests")
+                     .Help("")
+                     .RegisterTyped<Labels<Method, Code>>(registry);
+  family.Add({"GET", "200"}).Increment();
+  auto& again = BuildCounter()
+                    .Name("requests")
+                    .Help("")
+                    .RegisterTyped<Labels<Method, Code>>(registry);
+  EXPECT_EQ(&again, &family);
+  EXPECT_THROW(BuildCounter().Name("requests").RegisterTyped<Labels<Method>>(
+                   registry),
+               std::invalid_argument);
+}
+
+static_assert(detail::IsValidLabelName("method"), "");
+static_assert(detail::IsValidLabelName("_code2"), "");
+static_assert(!detail::IsValidLabelName(""), "");
+static_assert(!detail::IsValidLabelName("2xx"), "");
+static_assert(!detail::IsValidLabelName("__reserved"), "");
+static_assert(!detail::IsValidLabelName("with-dash"), "");
@@ -0,0 +1,28 @@
+// Prints the metrics of shared memory segments in the text format, e.g. for
+// a sidecar agent or for a quick look at a running process:
+//
+//   read_shared_metrics /run/app/metrics.shm
+
+#include <cstdio>
+
+#include <prometheus/shared_memory.h>
+
+#include "lib/text_serializer.h"
+
+using namespace prometheus;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s SEGMENT...\n", argv[0]);
+    return 2;
+  }
+
+  auto metrics = builders_t{};
+  for (auto i = 1; i < argc; ++i) {
+    auto collected = SharedMemoryReader{argv[i]}.Collect();
+    metrics.insert(metrics.end(), collected.begin(), collected.end());
+  }
+  auto text = TextSerializer{}.Serialize(metrics);
+  std::fwrite(text.data(), 1, text.size(), stdout);
+  return 0;
+}